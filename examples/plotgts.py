@@ -52,24 +52,8 @@ sys.stdout.flush()
 print 'Splitting into separate connected and manifold surfaces...',
 sys.stdout.flush()
 
-surfaces = s.split()
-
-print 'Done.'
-sys.stdout.flush()
-
-#for i,s in enumerate(surfaces):
-#    print '\tSurface',i,'is',
-#    if s.is_closed():
-#        print 'closed.'
-#    else:
-#        print 'open.'
-
-print 'Retrieving mayavi data...',
-sys.stdout.flush()
-
-args = []
-for s in surfaces:
-    args.append(gts.get_coords_and_face_indices(s,True))
+# The components are returned as coordinate and triangle arrays for mayavi
+surfaces = s.split(as_arrays=True)
 
 print 'Done.'
 sys.stdout.flush()
@@ -77,8 +61,8 @@ sys.stdout.flush()
 # Plot the surfaces
 print 'Plotting...',
 sys.stdout.flush()
-for s,arg in zip(surfaces,args):
-    x,y,z,t = arg
+for coords,t in surfaces:
+    x,y,z = coords.T
     mlab.triangular_mesh(x,y,z,t,color=(0.5,0.5,0.75))
 mlab.show()
 print 'Done.'
@@ -39,6 +39,7 @@ The following geometric primitives are provided:
   Triangle - a triangle defined by three Edges
   Face - a Triangle that may be used to define a face on a Surface
   Surface - a surface composed of Faces
+  ProgressiveSurface - a Surface whose level of detail may be changed
 
 A tetrahedron is assembled from these primitives as follows.  First,
 create Vertices for each of the tetrahedron's points:
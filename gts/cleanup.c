@@ -36,6 +36,59 @@
 #include "pygts.h"
 
 
+/* Helpers for pygts_vertices_merge.  The vertices are binned into a 
+ * uniform grid of cells with side-length epsilon, keyed on 
+ * floor(p/epsilon).  The entries are sorted so that each cell is a 
+ * contiguous run, and a hash table maps each cell to its first entry.
+ */
+typedef struct {
+  gint64 c[3];
+  GtsVertex *v;
+} GridEntry;
+
+#define GRID_MAX_CELL 4.e18
+
+static gint64
+grid_cell(gdouble x, gdouble size)
+{
+  gdouble c = floor(x/size);
+  if(c > GRID_MAX_CELL) return (gint64)GRID_MAX_CELL;
+  if(c < -GRID_MAX_CELL) return -(gint64)GRID_MAX_CELL;
+  return (gint64)c;
+}
+
+static guint
+grid_hash(gconstpointer key)
+{
+  const gint64 *c = ((const GridEntry*)key)->c;
+  guint64 h;
+  h = ((guint64)c[0])*73856093 ^ ((guint64)c[1])*19349663 ^ 
+    ((guint64)c[2])*83492791;
+  return (guint)(h ^ (h>>32));
+}
+
+static gboolean
+grid_equal(gconstpointer a, gconstpointer b)
+{
+  const gint64 *ca = ((const GridEntry*)a)->c;
+  const gint64 *cb = ((const GridEntry*)b)->c;
+  return ca[0]==cb[0] && ca[1]==cb[1] && ca[2]==cb[2];
+}
+
+static int
+grid_compare(const void *a, const void *b)
+{
+  const gint64 *ca = ((const GridEntry*)a)->c;
+  const gint64 *cb = ((const GridEntry*)b)->c;
+  guint i;
+  for(i=0;i<3;i++) {
+    if(ca[i]<cb[i]) return -1;
+    if(ca[i]>cb[i]) return 1;
+  }
+  return 0;
+}
+
+
 /**
  * Original documentation from GTS's vertex.c:
  *
@@ -56,53 +109,81 @@
 /* This function is modified from the original in GTS in order to avoid 
  * deallocating any objects referenced by the live-objects table.  The 
  * approach is similar to what is used for replace() in vertex.c.
+ *
+ * The Kd-Tree and per-vertex bounding boxes of the original are replaced 
+ * by a uniform grid; the neighbours of a vertex are found in the 27 cells
+ * around it, and then tested against the box.
  */
 GList*
 pygts_vertices_merge(GList* vertices, gdouble epsilon,
 		     gboolean (* check) (GtsVertex *, GtsVertex *))
 {
-  GPtrArray *array;
   GList *i, *next;
-  GNode *kdtree;
   GtsVertex *v;
-  GtsBBox *bbox;
-  GSList *selected, *j;
   GtsVertex *sv;
   PygtsObject *obj;
   PygtsVertex *vertex=NULL;
   GSList *parents=NULL, *ii,*cur;
+  GridEntry *grid, key;
+  GHashTable *cells;
+  gdouble size;
+  guint n, k, index;
+  gint dx, dy, dz;
+  gint64 c[3];
 
   g_return_val_if_fail(vertices != NULL, 0);
 
-  array = g_ptr_array_new();
-  i = vertices;
-  while (i) {
-    g_ptr_array_add(array, i->data);
-    i = g_list_next(i);
+  /* Bin the vertices.  A zero epsilon only merges coincident vertices, 
+   * and any cell size will do.
+   */
+  size = epsilon>0. ? epsilon : 1.;
+  n = g_list_length(vertices);
+  grid = g_new(GridEntry,n);
+  for(i=vertices,k=0; i!=NULL; i=g_list_next(i),k++) {
+    v = i->data;
+    grid[k].c[0] = grid_cell(GTS_POINT(v)->x,size);
+    grid[k].c[1] = grid_cell(GTS_POINT(v)->y,size);
+    grid[k].c[2] = grid_cell(GTS_POINT(v)->z,size);
+    grid[k].v = v;
+  }
+  qsort(grid,n,sizeof(GridEntry),grid_compare);
+  cells = g_hash_table_new(grid_hash,grid_equal);
+  for(k=0;k<n;k++) {
+    if( k==0 || grid_compare(&grid[k-1],&grid[k])!=0 ) {
+      g_hash_table_insert(cells,&grid[k],GUINT_TO_POINTER(k+1));
+    }
   }
-  kdtree = gts_kdtree_new(array, NULL);
-  g_ptr_array_free(array, TRUE);
 
   i = vertices;
   while(i) {
     v = i->data;
     if (!GTS_OBJECT(v)->reserved) { /* Do something only if v is active */
 
-      /* build bounding box */
-      bbox = gts_bbox_new(gts_bbox_class(), v, 
-			  GTS_POINT(v)->x - epsilon,
-			  GTS_POINT(v)->y - epsilon,
-			  GTS_POINT(v)->z - epsilon,
-			  GTS_POINT(v)->x + epsilon,
-			  GTS_POINT(v)->y + epsilon,
-			  GTS_POINT(v)->z + epsilon);
-
-      /* select vertices which are inside bbox using kdtree */
-      j = selected = gts_kdtree_range(kdtree, bbox, NULL);
-      while(j) {
-        sv = j->data;
-        if( sv!=v && !GTS_OBJECT(sv)->reserved && (!check||(*check)(sv, v)) ) {
-          /* sv is not v and is active */
+      c[0] = grid_cell(GTS_POINT(v)->x,size);
+      c[1] = grid_cell(GTS_POINT(v)->y,size);
+      c[2] = grid_cell(GTS_POINT(v)->z,size);
+
+      /* select vertices which are inside the bbox using the grid */
+      for(dx=-1;dx<=1;dx++) {
+      for(dy=-1;dy<=1;dy++) {
+      for(dz=-1;dz<=1;dz++) {
+	key.c[0] = c[0]+dx;
+	key.c[1] = c[1]+dy;
+	key.c[2] = c[2]+dz;
+	if( (index=GPOINTER_TO_UINT(g_hash_table_lookup(cells,&key))) == 0 ) {
+	  continue;
+	}
+	for(k=index-1; k<n && grid_equal(&grid[k],&key); k++) {
+	  sv = grid[k].v;
+	  if( sv==v || GTS_OBJECT(sv)->reserved ||
+	      fabs(GTS_POINT(sv)->x-GTS_POINT(v)->x) > epsilon ||
+	      fabs(GTS_POINT(sv)->y-GTS_POINT(v)->y) > epsilon ||
+	      fabs(GTS_POINT(sv)->z-GTS_POINT(v)->z) > epsilon ||
+	      (check && !(*check)(sv, v)) ) {
+	    continue;
+	  }
+
+	  /* sv is not v and is active */
 	  if( (obj = g_hash_table_lookup(obj_table,GTS_OBJECT(sv))) !=NULL ) {
 	    vertex = PYGTS_VERTEX(obj);
 	    /* Detach and save any parent segments */
@@ -132,15 +213,15 @@ pygts_vertices_merge(GList* vertices, gdouble epsilon,
 	    parents = NULL;
 	  }
 	  vertex = NULL;
-        }
-        j = g_slist_next(j);
+	}
+      }
+      }
       }
-      g_slist_free(selected);
-      gts_object_destroy(GTS_OBJECT(bbox));
     }
     i = g_list_next(i);
   }
-  gts_kdtree_destroy(kdtree);
+  g_hash_table_destroy(cells);
+  g_free(grid);
 
 
   /* destroy inactive vertices and removes them from list */
@@ -170,13 +251,6 @@ pygts_vertices_merge(GList* vertices, gdouble epsilon,
 }
 
 
-static void 
-build_list(gpointer data, GSList ** list)
-{
-  *list = g_slist_prepend(*list, data);
-}
-
-
 static void
 build_list1(gpointer data, GList ** list)
 {
@@ -202,116 +276,267 @@ pygts_vertex_cleanup(GtsSurface *s, gdouble threshold)
 }
 
 
-void 
-pygts_edge_cleanup(GtsSurface *s)
+/* Helpers for the edge and face cleanups.  Edges and triangles are 
+ * hashed on their sorted vertex pointers, so that duplicates are found 
+ * with a single table lookup.  The hash tables use the elements 
+ * themselves as keys; nothing is allocated per element.
+ */
+#define KEY_HASH(h,p) ((h)*1000003u ^ (guint)(((gsize)(p))>>3))
+
+static void
+sort_vertices(GtsVertex **v, guint n)
+{
+  GtsVertex *tmp;
+  guint i,j;
+
+  for(i=1;i<n;i++) {
+    for(j=i; j>0 && v[j-1]>v[j]; j--) {
+      tmp = v[j-1]; v[j-1] = v[j]; v[j] = tmp;
+    }
+  }
+}
+
+
+static void
+edge_key(gconstpointer e, GtsVertex **v)
 {
-  GSList *edges = NULL;
-  GSList *i, *ii, *cur, *parents=NULL;
+  v[0] = ((GtsSegment*)e)->v1;
+  v[1] = ((GtsSegment*)e)->v2;
+  sort_vertices(v,2);
+}
+
+
+static guint
+edge_hash(gconstpointer e)
+{
+  GtsVertex *v[2];
+
+  edge_key(e,v);
+  return KEY_HASH(KEY_HASH(0,v[0]),v[1]);
+}
+
+
+static gboolean
+edge_equal(gconstpointer e1, gconstpointer e2)
+{
+  GtsVertex *v1[2], *v2[2];
+
+  edge_key(e1,v1);
+  edge_key(e2,v2);
+  return v1[0]==v2[0] && v1[1]==v2[1];
+}
+
+
+/* Only used for triangles which are not degenerate */
+static void
+triangle_key(gconstpointer t, GtsVertex **v)
+{
+  gts_triangle_vertices((GtsTriangle*)t,&(v[0]),&(v[1]),&(v[2]));
+  sort_vertices(v,3);
+}
+
+
+static guint
+triangle_hash(gconstpointer t)
+{
+  GtsVertex *v[3];
+
+  triangle_key(t,v);
+  return KEY_HASH(KEY_HASH(KEY_HASH(0,v[0]),v[1]),v[2]);
+}
+
+
+static gboolean
+triangle_equal(gconstpointer t1, gconstpointer t2)
+{
+  GtsVertex *v1[3], *v2[3];
+
+  triangle_key(t1,v1);
+  triangle_key(t2,v2);
+  return v1[0]==v2[0] && v1[1]==v2[1] && v1[2]==v2[2];
+}
+
+
+/* The same tests as gts_triangle_is_ok(), less the duplicate check */
+static gboolean
+triangle_is_degenerate(GtsTriangle *t)
+{
+  GtsSegment *s1=GTS_SEGMENT(t->e1), *s2=GTS_SEGMENT(t->e2),
+    *s3=GTS_SEGMENT(t->e3);
+  GtsVertex *v1, *v2, *v3;
+
+  if( s1==s2 || s1==s3 || s2==s3 ) return TRUE;
+  if( s1->v1==s1->v2 || s2->v1==s2->v2 || s3->v1==s3->v2 ) return TRUE;
+  if( !gts_segments_touch(s1,s2) || !gts_segments_touch(s1,s3) ||
+      !gts_segments_touch(s2,s3) ) {
+    return TRUE;
+  }
+  gts_triangle_vertices(t,&v1,&v2,&v3);
+  return v1==v3 || v2==v3;
+}
+
+
+/* Replaces e with its duplicate, taking care to keep any parent
+ * triangles on e.
+ */
+static void
+edge_replace(GtsEdge *e, GtsEdge *duplicate)
+{
+  GSList *ii, *cur, *parents=NULL;
   PygtsEdge *edge;
-  GtsEdge *e, *duplicate;
 
-  g_return_if_fail(s != NULL);
+  /* Detach and save any parent triangles */
+  if( (edge = PYGTS_EDGE(g_hash_table_lookup(obj_table,GTS_OBJECT(e))))
+      !=NULL ) {
+    ii = e->triangles;
+    while(ii!=NULL) {
+      cur = ii;
+      ii = g_slist_next(ii);
+      if(PYGTS_IS_PARENT_TRIANGLE(cur->data)) {
+	e->triangles = g_slist_remove_link(e->triangles, cur);
+	parents = g_slist_prepend(parents,cur->data);
+	g_slist_free_1(cur);
+      }
+    } 
+  }
 
-  /* build list of edges */
-  gts_surface_foreach_edge(s, (GtsFunc)build_list, &edges);
+  /* replace e with its duplicate */
+  gts_edge_replace(e, duplicate);
 
-  /* remove degenerate and duplicate edges.
-     Note: we could use gts_edges_merge() to remove the duplicates and then
-     remove the degenerate edges but it is more efficient to do everything 
-     at once (and it's more pedagogical too ...) */
+  /* Reattach the parent segments */
+  if( edge != NULL ) {
+    ii = parents;
+    while(ii!=NULL) {
+      e->triangles = g_slist_prepend(e->triangles, ii->data);
+      ii = g_slist_next(ii);
+    }
+    g_slist_free(parents);
+  }
+  else {
+    /* destroy e */
+    gts_object_destroy(GTS_OBJECT (e));
+  }
+}
 
-  /* We want to control manually the destruction of edges */
-  gts_allow_floating_edges = TRUE;
 
-  i = edges;
-  while(i) {
-    e = i->data;
+typedef struct {
+  GHashTable *edges;
+  GPtrArray *degenerate;
+} EdgeCleanupData;
+
+
+static void
+edge_cleanup_edge(GtsEdge *e, EdgeCleanupData *data)
+{
+  GtsEdge *duplicate;
+
+  if( (duplicate = g_hash_table_lookup(data->edges,e)) == NULL ) {
+    g_hash_table_insert(data->edges,e,e);
     if(GTS_SEGMENT(e)->v1 == GTS_SEGMENT(e)->v2) {
-      /* edge is degenerate */
-      if( !g_hash_table_lookup(obj_table,GTS_OBJECT(e)) ) {
-	/* destroy e */
-	gts_object_destroy(GTS_OBJECT(e));
-      }
+      g_ptr_array_add(data->degenerate,e);
     }
-    else {
-      if((duplicate = gts_edge_is_duplicate(e))) {
-
-	/* Detach and save any parent triangles */
-	if( (edge = PYGTS_EDGE(g_hash_table_lookup(obj_table,GTS_OBJECT(e))))
-	    !=NULL ) {
-	  ii = e->triangles;
-	  while(ii!=NULL) {
-	    cur = ii;
-	    ii = g_slist_next(ii);
-	    if(PYGTS_IS_PARENT_TRIANGLE(cur->data)) {
-	      e->triangles = g_slist_remove_link(e->triangles, cur);
-	      parents = g_slist_prepend(parents,cur->data);
-	      g_slist_free_1(cur);
-	    }
-	  } 
-	}
+  }
+  else if( duplicate != e ) {
+    /* Replacing e does not touch the surface's face table, and so this
+     * is safe to do while traversing the faces.  Afterwards no face 
+     * refers to e, and it will not be seen again.
+     */
+    edge_replace(e,duplicate);
+  }
+}
 
-	/* replace e with its duplicate */
-	gts_edge_replace(e, duplicate);
 
-	/* Reattach the parent segments */
-	if( edge != NULL ) {
-	  ii = parents;
-	  while(ii!=NULL) {
-	    e->triangles = g_slist_prepend(e->triangles, ii->data);
-	    ii = g_slist_next(ii);
-	  }
-	  g_slist_free(parents);
-	  parents = NULL;
-	}
+static void
+edge_cleanup_face(GtsTriangle *t, EdgeCleanupData *data)
+{
+  edge_cleanup_edge(t->e1,data);
+  edge_cleanup_edge(t->e2,data);
+  edge_cleanup_edge(t->e3,data);
+}
 
-	if( !g_hash_table_lookup(obj_table,GTS_OBJECT(e)) ) {
-	  /* destroy e */
-	  gts_object_destroy(GTS_OBJECT (e));
-	}
-      }
+
+void 
+pygts_edge_cleanup(GtsSurface *s)
+{
+  EdgeCleanupData data;
+  GtsEdge *e;
+  guint i;
+
+  g_return_if_fail(s != NULL);
+
+  /* We want to control manually the destruction of edges */
+  gts_allow_floating_edges = TRUE;
+
+  /* Replace the duplicate edges in a single pass over the faces.  
+   * Destroying the degenerate edges also destroys their faces, and so
+   * must wait until the traversal is over.
+   */
+  data.edges = g_hash_table_new(edge_hash,edge_equal);
+  data.degenerate = g_ptr_array_new();
+  gts_surface_foreach_face(s, (GtsFunc)edge_cleanup_face, &data);
+  g_hash_table_destroy(data.edges);
+
+  for(i=0;i<data.degenerate->len;i++) {
+    e = GTS_EDGE(g_ptr_array_index(data.degenerate,i));
+    if( !g_hash_table_lookup(obj_table,GTS_OBJECT(e)) ) {
+      /* destroy e */
+      gts_object_destroy(GTS_OBJECT(e));
     }
-    i = g_slist_next(i);
   }
+  g_ptr_array_free(data.degenerate,TRUE);
   
   /* don't forget to reset to default */
   gts_allow_floating_edges = FALSE;
+}
+
+
+typedef struct {
+  GHashTable *triangles;
+  GPtrArray *bad;
+} FaceCleanupData;
+
 
-  /* free list of edges */
-  g_slist_free (edges);
+static void
+face_cleanup_face(GtsTriangle *t, FaceCleanupData *data)
+{
+  if( triangle_is_degenerate(t) || 
+      g_hash_table_lookup(data->triangles,t) != NULL ) {
+    g_ptr_array_add(data->bad,t);
+  }
+  else {
+    g_hash_table_insert(data->triangles,t,t);
+  }
 }
 
 
 void 
 pygts_face_cleanup(GtsSurface * s)
 {
-  GSList *triangles = NULL;
-  GSList * i;
+  FaceCleanupData data;
+  GtsTriangle *t;
+  guint i;
 
   g_return_if_fail(s != NULL);
 
-  /* build list of triangles */
-  gts_surface_foreach_face(s, (GtsFunc) build_list, &triangles);
-  
-  /* remove duplicate and degenerate triangles */
-  i = triangles;
-  while(i) {
-    GtsTriangle * t = i->data;
-    if (!gts_triangle_is_ok(t)) {
-      /* destroy t, its edges (if not used by any other triangle)
-	 and its corners (if not used by any other edge) */
-      if( g_hash_table_lookup(obj_table,GTS_OBJECT(t))==NULL ) {
-	gts_object_destroy(GTS_OBJECT(t));
-      }
-      else {
-	gts_surface_remove_face(PYGTS_SURFACE_AS_GTS_SURFACE(s),GTS_FACE(t));
-      }
+  /* find duplicate and degenerate triangles */
+  data.triangles = g_hash_table_new(triangle_hash,triangle_equal);
+  data.bad = g_ptr_array_new();
+  gts_surface_foreach_face(s, (GtsFunc)face_cleanup_face, &data);
+  g_hash_table_destroy(data.triangles);
+
+  /* remove them */
+  for(i=0;i<data.bad->len;i++) {
+    t = GTS_TRIANGLE(g_ptr_array_index(data.bad,i));
+    /* destroy t, its edges (if not used by any other triangle)
+       and its corners (if not used by any other edge) */
+    if( g_hash_table_lookup(obj_table,GTS_OBJECT(t))==NULL ) {
+      gts_object_destroy(GTS_OBJECT(t));
+    }
+    else {
+      gts_surface_remove_face(s,GTS_FACE(t));
     }
-    i = g_slist_next(i);
   }
-  
-  /* free list of triangles */
-  g_slist_free(triangles);
+  g_ptr_array_free(data.bad,TRUE);
 }
 
 
@@ -146,6 +146,19 @@ compare(PygtsObject *o1, PygtsObject *o2)
 }
 
 
+/* Coordinates may be read through any attribute, and so a Surface's
+ * pending transform is applied first.
+ */
+static PyObject*
+getattro(PyObject *self, PyObject *name)
+{
+  if( pygts_surface_apply_pending_transform()==-1 ) {
+    return NULL;
+  }
+  return PyObject_GenericGetAttr(self,name);
+}
+
+
 /* Methods table */
 PyTypeObject PygtsObjectType = {
   PyObject_HEAD_INIT(NULL)
@@ -165,7 +178,7 @@ PyTypeObject PygtsObjectType = {
   0,                         /* tp_hash */
   0,                         /* tp_call */
   0,                         /* tp_str */
-  0,                         /* tp_getattro */
+  getattro,                  /* tp_getattro */
   0,                         /* tp_setattro */
   0,                         /* tp_as_buffer */
   Py_TPFLAGS_DEFAULT |
@@ -39,6 +39,16 @@
 #endif
 
 
+/* Marks the Surfaces on self as moved, if self is a Vertex */
+static void
+point_moved(PygtsPoint *self)
+{
+  if( GTS_IS_VERTEX(PYGTS_POINT_AS_GTS_POINT(self)) ) {
+    pygts_surface_vertex_moved(GTS_VERTEX(PYGTS_POINT_AS_GTS_POINT(self)));
+  }
+}
+
+
 /*-------------------------------------------------------------------------*/
 /* Methods exported to python */
 
@@ -69,6 +79,7 @@ set(PygtsPoint *self, PyObject *args)
   }
 
   gts_point_set(PYGTS_POINT_AS_GTS_POINT(self),x,y,z);
+  point_moved(self);
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -528,6 +539,7 @@ closest(PygtsPoint* self, PyObject *args)
 			       PYGTS_TRIANGLE_AS_GTS_TRIANGLE(t),
 			       PYGTS_POINT_AS_GTS_POINT(self));
   }
+  point_moved(self);
 
   Py_INCREF(self);
   return (PyObject*)self;
@@ -569,6 +581,7 @@ rotate(PygtsPoint* self, PyObject *args, PyObject *keywds)
 
   if(pygts_point_rotate(PYGTS_POINT_AS_GTS_POINT(self),dx,dy,dz,a)==-1)
     return NULL;
+  point_moved(self);
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -610,6 +623,7 @@ scale(PygtsPoint* self, PyObject *args, PyObject *keywds)
 
   if(pygts_point_scale(PYGTS_POINT_AS_GTS_POINT(self),dx,dy,dz)==-1)
     return NULL;
+  point_moved(self);
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -651,6 +665,7 @@ translate(PygtsPoint* self, PyObject *args, PyObject *keywds)
 
   if(pygts_point_translate(PYGTS_POINT_AS_GTS_POINT(self),dx,dy,dz)==-1)
     return NULL;
+  point_moved(self);
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -833,6 +848,7 @@ setx(PygtsPoint *self, PyObject *value, void *closure)
     PyErr_SetString(PyExc_TypeError,"expected a float");
     return -1;
   }
+  point_moved(self);
   return 0;
 }
 
@@ -859,6 +875,7 @@ sety(PygtsPoint *self, PyObject *value, void *closure)
     PyErr_SetString(PyExc_TypeError,"expected a float");
     return -1;
   }
+  point_moved(self);
   return 0;
 }
 
@@ -885,6 +902,7 @@ setz(PygtsPoint *self, PyObject *value, void *closure)
     PyErr_SetString(PyExc_TypeError,"expected a float");
     return -1;
   }
+  point_moved(self);
   return 0;
 }
 
@@ -979,6 +997,8 @@ compare(PygtsPoint *p1_, PygtsPoint *p2_)
   pygts_point_check((PyObject*)p2_);
 #endif
 
+  if( pygts_surface_apply_pending_transform()==-1 ) return -1;
+
   p1 = PYGTS_POINT_AS_GTS_POINT(p1_);
   p2 = PYGTS_POINT_AS_GTS_POINT(p2_);
 
@@ -0,0 +1,615 @@
+/* pygts - python package for the manipulation of triangulated surfaces
+ *
+ *   Copyright (C) 2009 Thomas J. Duck
+ *   All rights reserved.
+ *
+ *   Thomas J. Duck <tom.duck@dal.ca>
+ *   Department of Physics and Atmospheric Science,
+ *   Dalhousie University, Halifax, Nova Scotia, Canada, B3H 3J5
+ *
+ * NOTICE
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, write to the
+ *   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ *   Boston, MA 02111-1307, USA.
+ */
+
+
+#include "pygts.h"
+
+#if PYGTS_DEBUG
+  #define SELF_CHECK if(!pygts_progressive_surface_check((PyObject*)self)) { \
+                       PyErr_SetString(PyExc_RuntimeError,            \
+                       "problem with self object (internal error)");  \
+		       return NULL;                                   \
+                     }
+#else
+  #define SELF_CHECK
+#endif
+
+#define OPEN_CHECK if(self->fp!=NULL) {                                   \
+                     PyErr_SetString(PyExc_RuntimeError,                  \
+                       "ProgressiveSurface is open for reading; "         \
+                       "read the remaining vertices or close() it first"); \
+		     return NULL;                                         \
+                   }
+
+
+/* Helper function; finishes reading from the file */
+static void
+close_file(PygtsProgressiveSurface *self)
+{
+  if(self->fp!=NULL) {
+    gts_psurface_close(PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self));
+    gts_file_destroy(self->fp);
+    self->fp = NULL;
+  }
+  Py_XDECREF(self->f);
+  self->f = NULL;
+}
+
+
+/*-------------------------------------------------------------------------*/
+/* Methods exported to python */
+
+static PyObject*
+is_ok(PygtsProgressiveSurface *self, PyObject *args)
+{
+  if(pygts_progressive_surface_is_ok(self)) {
+    Py_INCREF(Py_True);
+    return Py_True;
+  }
+  else {
+    Py_INCREF(Py_False);
+    return Py_False;
+  }
+}
+
+
+static PyObject*
+is_open(PygtsProgressiveSurface *self, PyObject *args)
+{
+  SELF_CHECK
+
+  if(self->fp!=NULL) {
+    Py_INCREF(Py_True);
+    return Py_True;
+  }
+  else {
+    Py_INCREF(Py_False);
+    return Py_False;
+  }
+}
+
+
+static PyObject*
+add_vertex(PygtsProgressiveSurface *self, PyObject *args)
+{
+  SELF_CHECK
+  OPEN_CHECK
+
+  if( gts_psurface_add_vertex(PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self))
+      != NULL ) {
+    Py_INCREF(Py_True);
+    return Py_True;
+  }
+  else {
+    Py_INCREF(Py_False);
+    return Py_False;
+  }
+}
+
+
+static PyObject*
+remove_vertex(PygtsProgressiveSurface *self, PyObject *args)
+{
+  SELF_CHECK
+  OPEN_CHECK
+
+  if( gts_psurface_remove_vertex(
+          PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)) != NULL ) {
+    Py_INCREF(Py_True);
+    return Py_True;
+  }
+  else {
+    Py_INCREF(Py_False);
+    return Py_False;
+  }
+}
+
+
+static PyObject*
+set_vertex_number(PygtsProgressiveSurface *self, PyObject *args)
+{
+  gint n;
+
+  SELF_CHECK
+  OPEN_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTuple(args,"i", &n) ) {
+    return NULL;
+  }
+
+  if(n<0) {
+    PyErr_SetString(PyExc_ValueError,"expected a non-negative number");
+    return NULL;
+  }
+
+  /* Make the call */
+  gts_psurface_set_vertex_number(
+      PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self), n);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+static PyObject*
+surface(PygtsProgressiveSurface *self, PyObject *args)
+{
+  GtsSurface *s;
+  PygtsSurface *surface;
+
+  SELF_CHECK
+
+  /* Copy the current level of detail into a new Surface */
+  if( (s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			   gts_edge_class(), gts_vertex_class())) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+    return NULL;
+  }
+  gts_surface_copy(s, PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)->s);
+
+  if( (surface = pygts_surface_new(s)) == NULL )  {
+    gts_object_destroy(GTS_OBJECT(s));
+    return NULL;
+  }
+
+  return (PyObject*)surface;
+}
+
+
+static PyObject*
+pygts_write(PygtsProgressiveSurface *self, PyObject *args)
+{
+  PyObject *f_;
+  FILE *f;
+
+  SELF_CHECK
+  OPEN_CHECK
+
+  /* Parse the args */  
+  if(! PyArg_ParseTuple(args, "O", &f_) )
+    return NULL;
+
+  /* Convert to PygtsObjects */
+  if(!PyFile_Check(f_)) {
+    PyErr_SetString(PyExc_TypeError,"expected a File");
+    return NULL;
+  }
+  f = PyFile_AsFile(f_);
+
+  /* Write to the file */
+  gts_psurface_write(PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self),f);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+static PyObject*
+read_vertices(PygtsProgressiveSurface *self, PyObject *args)
+{
+  gint n=-1, i=0;
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTuple(args,"|i", &n) ) {
+    return NULL;
+  }
+
+  if(self->fp==NULL) {
+    PyErr_SetString(PyExc_RuntimeError,"ProgressiveSurface is not open");
+    return NULL;
+  }
+
+  /* Read the vertex splits */
+  while(n<0 || i<n) {
+    if( gts_psurface_read_vertex(
+            PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self),self->fp)
+	== NULL ) {
+      if(self->fp->type == GTS_ERROR) {
+	PyErr_SetString(PyExc_RuntimeError,self->fp->error);
+	close_file(self);
+	return NULL;
+      }
+      /* Finished */
+      close_file(self);
+      break;
+    }
+    i++;
+  }
+
+  return Py_BuildValue("i",i);
+}
+
+
+static PyObject*
+pygts_close(PygtsProgressiveSurface *self, PyObject *args)
+{
+  SELF_CHECK
+
+  close_file(self);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+/* Methods table */
+static PyMethodDef methods[] = {
+  {"is_ok", (PyCFunction)is_ok,
+   METH_NOARGS,
+   "True if this ProgressiveSurface ps is OK.  False otherwise.\n"
+   "\n"
+   "Signature: ps.is_ok()\n"
+  },
+
+  {"is_open", (PyCFunction)is_open,
+   METH_NOARGS,
+   "True if ProgressiveSurface ps is still reading vertices from a\n"
+   "File.  False otherwise.\n"
+   "\n"
+   "Signature: ps.is_open()\n"
+  },
+
+  {"add_vertex", (PyCFunction)add_vertex,
+   METH_NOARGS,
+   "Splits the next vertex of ProgressiveSurface ps.  Returns True\n"
+   "if a vertex was added, or False if ps is at full resolution.\n"
+   "\n"
+   "Signature: ps.add_vertex()\n"
+  },
+
+  {"remove_vertex", (PyCFunction)remove_vertex,
+   METH_NOARGS,
+   "Collapses the last vertex split of ProgressiveSurface ps.  Returns\n"
+   "True if a vertex was removed, or False if ps is at its coarsest.\n"
+   "\n"
+   "Signature: ps.remove_vertex()\n"
+  },
+
+  {"set_vertex_number", (PyCFunction)set_vertex_number,
+   METH_VARARGS,
+   "Splits or collapses vertices of ProgressiveSurface ps until it has\n"
+   "n vertices, or as close as ps.Nvertices_min and ps.Nvertices_max\n"
+   "allow.  The time taken is proportional to the change.\n"
+   "\n"
+   "Signature: ps.set_vertex_number(n)\n"
+  },
+
+  {"surface", (PyCFunction)surface,
+   METH_NOARGS,
+   "Returns a new Surface copied from the current level of detail of\n"
+   "ProgressiveSurface ps.\n"
+   "\n"
+   "Signature: ps.surface()\n"
+  },
+
+  {"write", (PyCFunction)pygts_write,
+   METH_VARARGS,
+   "Saves ProgressiveSurface ps to File f as the coarsest Surface\n"
+   "followed by the vertex splits, in GTS format.  Read it back with\n"
+   "gts.read_progressive(f).\n"
+   "\n"
+   "Signature: ps.write(f)\n"
+  },
+
+  {"read_vertices", (PyCFunction)read_vertices,
+   METH_VARARGS,
+   "Reads up to n vertex splits into an open ProgressiveSurface ps,\n"
+   "or all of the remaining splits if n is not given.  ps is closed\n"
+   "when the File has no more splits.  Returns the number read.\n"
+   "\n"
+   "Signature: ps.read_vertices() or ps.read_vertices(n)\n"
+  },
+
+  {"close", (PyCFunction)pygts_close,
+   METH_NOARGS,
+   "Stops reading vertex splits into ProgressiveSurface ps.  The\n"
+   "splits read so far are kept.\n"
+   "\n"
+   "Signature: ps.close()\n"
+  },
+
+  {NULL}  /* Sentinel */
+};
+
+
+/*-------------------------------------------------------------------------*/
+/* Attributes exported to python */
+
+static PyObject *
+get_Nvertices(PygtsProgressiveSurface *self, void *closure)
+{
+  SELF_CHECK
+  return Py_BuildValue("i",gts_surface_vertex_number(
+      PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)->s));
+}
+
+
+static PyObject *
+get_Nvertices_min(PygtsProgressiveSurface *self, void *closure)
+{
+  SELF_CHECK
+  return Py_BuildValue("i",gts_psurface_min_vertex_number(
+      PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)));
+}
+
+
+static PyObject *
+get_Nvertices_max(PygtsProgressiveSurface *self, void *closure)
+{
+  SELF_CHECK
+  return Py_BuildValue("i",gts_psurface_max_vertex_number(
+      PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)));
+}
+
+
+/* Methods table */
+static PyGetSetDef getset[] = {
+  { "Nvertices", (getter)get_Nvertices, NULL, 
+    "The number of vertices at the current level of detail", NULL
+  },
+
+  { "Nvertices_min", (getter)get_Nvertices_min, NULL, 
+    "The number of vertices at the coarsest level of detail", NULL
+  },
+
+  { "Nvertices_max", (getter)get_Nvertices_max, NULL, 
+    "The number of vertices at full resolution", NULL
+  },
+
+  {NULL}  /* Sentinel */
+};
+
+
+/*-------------------------------------------------------------------------*/
+/* Python type methods */
+
+static void
+dealloc(PygtsProgressiveSurface* self)
+{
+  GtsSurface *s=NULL;
+
+  close_file(self);
+
+  /* The GtsPSurface does not own its GtsSurface */
+  if(PYGTS_OBJECT(self)->gtsobj!=NULL) {
+    s = PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(self)->s;
+  }
+
+  /* Chain up */
+  PygtsObjectType.tp_dealloc((PyObject*)self);
+
+  if(s!=NULL) {
+    gts_object_destroy(GTS_OBJECT(s));
+  }
+}
+
+
+static PyObject *
+new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+  PyObject *o;
+  PygtsObject *obj;
+  PyObject *s_;
+  GtsSurface *s;
+  GtsPSurface *ps=NULL;
+  guint alloc_gtsobj = TRUE;
+  guint n=0;
+  gdouble amin=0.;
+  GtsVolumeOptimizedParams params = {0.5,0.5,1.e-10};
+
+  /* Parse the args */
+  if(kwds) {
+    o = PyDict_GetItemString(kwds,"alloc_gtsobj");
+    if(o==Py_False) {
+      alloc_gtsobj = FALSE;
+    }
+    if(o!=NULL) {
+      PyDict_DelItemString(kwds, "alloc_gtsobj");
+    }
+  }
+  if(kwds) {
+    Py_INCREF(Py_False);
+    PyDict_SetItemString(kwds,"alloc_gtsobj", Py_False);
+  }
+
+  /* Allocate the gtsobj (if needed) */
+  if( alloc_gtsobj ) {
+
+    /* Parse the args */
+    if(! PyArg_ParseTuple(args,"O|id", &s_, &n, &amin) ) {
+      return NULL;
+    }
+
+    /* Convert to PygtsObjects */
+    if(!pygts_surface_check(s_)) {
+      PyErr_SetString(PyExc_TypeError,"expected a Surface");
+      return NULL;
+    }
+
+    /* Coarsen a copy so that the Surface given is left unchanged */
+    if( pygts_surface_apply_pending_transform()==-1 ) {
+      return NULL;
+    }
+    if( (s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			     gts_edge_class(), gts_vertex_class())) == NULL ) {
+      PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+      return NULL;
+    }
+    gts_surface_copy(s, PYGTS_SURFACE_AS_GTS_SURFACE(s_));
+
+    ps = gts_psurface_new(gts_psurface_class(), s, gts_split_class(),
+			  (GtsKeyFunc)gts_volume_optimized_cost, &params,
+			  (GtsCoarsenFunc)gts_volume_optimized_vertex, &params,
+			  (GtsStopFunc)gts_coarsen_stop_number, &n, amin);
+    if( ps == NULL )  {
+      gts_object_destroy(GTS_OBJECT(s));
+      PyErr_SetString(PyExc_MemoryError, 
+		      "could not create ProgressiveSurface");
+      return NULL;
+    }
+  }
+
+  /* Chain up */
+  obj = PYGTS_OBJECT(PygtsObjectType.tp_new(type,args,kwds));
+
+  PYGTS_PROGRESSIVE_SURFACE(obj)->fp = NULL;
+  PYGTS_PROGRESSIVE_SURFACE(obj)->f = NULL;
+
+  if( alloc_gtsobj ) {
+    obj->gtsobj = GTS_OBJECT(ps);
+    pygts_object_register(obj);
+  }
+
+  return (PyObject*)obj;
+}
+
+
+static int
+init(PygtsProgressiveSurface *self, PyObject *args, PyObject *kwds)
+{
+  gint ret;
+
+  if( (ret = PygtsObjectType.tp_init((PyObject*)self,args,kwds)) != 0 ) {
+    return ret;
+  }
+
+  return 0;
+}
+
+
+/* Methods table */
+PyTypeObject PygtsProgressiveSurfaceType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                       /* ob_size */
+    "gts.ProgressiveSurface",/* tp_name */
+    sizeof(PygtsProgressiveSurface), /* tp_basicsize */
+    0,                       /* tp_itemsize */
+    (destructor)dealloc,     /* tp_dealloc */
+    0,                       /* tp_print */
+    0,                       /* tp_getattr */
+    0,                       /* tp_setattr */
+    0,                       /* tp_compare */
+    0,                       /* tp_repr */
+    0,                       /* tp_as_number */
+    0,                       /* tp_as_sequence */
+    0,                       /* tp_as_mapping */
+    0,                       /* tp_hash */
+    0,                       /* tp_call */
+    0,                       /* tp_str */
+    0,                       /* tp_getattro */
+    0,                       /* tp_setattro */
+    0,                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+      Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    "ProgressiveSurface object", /* tp_doc */
+    0,                       /* tp_traverse */
+    0,                       /* tp_clear */
+    0,                       /* tp_richcompare */
+    0,                       /* tp_weaklistoffset */
+    0,                       /* tp_iter */
+    0,                       /* tp_iternext */
+    methods,                 /* tp_methods */
+    0,                       /* tp_members */
+    getset,                  /* tp_getset */
+    0,                       /* tp_base */
+    0,                       /* tp_dict */
+    0,                       /* tp_descr_get */
+    0,                       /* tp_descr_set */
+    0,                       /* tp_dictoffset */
+    (initproc)init,          /* tp_init */
+    0,                       /* tp_alloc */
+    (newfunc)new             /* tp_new */
+};
+
+
+/*-------------------------------------------------------------------------*/
+/* Pygts functions */
+
+gboolean 
+pygts_progressive_surface_check(PyObject* o)
+{
+  if(! PyObject_TypeCheck(o, &PygtsProgressiveSurfaceType)) {
+    return FALSE;
+  }
+  else {
+#if PYGTS_DEBUG
+    return pygts_progressive_surface_is_ok(PYGTS_PROGRESSIVE_SURFACE(o));
+#else
+    return TRUE;
+#endif
+  }
+}
+
+
+gboolean 
+pygts_progressive_surface_is_ok(PygtsProgressiveSurface *ps)
+{
+  PygtsObject *obj;
+
+  obj = PYGTS_OBJECT(ps);
+
+  if(!pygts_object_is_ok(PYGTS_OBJECT(ps))) return FALSE;
+  g_return_val_if_fail(obj->gtsobj_parent==NULL,FALSE);
+  g_return_val_if_fail(GTS_PSURFACE(obj->gtsobj)->s!=NULL,FALSE);
+
+  return TRUE;
+}
+
+
+PygtsProgressiveSurface *
+pygts_progressive_surface_new(GtsPSurface *ps) {
+  PyObject *args, *kwds;
+  PygtsObject *psurface;
+
+  /* Check for ProgressiveSurface in the object table */
+  if( (psurface = PYGTS_OBJECT(g_hash_table_lookup(obj_table,
+						   GTS_OBJECT(ps)))) 
+      !=NULL ) {
+    Py_INCREF(psurface);
+    return PYGTS_PROGRESSIVE_SURFACE(psurface);
+  }
+
+  /* Build a new ProgressiveSurface */
+  args = Py_BuildValue("()");
+  kwds = Py_BuildValue("{s:O}","alloc_gtsobj",Py_False);
+  psurface = PYGTS_OBJECT(PygtsProgressiveSurfaceType.tp_new(
+                              &PygtsProgressiveSurfaceType,args,kwds));
+  Py_DECREF(args);
+  Py_DECREF(kwds);
+  if( psurface == NULL ) {
+    PyErr_SetString(PyExc_MemoryError, "could not create ProgressiveSurface");
+    return NULL;
+  }
+  psurface->gtsobj = GTS_OBJECT(ps);
+
+  /* Register and return */
+  pygts_object_register(psurface);
+  return PYGTS_PROGRESSIVE_SURFACE(psurface);
+}
@@ -0,0 +1,51 @@
+/* pygts - python package for the manipulation of triangulated surfaces
+ *
+ *   Copyright (C) 2009 Thomas J. Duck
+ *   All rights reserved.
+ *
+ *   Thomas J. Duck <tom.duck@dal.ca>
+ *   Department of Physics and Atmospheric Science,
+ *   Dalhousie University, Halifax, Nova Scotia, Canada, B3H 3J5
+ *
+ * NOTICE
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, write to the
+ *   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ *   Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __PYGTS_PSURFACE_H__
+#define __PYGTS_PSURFACE_H__
+
+typedef struct _PygtsProgressiveSurface PygtsProgressiveSurface;
+
+#define PYGTS_PROGRESSIVE_SURFACE(o) ((PygtsProgressiveSurface*)o)
+
+#define PYGTS_PROGRESSIVE_SURFACE_AS_GTS_PSURFACE(o) \
+  (GTS_PSURFACE(PYGTS_OBJECT(o)->gtsobj))
+
+struct _PygtsProgressiveSurface {
+  PygtsObject o;
+  GtsFile *fp;   /* File being read from while the ProgressiveSurface is open */
+  PyObject *f;   /* The python File that fp reads */
+};
+
+extern PyTypeObject PygtsProgressiveSurfaceType;
+
+gboolean pygts_progressive_surface_check(PyObject* o);
+gboolean pygts_progressive_surface_is_ok(PygtsProgressiveSurface *ps);
+PygtsProgressiveSurface* pygts_progressive_surface_new(GtsPSurface *ps);
+
+#endif /* __PYGTS_PSURFACE_H__ */
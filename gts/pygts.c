@@ -45,6 +45,11 @@ merge(PyObject *self, PyObject *args)
   if(! PyArg_ParseTuple(args, "Od", &tuple, &epsilon) ) {
     return NULL;
   }
+
+  /* The vertices may belong to a Surface with a pending transform */
+  if( pygts_surface_apply_pending_transform()==-1 ) {
+    return NULL;
+  }
   if(PyList_Check(tuple)) {
     tuple = PyList_AsTuple(tuple);
   }
@@ -73,6 +78,9 @@ merge(PyObject *self, PyObject *args)
 
   /* Make the call */
   vertices = pygts_vertices_merge(vertices,epsilon,NULL);
+  for(v=vertices;v!=NULL;v=g_list_next(v)) {
+    pygts_surface_vertex_changed(GTS_VERTEX(v->data));
+  }
 
   /* Assemble the return tuple */
   N = g_list_length(vertices);
@@ -361,6 +369,11 @@ triangle_enclosing(PyObject *self, PyObject *args)
   if(! PyArg_ParseTuple(args, "O", &tuple) ) {
     return NULL;
   }
+
+  /* The vertices may belong to a Surface with a pending transform */
+  if( pygts_surface_apply_pending_transform()==-1 ) {
+    return NULL;
+  }
   if(PyList_Check(tuple)) {
     tuple = PyList_AsTuple(tuple);
   }
@@ -458,6 +471,64 @@ pygts_read(PygtsSurface *self, PyObject *args)
 }
 
 
+static PyObject*
+read_progressive(PyObject *self, PyObject *args)
+{
+  PyObject *f_;
+  FILE *f;
+  GtsFile *fp;
+  GtsSurface *s;
+  GtsPSurface *ps;
+  PygtsProgressiveSurface *psurface;
+
+  /* Parse the args */  
+  if(! PyArg_ParseTuple(args, "O", &f_) )
+    return NULL;
+
+  /* Convert to PygtsObjects */
+  if(!PyFile_Check(f_)) {
+    PyErr_SetString(PyExc_TypeError,"expected a File");
+    return NULL;
+  }
+  f = PyFile_AsFile(f_);
+
+  if(feof(f)) {
+    PyErr_SetString(PyExc_EOFError,"End of File");
+    return NULL;
+  }
+
+  /* Create the surface to read into */
+  if( (s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			   gts_edge_class(), gts_vertex_class())) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+    return NULL;
+  }
+
+  /* Read the coarsest surface; the vertex splits are read later */
+  fp = gts_file_new(f);
+  if( (ps = gts_psurface_open(gts_psurface_class(), s, gts_split_class(),
+			      fp)) == NULL ) {
+    PyErr_SetString(PyExc_RuntimeError,fp->error);
+    gts_file_destroy(fp);
+    gts_object_destroy(GTS_OBJECT(s));
+    return NULL;
+  }
+
+  if( (psurface = pygts_progressive_surface_new(ps)) == NULL )  {
+    gts_psurface_close(ps);
+    gts_file_destroy(fp);
+    gts_object_destroy(GTS_OBJECT(ps));
+    gts_object_destroy(GTS_OBJECT(s));
+    return NULL;
+  }
+  psurface->fp = fp;
+  Py_INCREF(f_);
+  psurface->f = f_;
+
+  return (PyObject*)psurface;
+}
+
+
 static PyObject*
 sphere(PyObject *self, PyObject *args)
 {
@@ -505,218 +576,1908 @@ static void isofunc(gdouble **f, GtsCartesianGrid g, guint k, gpointer data)
   }
 }
 
-#define ISO_CLEANUP \
-  if (scalars) { Py_DECREF(scalars); } \
-  if (extents) { Py_DECREF(extents); }
 
-static PyObject*
-isosurface(PyObject *self, PyObject *args, PyObject *kwds)
+/* Helper for pygts_iso when the data is given as a callable or iterator
+ * of 2D slices.  GTS only ever needs two adjacent slices at a time, and
+ * so only the two most recently retrieved slices are held.
+ */
+typedef struct {
+  PyObject *source;          /* Callable f(k) or iterator of slices */
+  gboolean is_callable;
+  PyArrayObject *slices[2];  /* The two most recently retrieved slices */
+  gint k[2];                 /* Their indices (-1 if unset) */
+  gint knext;                /* Index of the next slice from an iterator */
+  guint nx,ny;               /* Slice dimensions */
+  gboolean errflag;
+} IsoSliceData;
+
+/* Helper for pygts_iso to retrieve slice k from the slice source */
+static PyArrayObject*
+isoslice_get(IsoSliceData *data, gint k)
 {
-  double isoval[1];
-  PyObject *Oscalars = NULL, *Oextents = NULL;
-  PyArrayObject *scalars = NULL, *extents = NULL;
-  GtsCartesianGrid g;
-  GtsSurface *s;
-  PygtsSurface *surface;
-  char *method = "cubes";
-  
-  static char *kwlist[] = {"scalars", "isoval", "method", "extents", NULL};
+  PyObject *obj;
+  PyArrayObject *slice;
+  gint n;
 
-  if(!PyArg_ParseTupleAndKeywords(args, kwds, "Od|sO", kwlist, 
-				  &Oscalars, isoval, &method, &Oextents)) {
-    return NULL;
+  /* Check the cache */
+  for(n=0;n<2;n++) {
+    if(data->slices[n]!=NULL && data->k[n]==k) return data->slices[n];
   }
-  
-  if(!(scalars = (PyArrayObject *) 
-       PyArray_ContiguousFromObject(Oscalars, PyArray_DOUBLE, 3, 3))) {
-    ISO_CLEANUP;
+
+  /* Retrieve the slice */
+  if(data->is_callable) {
+    if( (obj = PyObject_CallFunction(data->source,"i",k)) == NULL ) {
+      return NULL;
+    }
+  }
+  else {
+    if( k != data->knext ) {
+      PyErr_SetString(PyExc_RuntimeError,
+		      "slices requested out of order (internal error)");
+      return NULL;
+    }
+    if( (obj = PyIter_Next(data->source)) == NULL ) {
+      if(!PyErr_Occurred()) {
+	PyErr_SetString(PyExc_ValueError,"too few slices for nz");
+      }
+      return NULL;
+    }
+    data->knext += 1;
+  }
+  slice = (PyArrayObject*)PyArray_ContiguousFromObject(obj,PyArray_DOUBLE,2,2);
+  Py_DECREF(obj);
+  if(slice==NULL) return NULL;
+
+  /* The first slice sets the dimensions */
+  if(data->nx==0 && data->ny==0) {
+    data->nx = slice->dimensions[0];
+    data->ny = slice->dimensions[1];
+  }
+  if(slice->dimensions[0]!=data->nx || slice->dimensions[1]!=data->ny) {
+    PyErr_SetString(PyExc_ValueError,"slices must all have the same shape");
+    Py_DECREF(slice);
     return NULL;
   }
 
-  if(Oextents && 
-     (!(extents =  (PyArrayObject *)
-	PyArray_ContiguousFromObject(Oextents, PyArray_DOUBLE, 1, 1)))) {
-    ISO_CLEANUP;
-    return NULL;
+  /* Replace the oldest slice in the cache */
+  n = (data->slices[0]==NULL || (data->slices[1]!=NULL && 
+				 data->k[0]<data->k[1])) ? 0 : 1;
+  Py_XDECREF(data->slices[n]);
+  data->slices[n] = slice;
+  data->k[n] = k;
+
+  return slice;
+}
+
+/* Helper for pygts_iso to fill f with a layer of data from a slice source */
+static void isofunc_slices(gdouble **f, GtsCartesianGrid g, guint k,
+			   gpointer data_)
+{
+  IsoSliceData *data = (IsoSliceData*)data_;
+  PyArrayObject *slice;
+  guint i, j;
+
+  if(!data->errflag) {
+    if( (slice = isoslice_get(data,k)) != NULL ) {
+      for (i = 0; i < data->nx; i++) {
+	for (j = 0; j < data->ny; j++) {
+	  f[i][j] = *(gdouble *)(slice->data + i*slice->strides[0] + \
+				 j*slice->strides[1]);
+	}
+      }
+      return;
+    }
+    data->errflag = TRUE;
   }
 
-  if(extents && extents->dimensions[0] < 6) {
-    PyErr_SetString(PyExc_ValueError, "extents must have at least 6 elements");
-    ISO_CLEANUP;
-    return NULL;
+  /* Once there is an error, just let GTS run out the slices */
+  for (i = 0; i < data->nx; i++) {
+    for (j = 0; j < data->ny; j++) {
+      f[i][j] = 0.;
+    }
   }
-  
-  if(extents) {
-    int s = extents->strides[0];
-    g.x = *(gdouble*)(extents->data + 0*s);
-    g.nx = scalars->dimensions[0];
-    g.dx = (*(gdouble*)(extents->data + 1*s) - \
-	    *(gdouble*)(extents->data + 0* s))/(g.nx-1);
+}
 
-    g.y = *(gdouble*)(extents->data + 2*s);
-    g.ny = scalars->dimensions[1];
-    g.dy = (*(gdouble*)(extents->data + 3*s) - \
-	    *(gdouble*)(extents->data + 2*s))/(g.ny-1);
+/* Helper for pygts_iso to fill f with a layer of data from a block of
+ * scalar.  The offsets give the position of the block in scalar.
+ */
+typedef struct {
+  PyArrayObject *scalars;
+  guint i0, j0, k0;
+} IsoBlockData;
 
-    g.z = *(gdouble*)(extents->data + 4*s);
-    g.nz = scalars->dimensions[2];
-    g.dz = (*(gdouble*)(extents->data + 5*s) - \
-	    *(gdouble*)(extents->data + 4*s))/(g.nz-1);
-  }
-  else {
-    g.x = -1.0;
-    g.nx = scalars->dimensions[0];
-    g.dx = 2.0/(scalars->dimensions[0]-1);
-    g.y = -1.0;
-    g.ny = scalars->dimensions[1];
-    g.dy = 2.0/(scalars->dimensions[1]-1);
-    g.z = -1.0;
-    g.nz = scalars->dimensions[2];
-    g.dz = 2.0/(scalars->dimensions[2]-1);
+static void isofunc_block(gdouble **f, GtsCartesianGrid g, guint k,
+			  gpointer data_)
+{
+  IsoBlockData *data = (IsoBlockData*)data_;
+  PyArrayObject *scalars = data->scalars;
+  guint i, j;
+
+  for (i = 0; i < g.nx; i++) {
+    for (j = 0; j < g.ny; j++) {
+      f[i][j] = *(gdouble *)(scalars->data + 
+			     (data->i0+i)*scalars->strides[0] +
+			     (data->j0+j)*scalars->strides[1] + 
+			     (data->k0+k)*scalars->strides[2]);
+    }
   }
+}
 
-  /* Create the surface */
-  if((s = gts_surface_new(gts_surface_class(), gts_face_class(),
-			  gts_edge_class(), gts_vertex_class())) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+
+/* Default side-length of the blocks, in cells */
+#define ISO_BLOCKSIZE 8
+
+/* Helper for isosurface_blocks() and isosurface(); returns the number of 
+ * blocks of side-length blocksize cells needed to span n samples.
+ */
+#define ISO_NBLOCKS(n,blocksize) ( (n)>1 ? ((n)-2)/(blocksize)+1 : 0 )
+
+/* Helper for isosurface_blocks() and isosurface(); returns an array with
+ * the (min,max) of scalars over the samples of each block of cells.
+ */
+static PyArrayObject*
+iso_blocks_new(PyArrayObject *scalars, gint blocksize)
+{
+  PyArrayObject *blocks;
+  npy_intp dims[4];
+  gdouble *b, value, vmin, vmax;
+  guint nx, ny, nz, bi, bj, bk, i, j, k;
+
+  nx = scalars->dimensions[0];
+  ny = scalars->dimensions[1];
+  nz = scalars->dimensions[2];
+
+  dims[0] = ISO_NBLOCKS(nx,blocksize);
+  dims[1] = ISO_NBLOCKS(ny,blocksize);
+  dims[2] = ISO_NBLOCKS(nz,blocksize);
+  dims[3] = 2;
+
+  if( (blocks = (PyArrayObject*)PyArray_SimpleNew(4,dims,PyArray_DOUBLE))
+      == NULL ) {
     return NULL;
   }
+  b = (gdouble*)blocks->data;
+
+  /* The samples on the faces of a block are shared with its neighbours */
+  for(bi=0;bi<dims[0];bi++) {
+    for(bj=0;bj<dims[1];bj++) {
+      for(bk=0;bk<dims[2];bk++) {
+	vmin = G_MAXDOUBLE;
+	vmax = -G_MAXDOUBLE;
+	for(i=bi*blocksize; i<=MIN((bi+1)*blocksize,nx-1); i++) {
+	  for(j=bj*blocksize; j<=MIN((bj+1)*blocksize,ny-1); j++) {
+	    for(k=bk*blocksize; k<=MIN((bk+1)*blocksize,nz-1); k++) {
+	      value = *(gdouble *)(scalars->data + i*scalars->strides[0] + 
+				   j*scalars->strides[1] + 
+				   k*scalars->strides[2]);
+	      if(value<vmin) vmin = value;
+	      if(value>vmax) vmax = value;
+	    }
+	  }
+	}
+	b[0] = vmin;
+	b[1] = vmax;
+	b += 2;
+      }
+    }
+  }
 
-  /* Make the call */
-  switch(method[0]) {
+  return blocks;
+}
+
+
+/* Helper for pygts_iso to run the isosurface method on grid g */
+static gboolean
+iso_march(GtsSurface *s, GtsCartesianGrid g, char method,
+	  GtsIsoCartesianFunc func, gpointer data, gdouble isoval)
+{
+  switch(method) {
   case 'c': /* cubes */
-    gts_isosurface_cartesian(s, g, isofunc, scalars, isoval[0]);
+    gts_isosurface_cartesian(s, g, func, data, isoval);
     break;
   case 't': /* tetra */
-    gts_isosurface_tetra(s, g, isofunc, scalars, isoval[0]);
-    /* *** ATTENTION ***
-     * Isosurface produced is "inside-out", and so we must revert it.
-     * This is a bug in GTS.
-     */
-    gts_surface_foreach_face(s, (GtsFunc)gts_triangle_revert, NULL);
-    /* *** ATTENTION *** */
+    gts_isosurface_tetra(s, g, func, data, isoval);
     break;
   case 'b': /* tetra bounded */
-    gts_isosurface_tetra_bounded(s, g, isofunc, scalars, isoval[0]);
-    /* *** ATTENTION ***
-     * Isosurface produced is "inside-out", and so we must revert it.
-     * This is a bug in GTS.
-     */
-    gts_surface_foreach_face(s, (GtsFunc)gts_triangle_revert, NULL);
-    /* *** ATTENTION *** */
+    gts_isosurface_tetra_bounded(s, g, func, data, isoval);
     break;
   case 'd': /* tetra bcl*/
-    gts_isosurface_tetra_bcl(s, g, isofunc, scalars, isoval[0]);
-    /* *** ATTENTION ***
-     * Isosurface produced is "inside-out", and so we must revert it.
-     * This is a bug in GTS.
-     */
-    gts_surface_foreach_face(s, (GtsFunc)gts_triangle_revert, NULL);
-    /* *** ATTENTION *** */
+    gts_isosurface_tetra_bcl(s, g, func, data, isoval);
     break;
   default:
-    PyErr_SetString(PyExc_ValueError, "unknown method");
-    ISO_CLEANUP;
-    return NULL;
-  }    
-
-  ISO_CLEANUP;
-
-  if( (surface = pygts_surface_new(s)) == NULL )  {
-    gts_object_destroy(GTS_OBJECT(s));
-    return NULL;
+    return FALSE;
   }
-
-  return (PyObject*)surface;
+  return TRUE;
 }
 
-#endif /* PYGTS_HAS_NUMPY */
 
+/* Helpers for the direct marcher used by isosurface(..., output='arrays')
+ * with the cubes and tetra methods.  The triangles are emitted straight
+ * into arrays, without creating any GTS objects.  Each vertex lies on an
+ * edge of the grid (or, for tetra, on a diagonal of a cell) and is kept
+ * in a table of the edges of the two layers of samples being marched, 
+ * so that the cells sharing the edge share the vertex.
+ */
+typedef struct {
+  GArray *coords;     /* x,y,z of each vertex */
+  GArray *keys;       /* Grid edge of each vertex */
+  GArray *triangles;  /* Vertex indices of each triangle */
+  guint nx, ny;       /* Size of the whole grid */
+} IsoArrays;
+
+/* State of a march; the cells are between layers k and k+1 */
+typedef struct {
+  IsoArrays *out;
+  GtsCartesianGrid g;
+  guint i0, j0, k0;   /* Position of g in the whole grid */
+  guint i, j, k;      /* The cell being marched */
+  gdouble v[8];       /* Values at the corners of the cell */
+  gdouble isoval;
+  gint *layer[2][3];  /* Vertices on the edges within layers k and k+1 */
+  gint *slab[4];      /* Vertices on the edges between the layers */
+} IsoMarch;
+
+/* The corners of a cell are numbered x+2y+4z.  The edge between corners
+ * a and b, where the bits of a are a subset of those of b, is keyed by
+ * the position of a and by its direction b^a.
+ */
+#define ISO_INSIDE(m,c) ((m)->v[c]<(m)->isoval)
 
-static PyMethodDef gts_methods[] = {
+static void
+iso_arrays_init(IsoArrays *a, guint nx, guint ny)
+{
+  a->coords = g_array_new(FALSE,FALSE,sizeof(gdouble));
+  a->keys = g_array_new(FALSE,FALSE,sizeof(guint64));
+  a->triangles = g_array_new(FALSE,FALSE,sizeof(gint));
+  a->nx = nx;
+  a->ny = ny;
+}
 
-  {"read", (PyCFunction)pygts_read,
-   METH_VARARGS,
-   "Returns the data read from File f as a Surface.\n"
-   "The File data must be in GTS format (e.g., as written using\n"
-   "Surface.write())\n"
-   "\n"
-   "Signature: read(f)\n"
-  },
+static void
+iso_arrays_free(IsoArrays *a)
+{
+  g_array_free(a->coords,TRUE);
+  g_array_free(a->keys,TRUE);
+  g_array_free(a->triangles,TRUE);
+}
 
-  { "sphere", sphere, METH_VARARGS,
-    "Returns a unit sphere generated by recursive subdivision.\n"
-    "First approximation is an isocahedron; each level of refinement\n"
-    "(geodesation_order) increases the number of triangles by a factor\n"
-    "of 4.\n"
-    "\n"
-    "Signature: sphere(geodesation_order)\n"
-  },
+/* Returns the index of the vertex on the edge between corners a and b */
+static gint
+iso_edge_vertex(IsoMarch *m, guint a, guint b)
+{
+  guint c, d, I, J, K;
+  gint *index;
+  gdouble t, x[3];
+  guint64 key;
 
-#if PYGTS_HAS_NUMPY
-  {"isosurface",  (PyCFunction)isosurface, 
-   METH_VARARGS|METH_KEYWORDS,
-   "Adds to surface new faces defining the isosurface data[x,y,z] = c\n"
-   "\n"
-   "Signature: isosurface(data, c, ...)\n"
-   "\n"
-   "data is a 3D numpy array.\n"
-   "c    is the isovalue defining the surface\n"
-   "\n"
-   "Keyword arguments:\n"
-   "extents= [xmin, xmax, ymin, ymax, zmin, zmax]\n"
-   "         A numpy array defining the extent of the data cube.\n" 
-   "         Default is the cube with corners at (-1,-1,-1) and (1,1,1)\n"
-   "         Data is assumed to be regularly sampled in the cube.\n"
-   "method=  ['cube'|'tetra'|'dual'|'bounded']\n"
-   "         String (only the first character counts) specifying the\n"
-   "         method.\n"
-   "         cube    -- marching cubes (default)\n"
-   "         tetra   -- marching tetrahedra\n"
-   "         dual    -- maching tetrahedra producing dual 'body-centred'\n"
-   "                    faces relative to 'tetra'\n"
-   "         bounded -- marching tetrahedra ensuring the surface is\n"
-   "                    bounded by adding a border of large negative\n"
-   "                    values around the domain.\n"
-   "\n"
-   "By convention, the normals to the surface are pointing towards\n"
-   "positive values of data[x,y,z] - c.\n"
-  },
-#endif /* PYGTS_HAS_NUMPY */
+  if( (a&b)!=a ) {
+    c = a; a = b; b = c;
+  }
+  d = a^b;
+  I = m->i + (a&1);
+  J = m->j + ((a>>1)&1);
+  K = (a>>2)&1;
+  if(d&4) {
+    index = &m->slab[d-4][I*m->g.ny+J];
+  }
+  else {
+    index = &m->layer[K][d-1][I*m->g.ny+J];
+  }
+  if(*index>=0) {
+    return *index;
+  }
 
-  { "merge", merge, METH_VARARGS,
-    "Merges list of Vertices that are within a box of side-length\n"
-    "epsilon of each other.\n"
-    "\n"
-    "Signature: merge(list,epsilon)\n"
-  },
+  t = (m->isoval-m->v[a])/(m->v[b]-m->v[a]);
+  x[0] = m->g.x + (I + t*(d&1))*m->g.dx;
+  x[1] = m->g.y + (J + t*((d>>1)&1))*m->g.dy;
+  x[2] = m->g.z + (m->k + K + t*((d>>2)&1))*m->g.dz;
+  key = ((((guint64)(m->k0+m->k+K))*m->out->ny + m->j0+J)*m->out->nx 
+	 + m->i0+I)*8 + d;
+
+  *index = m->out->keys->len;
+  g_array_append_vals(m->out->coords,x,3);
+  g_array_append_val(m->out->keys,key);
+  return *index;
+}
 
-  { "vertices", vertices, METH_VARARGS,
-    "Returns tuple of Vertices from a list or tuple of Segments.\n"
-    "\n"
-    "Signature: vertices(list)\n"
-  },
+static void
+iso_triangle(IsoMarch *m, gint a, gint b, gint c)
+{
+  gint t[3];
 
-  { "segments", segments, METH_VARARGS,
-    "Returns tuple of Segments from a list or tuple of Vertices.\n"
-    "\n"
-    "Signature: segments(list)\n"
-  },
+  t[0] = a;
+  t[1] = b;
+  t[2] = c;
+  g_array_append_vals(m->out->triangles,t,3);
+}
 
-  { "triangles", triangles, METH_VARARGS,
-    "Returns tuple of Triangles from a list or tuple of Edges.\n"
-    "\n"
-    "Signature: triangles(list)\n"
-  },
+/* Corners of the faces of a cell, counter-clockwise seen from outside */
+static const guint iso_cube_faces[6][4] = {
+  {0,2,3,1}, {4,5,7,6}, {0,4,6,2}, {1,3,7,5}, {0,1,5,4}, {2,6,7,3}
+};
 
-  { "triangle_enclosing", triangle_enclosing, METH_VARARGS,
-    "Returns a Triangle that encloses the plane projection of a list\n"
-    "or tuple of Points.  The Triangle is equilateral and encloses a\n"
-    "rectangle defined by the maximum and minimum x and y coordinates\n"
-    "of the points.\n"
-    "\n"
-    "Signature: triangles(list)\n"
-  },
+/* Returns the faces of a cell, as bits, that corner c is on */
+static guint
+iso_corner_faces(guint c)
+{
+  return (c&4 ? 1<<1 : 1<<0) | (c&1 ? 1<<3 : 1<<2) | (c&2 ? 1<<5 : 1<<4);
+}
+
+/* Marching cubes.  Going around each face of the cell, a segment joins
+ * each crossing into the inside to the next crossing out of it.  The 
+ * segments then chain into loops around the cell that are oriented with
+ * the outside on their left.  Faces with four crossings are resolved by 
+ * the mean of their corners, which the cells on either side agree on.
+ */
+static void
+iso_cube(IsoMarch *m)
+{
+  gint from[12], to[12], loop[12], x[4];
+  guint faces[12], loopfaces[12], xfaces[4];
+  gboolean enter[4], used[12];
+  guint f, c, a, b, nx, first, nseg=0, s, t, n, r;
+  gdouble mean;
+
+  for(f=0;f<6;f++) {
+    nx = 0;
+    for(c=0;c<4;c++) {
+      a = iso_cube_faces[f][c];
+      b = iso_cube_faces[f][(c+1)%4];
+      if( ISO_INSIDE(m,a) != ISO_INSIDE(m,b) ) {
+	enter[nx] = ISO_INSIDE(m,b);
+	xfaces[nx] = iso_corner_faces(a) & iso_corner_faces(b);
+	x[nx++] = iso_edge_vertex(m,a,b);
+      }
+    }
+    if(nx==0) continue;
+    first = enter[0] ? 0 : 1;
+    if(nx==2) {
+      faces[nseg] = xfaces[first];
+      from[nseg] = x[first];
+      to[nseg++] = x[1-first];
+      continue;
+    }
+    mean = 0.;
+    for(c=0;c<4;c++) {
+      mean += m->v[iso_cube_faces[f][c]];
+    }
+    faces[nseg] = xfaces[first];
+    faces[nseg+1] = xfaces[(first+2)%4];
+    if(mean/4<m->isoval) {
+      /* The inside corners are joined across the face */
+      from[nseg] = x[first];       to[nseg++] = x[(first+3)%4];
+      from[nseg] = x[(first+2)%4]; to[nseg++] = x[(first+1)%4];
+    }
+    else {
+      from[nseg] = x[first];       to[nseg++] = x[(first+1)%4];
+      from[nseg] = x[(first+2)%4]; to[nseg++] = x[(first+3)%4];
+    }
+  }
+
+  /* Chain the segments into loops and fan each into triangles.  The fan
+   * is started where none of its diagonals lie on a face of the cell, 
+   * as the neighbouring cell could have the same diagonal.
+   */
+  for(s=0;s<nseg;s++) {
+    used[s] = FALSE;
+  }
+  for(s=0;s<nseg;s++) {
+    if(used[s]) continue;
+    n = 0;
+    t = s;
+    while(t<nseg) {
+      used[t] = TRUE;
+      loopfaces[n] = faces[t];
+      loop[n++] = from[t];
+      if(to[t]==from[s]) break;
+      for(a=t, t=0; t<nseg && (used[t] || from[t]!=to[a]); t++);
+    }
+    for(r=0;r<n;r++) {
+      for(c=2;c+1<n && !(loopfaces[r]&loopfaces[(r+c)%n]);c++);
+      if(c+1>=n) break;
+    }
+    if(r==n) r = 0;
+    for(c=1;c+1<n;c++) {
+      iso_triangle(m,loop[r],loop[(r+c)%n],loop[(r+c+1)%n]);
+    }
+  }
+}
+
+/* The six tetrahedra of the Kuhn decomposition of a cell, which all 
+ * share the diagonal from corner 0 to 7, and whether each is positively
+ * oriented.  Neighbouring cells agree on the diagonals of their faces.
+ */
+static const guint iso_tetras[6][4] = {
+  {0,1,3,7}, {0,2,6,7}, {0,4,5,7}, {0,1,5,7}, {0,2,3,7}, {0,4,6,7}
+};
+static const gboolean iso_tetra_positive[6] = {
+  TRUE, TRUE, TRUE, FALSE, FALSE, FALSE
+};
+
+/* Even permutations of the corners of a tetrahedron starting with each
+ * single corner, and with each pair of corners.
+ */
+static const guint iso_tetra_one[4][4] = {
+  {0,1,2,3}, {1,0,3,2}, {2,0,1,3}, {3,0,2,1}
+};
+static const guint iso_tetra_two[6][4] = {
+  {0,1,2,3}, {0,2,3,1}, {0,3,1,2}, {1,2,0,3}, {1,3,2,0}, {2,3,0,1}
+};
+
+/* Marching tetrahedra; c gives the corners of the tetrahedron */
+static void
+iso_tetra(IsoMarch *m, const guint *c, gboolean positive)
+{
+  guint inside=0, n=0, i;
+  const guint *p;
+  gint x[4];
+
+  for(i=0;i<4;i++) {
+    if(ISO_INSIDE(m,c[i])) {
+      inside |= 1<<i;
+      n++;
+    }
+  }
+  if(n==0 || n==4) return;
+
+  if(n!=2) {
+    /* Cut off the corner that is alone on its side */
+    for(i=0;i<4 && ((inside>>i)&1)!=(n==1);i++);
+    p = iso_tetra_one[i];
+    x[0] = iso_edge_vertex(m,c[p[0]],c[p[1]]);
+    x[1] = iso_edge_vertex(m,c[p[0]],c[p[2]]);
+    x[2] = iso_edge_vertex(m,c[p[0]],c[p[3]]);
+    if( positive == (n==1) ) {
+      iso_triangle(m,x[0],x[1],x[2]);
+    }
+    else {
+      iso_triangle(m,x[0],x[2],x[1]);
+    }
+    return;
+  }
+
+  /* Split the quadrilateral between the two inside corners and the two
+   * outside ones.
+   */
+  for(i=0;i<6 && !(((inside>>iso_tetra_two[i][0])&1) &&
+		   ((inside>>iso_tetra_two[i][1])&1));i++);
+  p = iso_tetra_two[i];
+  x[0] = iso_edge_vertex(m,c[p[0]],c[p[2]]);
+  x[1] = iso_edge_vertex(m,c[p[0]],c[p[3]]);
+  x[2] = iso_edge_vertex(m,c[p[1]],c[p[3]]);
+  x[3] = iso_edge_vertex(m,c[p[1]],c[p[2]]);
+  if(positive) {
+    iso_triangle(m,x[0],x[1],x[2]);
+    iso_triangle(m,x[0],x[2],x[3]);
+  }
+  else {
+    iso_triangle(m,x[0],x[2],x[1]);
+    iso_triangle(m,x[0],x[3],x[2]);
+  }
+}
+
+/* Marches through grid g, which starts at sample (i0,j0,k0) of the whole
+ * grid, with method 'c' (cubes) or 't' (tetra).  The layers of samples 
+ * are retrieved with func in order, once each.
+ */
+static void
+iso_arrays_march(IsoArrays *out, GtsCartesianGrid g, 
+		 guint i0, guint j0, guint k0, char method,
+		 GtsIsoCartesianFunc func, gpointer data, gdouble isoval)
+{
+  IsoMarch m;
+  gdouble **rows, **f[2], **ftmp, *values;
+  gint *tables, *tmp;
+  guint n, i, c, t, inside;
+
+  if(g.nx<2 || g.ny<2 || g.nz<2) return;
+
+  n = g.nx*g.ny;
+  values = g_new(gdouble,2*n);
+  rows = g_new(gdouble*,2*g.nx);
+  f[0] = rows;
+  f[1] = rows + g.nx;
+  for(i=0;i<g.nx;i++) {
+    f[0][i] = values + i*g.ny;
+    f[1][i] = values + n + i*g.ny;
+  }
+  tables = g_new(gint,10*n);
+  for(c=0;c<3;c++) {
+    m.layer[0][c] = tables + c*n;
+    m.layer[1][c] = tables + (3+c)*n;
+  }
+  for(c=0;c<4;c++) {
+    m.slab[c] = tables + (6+c)*n;
+  }
+  for(i=0;i<3*n;i++) {
+    tables[i] = -1;
+  }
+  m.out = out;
+  m.g = g;
+  m.i0 = i0;
+  m.j0 = j0;
+  m.k0 = k0;
+  m.isoval = isoval;
+
+  (*func)(f[0],g,0,data);
+  for(m.k=0;m.k<g.nz-1;m.k++) {
+    (*func)(f[1],g,m.k+1,data);
+    for(c=0;c<3;c++) {
+      for(i=0;i<n;i++) m.layer[1][c][i] = -1;
+    }
+    for(c=0;c<4;c++) {
+      for(i=0;i<n;i++) m.slab[c][i] = -1;
+    }
+
+    for(m.i=0;m.i<g.nx-1;m.i++) {
+      for(m.j=0;m.j<g.ny-1;m.j++) {
+	inside = 0;
+	for(c=0;c<8;c++) {
+	  m.v[c] = f[c>>2][m.i+(c&1)][m.j+((c>>1)&1)];
+	  if(ISO_INSIDE(&m,c)) inside |= 1<<c;
+	}
+	if(inside==0 || inside==0xff) continue;
+	if(method=='c') {
+	  iso_cube(&m);
+	}
+	else {
+	  for(t=0;t<6;t++) {
+	    iso_tetra(&m,iso_tetras[t],iso_tetra_positive[t]);
+	  }
+	}
+      }
+    }
+
+    /* Layer k+1 becomes layer k */
+    ftmp = f[0]; f[0] = f[1]; f[1] = ftmp;
+    for(c=0;c<3;c++) {
+      tmp = m.layer[0][c]; m.layer[0][c] = m.layer[1][c]; m.layer[1][c] = tmp;
+    }
+  }
+
+  g_free(tables);
+  g_free(rows);
+  g_free(values);
+}
+
+static guint
+iso_key_hash(gconstpointer key)
+{
+  guint64 k = *(const guint64*)key;
+  return (guint)(k ^ (k>>32));
+}
+
+static gboolean
+iso_key_equal(gconstpointer a, gconstpointer b)
+{
+  return *(const guint64*)a == *(const guint64*)b;
+}
+
+/* Merges the vertices emitted by more than one march, by their edges */
+static void
+iso_arrays_merge(IsoArrays *a)
+{
+  GHashTable *first;
+  guint64 *keys = (guint64*)a->keys->data;
+  gdouble *coords = (gdouble*)a->coords->data;
+  gint *triangles = (gint*)a->triangles->data;
+  gint *map;
+  gpointer index;
+  guint i, n=0;
+
+  first = g_hash_table_new(iso_key_hash,iso_key_equal);
+  map = g_new(gint,a->keys->len);
+  for(i=0;i<a->keys->len;i++) {
+    if( (index = g_hash_table_lookup(first,&keys[i])) != NULL ) {
+      map[i] = GPOINTER_TO_INT(index)-1;
+      continue;
+    }
+    keys[n] = keys[i];
+    coords[3*n] = coords[3*i];
+    coords[3*n+1] = coords[3*i+1];
+    coords[3*n+2] = coords[3*i+2];
+    g_hash_table_insert(first,&keys[n],GINT_TO_POINTER(n+1));
+    map[i] = n++;
+  }
+  for(i=0;i<a->triangles->len;i++) {
+    triangles[i] = map[triangles[i]];
+  }
+  g_array_set_size(a->keys,n);
+  g_array_set_size(a->coords,3*n);
+
+  g_free(map);
+  g_hash_table_destroy(first);
+}
+
+#undef ISO_INSIDE
+
+
+/* Helper for pygts_iso to march only through the blocks whose (min,max)
+ * range contains the isovalue.  Runs of active blocks along z are marched
+ * together, into s or, if s is NULL, into arrays.  The vertices 
+ * duplicated on block faces are merged.
+ */
+static void
+iso_march_blocks(GtsSurface *s, IsoArrays *arrays, GtsCartesianGrid g, 
+		 char method, PyArrayObject *scalars, PyArrayObject *blocks, 
+		 gint blocksize, gdouble isoval)
+{
+  IsoBlockData data;
+  GtsCartesianGrid gb;
+  gdouble *b;
+  guint nbx, nby, nbz, bi, bj, bk, bk0, nruns=0;
+  gdouble eps;
+
+  nbx = blocks->dimensions[0];
+  nby = blocks->dimensions[1];
+  nbz = blocks->dimensions[2];
+  b = (gdouble*)blocks->data;
+
+  data.scalars = scalars;
+  gb.dx = g.dx;
+  gb.dy = g.dy;
+  gb.dz = g.dz;
+
+  for(bi=0;bi<nbx;bi++) {
+    for(bj=0;bj<nby;bj++) {
+      bk = 0;
+      while(bk<nbz) {
+
+	/* Find the next run of active blocks */
+#define ISO_BLOCK_IS_ACTIVE(bk) \
+	( b[((bi*nby+bj)*nbz+(bk))*2]<=isoval && \
+	  isoval<=b[((bi*nby+bj)*nbz+(bk))*2+1] )
+	while(bk<nbz && !ISO_BLOCK_IS_ACTIVE(bk)) bk++;
+	if(bk==nbz) break;
+	bk0 = bk;
+	while(bk<nbz && ISO_BLOCK_IS_ACTIVE(bk)) bk++;
+#undef ISO_BLOCK_IS_ACTIVE
+
+	/* March through the run */
+	data.i0 = bi*blocksize;
+	data.j0 = bj*blocksize;
+	data.k0 = bk0*blocksize;
+	gb.nx = MIN((bi+1)*blocksize,g.nx-1) - data.i0 + 1;
+	gb.ny = MIN((bj+1)*blocksize,g.ny-1) - data.j0 + 1;
+	gb.nz = MIN(bk*blocksize,g.nz-1) - data.k0 + 1;
+	gb.x = g.x + data.i0*g.dx;
+	gb.y = g.y + data.j0*g.dy;
+	gb.z = g.z + data.k0*g.dz;
+	if(s!=NULL) {
+	  iso_march(s, gb, method, isofunc_block, &data, isoval);
+	}
+	else {
+	  iso_arrays_march(arrays, gb, data.i0, data.j0, data.k0, method,
+			   isofunc_block, &data, isoval);
+	}
+	nruns++;
+      }
+    }
+  }
+
+  /* Merge the vertices duplicated on the faces of adjoining runs; these
+   * only differ by round-off.
+   */
+  if(nruns>1 && s==NULL) {
+    iso_arrays_merge(arrays);
+  }
+  else if(nruns>1) {
+    eps = MIN(fabs(g.dx),MIN(fabs(g.dy),fabs(g.dz)))*1.e-9;
+    pygts_vertex_cleanup(s,eps);
+    pygts_edge_cleanup(s);
+    pygts_face_cleanup(s);
+  }
+}
+
+/* Helpers for iso_arrays_from_surface */
+typedef struct {
+  GHashTable *indices;
+  IsoArrays *out;
+} IsoSurfaceData;
+
+static void iso_surface_vertex(GtsVertex *v, IsoSurfaceData *data)
+{
+  gdouble x[3];
+
+  g_hash_table_insert(data->indices, v, 
+		      GUINT_TO_POINTER(data->out->coords->len/3));
+  x[0] = GTS_POINT(v)->x;
+  x[1] = GTS_POINT(v)->y;
+  x[2] = GTS_POINT(v)->z;
+  g_array_append_vals(data->out->coords, x, 3);
+}
+
+static void iso_surface_face(GtsTriangle *t, IsoSurfaceData *data)
+{
+  GtsVertex *v[3];
+  gint index[3];
+  guint i;
+
+  gts_triangle_vertices(t, &v[0], &v[1], &v[2]);
+  for(i=0;i<3;i++) {
+    index[i] = GPOINTER_TO_INT(g_hash_table_lookup(data->indices, v[i]));
+  }
+  g_array_append_vals(data->out->triangles, index, 3);
+}
+
+/* Helper for pygts_iso to fill the arrays from a surface, for the methods
+ * that the direct marcher does not handle.
+ */
+static void
+iso_arrays_from_surface(GtsSurface *s, IsoArrays *out)
+{
+  IsoSurfaceData data;
+
+  data.indices = g_hash_table_new(NULL,NULL);
+  data.out = out;
+  gts_surface_foreach_vertex(s, (GtsFunc)iso_surface_vertex, &data);
+  gts_surface_foreach_face(s, (GtsFunc)iso_surface_face, &data);
+  g_hash_table_destroy(data.indices);
+}
+
+
+/* Helper for pygts_iso to return the tuple of numpy arrays (coords, 
+ * triangles[, normals]).  The normals are the unit area-weighted vertex
+ * normals.
+ */
+static PyObject*
+iso_arrays_new(IsoArrays *a, gboolean normals)
+{
+  PyArrayObject *coords, *triangles, *anormals;
+  npy_intp dims[2];
+  gdouble *c, *n, *p[3], e1[3], e2[3], nx, ny, nz, norm;
+  gint *t;
+  guint i, j, nv, nt;
+
+  nv = a->coords->len/3;
+  nt = a->triangles->len/3;
+
+  dims[0] = nv;
+  dims[1] = 3;
+  if( (coords = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_DOUBLE))
+      == NULL ) {
+    return NULL;
+  }
+  memcpy(coords->data, a->coords->data, 3*nv*sizeof(gdouble));
+  dims[0] = nt;
+  if( (triangles = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_INT))
+      == NULL ) {
+    Py_DECREF(coords);
+    return NULL;
+  }
+  memcpy(triangles->data, a->triangles->data, 3*nt*sizeof(gint));
+
+  if(!normals) {
+    return Py_BuildValue("NN", coords, triangles);
+  }
+
+  dims[0] = nv;
+  if( (anormals = (PyArrayObject*)PyArray_ZEROS(2,dims,PyArray_DOUBLE,0))
+      == NULL ) {
+    Py_DECREF(coords);
+    Py_DECREF(triangles);
+    return NULL;
+  }
+  c = (gdouble*)coords->data;
+  t = (gint*)triangles->data;
+  n = (gdouble*)anormals->data;
+  for(i=0;i<nt;i++) {
+    for(j=0;j<3;j++) {
+      p[j] = c + 3*t[3*i+j];
+    }
+    for(j=0;j<3;j++) {
+      e1[j] = p[1][j]-p[0][j];
+      e2[j] = p[2][j]-p[0][j];
+    }
+    nx = e1[1]*e2[2]-e1[2]*e2[1];
+    ny = e1[2]*e2[0]-e1[0]*e2[2];
+    nz = e1[0]*e2[1]-e1[1]*e2[0];
+    for(j=0;j<3;j++) {
+      n[3*t[3*i+j]] += nx;
+      n[3*t[3*i+j]+1] += ny;
+      n[3*t[3*i+j]+2] += nz;
+    }
+  }
+  for(i=0;i<nv;i++) {
+    norm = sqrt(n[3*i]*n[3*i]+n[3*i+1]*n[3*i+1]+n[3*i+2]*n[3*i+2]);
+    if(norm>0) {
+      n[3*i] /= norm;
+      n[3*i+1] /= norm;
+      n[3*i+2] /= norm;
+    }
+  }
+  return Py_BuildValue("NNN", coords, triangles, anormals);
+}
+
+#define ISO_CLEANUP \
+  if (scalars) { Py_DECREF(scalars); } \
+  if (extents) { Py_DECREF(extents); } \
+  Py_XDECREF(blocks); \
+  Py_XDECREF(slices.source); \
+  Py_XDECREF(slices.slices[0]); \
+  Py_XDECREF(slices.slices[1]);
+
+static PyObject*
+isosurface(PyObject *self, PyObject *args, PyObject *kwds)
+{
+  double isoval[1];
+  PyObject *Oscalars = NULL, *Oextents = NULL, *Oblocks = NULL;
+  PyArrayObject *scalars = NULL, *extents = NULL, *blocks = NULL;
+  gint blocksize = 0;
+  IsoSliceData slices;
+  GtsIsoCartesianFunc func;
+  gpointer func_data;
+  gint nx, ny, nz=-1;
+  GtsCartesianGrid g;
+  GtsSurface *s;
+  PygtsSurface *surface;
+  IsoArrays arrays;
+  PyObject *result;
+  char *method = "cubes", *output = "surface";
+  gint normals = FALSE;
+  
+  static char *kwlist[] = {"scalars", "isoval", "method", "extents", "nz",
+			   "blocksize", "blocks", "output", "normals", NULL};
+
+  slices.source = NULL;
+  slices.slices[0] = slices.slices[1] = NULL;
+  slices.k[0] = slices.k[1] = -1;
+  slices.knext = 0;
+  slices.nx = slices.ny = 0;
+  slices.errflag = FALSE;
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "Od|sOiiOsi", kwlist, 
+				  &Oscalars, isoval, &method, &Oextents,
+				  &nz, &blocksize, &Oblocks, &output,
+				  &normals)) {
+    return NULL;
+  }
+
+  if(strcmp(output,"surface")!=0 && strcmp(output,"arrays")!=0) {
+    PyErr_SetString(PyExc_ValueError,
+		    "output must be 'surface' or 'arrays'");
+    return NULL;
+  }
+  if(normals && output[0]!='a') {
+    PyErr_SetString(PyExc_ValueError,
+		    "normals are only given with output='arrays'");
+    return NULL;
+  }
+
+  if(Oblocks==Py_None) {
+    Oblocks = NULL;
+  }
+  if(blocksize<0) {
+    PyErr_SetString(PyExc_ValueError, "blocksize must be positive");
+    return NULL;
+  }
+  if(Oblocks && blocksize==0) {
+    blocksize = ISO_BLOCKSIZE;
+  }
+  if(blocksize) {
+    if(method[0]!='c' && method[0]!='t') {
+      PyErr_SetString(PyExc_ValueError,
+		      "blocks are only supported by the cubes and tetra methods");
+      return NULL;
+    }
+    if(method[0]=='t' && blocksize%2) {
+      PyErr_SetString(PyExc_ValueError,
+		      "blocksize must be even for the tetra method");
+      return NULL;
+    }
+  }
+
+  if(PyCallable_Check(Oscalars) || PyIter_Check(Oscalars)) {
+
+    /* The data is streamed one slice at a time */
+    if(nz < 2) {
+      PyErr_SetString(PyExc_ValueError,
+		      "nz >= 2 must be given for sliced data");
+      return NULL;
+    }
+    Py_INCREF(Oscalars);
+    slices.source = Oscalars;
+    slices.is_callable = PyCallable_Check(Oscalars);
+
+    /* Get the first slice to establish the dimensions */
+    if(isoslice_get(&slices,0) == NULL) {
+      ISO_CLEANUP;
+      return NULL;
+    }
+    if(blocksize) {
+      PyErr_SetString(PyExc_ValueError,
+		      "blocks cannot be used with sliced data");
+      ISO_CLEANUP;
+      return NULL;
+    }
+    nx = slices.nx;
+    ny = slices.ny;
+    func = isofunc_slices;
+    func_data = &slices;
+  }
+  else {
+    if(!(scalars = (PyArrayObject *) 
+	 PyArray_ContiguousFromObject(Oscalars, PyArray_DOUBLE, 3, 3))) {
+      ISO_CLEANUP;
+      return NULL;
+    }
+    nx = scalars->dimensions[0];
+    ny = scalars->dimensions[1];
+    nz = scalars->dimensions[2];
+    func = isofunc;
+    func_data = scalars;
+  }
+
+  if(blocksize) {
+    if(Oblocks) {
+      if(!(blocks = (PyArrayObject *) 
+	   PyArray_ContiguousFromObject(Oblocks, PyArray_DOUBLE, 4, 4))) {
+	ISO_CLEANUP;
+	return NULL;
+      }
+      if(blocks->dimensions[0]!=ISO_NBLOCKS(nx,blocksize) ||
+	 blocks->dimensions[1]!=ISO_NBLOCKS(ny,blocksize) ||
+	 blocks->dimensions[2]!=ISO_NBLOCKS(nz,blocksize) ||
+	 blocks->dimensions[3]!=2) {
+	PyErr_SetString(PyExc_ValueError,
+			"blocks shape does not match data and blocksize");
+	ISO_CLEANUP;
+	return NULL;
+      }
+    }
+    else if( (blocks = iso_blocks_new(scalars,blocksize)) == NULL ) {
+      ISO_CLEANUP;
+      return NULL;
+    }
+  }
+
+  if(Oextents && 
+     (!(extents =  (PyArrayObject *)
+	PyArray_ContiguousFromObject(Oextents, PyArray_DOUBLE, 1, 1)))) {
+    ISO_CLEANUP;
+    return NULL;
+  }
+
+  if(extents && extents->dimensions[0] < 6) {
+    PyErr_SetString(PyExc_ValueError, "extents must have at least 6 elements");
+    ISO_CLEANUP;
+    return NULL;
+  }
+  
+  if(extents) {
+    int s = extents->strides[0];
+    g.x = *(gdouble*)(extents->data + 0*s);
+    g.nx = nx;
+    g.dx = (*(gdouble*)(extents->data + 1*s) - \
+	    *(gdouble*)(extents->data + 0* s))/(g.nx-1);
+
+    g.y = *(gdouble*)(extents->data + 2*s);
+    g.ny = ny;
+    g.dy = (*(gdouble*)(extents->data + 3*s) - \
+	    *(gdouble*)(extents->data + 2*s))/(g.ny-1);
+
+    g.z = *(gdouble*)(extents->data + 4*s);
+    g.nz = nz;
+    g.dz = (*(gdouble*)(extents->data + 5*s) - \
+	    *(gdouble*)(extents->data + 4*s))/(g.nz-1);
+  }
+  else {
+    g.x = -1.0;
+    g.nx = nx;
+    g.dx = 2.0/(nx-1);
+    g.y = -1.0;
+    g.ny = ny;
+    g.dy = 2.0/(ny-1);
+    g.z = -1.0;
+    g.nz = nz;
+    g.dz = 2.0/(nz-1);
+  }
+
+  /* The cubes and tetra methods march straight into arrays */
+  if(output[0]=='a' && (method[0]=='c' || method[0]=='t')) {
+    iso_arrays_init(&arrays, g.nx, g.ny);
+    if(blocks) {
+      iso_march_blocks(NULL, &arrays, g, method[0], scalars, blocks,
+		       blocksize, isoval[0]);
+    }
+    else {
+      iso_arrays_march(&arrays, g, 0, 0, 0, method[0], func, func_data,
+		       isoval[0]);
+    }
+    ISO_CLEANUP;
+    result = slices.errflag ? NULL : iso_arrays_new(&arrays, normals);
+    iso_arrays_free(&arrays);
+    return result;
+  }
+
+  /* Create the surface */
+  if((s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			  gts_edge_class(), gts_vertex_class())) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+    ISO_CLEANUP;
+    return NULL;
+  }
+
+  /* Make the call */
+  if(blocks) {
+    iso_march_blocks(s, NULL, g, method[0], scalars, blocks, blocksize, 
+		     isoval[0]);
+  }
+  else if(!iso_march(s, g, method[0], func, func_data, isoval[0])) {
+    PyErr_SetString(PyExc_ValueError, "unknown method");
+    gts_object_destroy(GTS_OBJECT(s));
+    ISO_CLEANUP;
+    return NULL;
+  }
+
+  if(method[0]!='c') {
+    /* *** ATTENTION ***
+     * Isosurface produced is "inside-out", and so we must revert it.
+     * This is a bug in GTS.
+     */
+    gts_surface_foreach_face(s, (GtsFunc)gts_triangle_revert, NULL);
+    /* *** ATTENTION *** */
+  }
+
+  /* Errors raised while retrieving slices are reported here */
+  if(slices.errflag) {
+    gts_object_destroy(GTS_OBJECT(s));
+    ISO_CLEANUP;
+    return NULL;
+  }
+
+  ISO_CLEANUP;
+
+  if(output[0]=='a') {
+    /* The surface is only needed to build the arrays */
+    iso_arrays_init(&arrays, g.nx, g.ny);
+    iso_arrays_from_surface(s, &arrays);
+    gts_object_destroy(GTS_OBJECT(s));
+    result = iso_arrays_new(&arrays, normals);
+    iso_arrays_free(&arrays);
+    return result;
+  }
+
+  if( (surface = pygts_surface_new(s)) == NULL )  {
+    gts_object_destroy(GTS_OBJECT(s));
+    return NULL;
+  }
+
+  return (PyObject*)surface;
+}
+
+
+static PyObject*
+isosurface_blocks(PyObject *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *Oscalars;
+  PyArrayObject *scalars, *blocks;
+  gint blocksize = ISO_BLOCKSIZE;
+
+  static char *kwlist[] = {"scalars", "blocksize", NULL};
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, 
+				  &Oscalars, &blocksize)) {
+    return NULL;
+  }
+
+  if(blocksize<1) {
+    PyErr_SetString(PyExc_ValueError, "blocksize must be positive");
+    return NULL;
+  }
+
+  if(!(scalars = (PyArrayObject *) 
+       PyArray_ContiguousFromObject(Oscalars, PyArray_DOUBLE, 3, 3))) {
+    return NULL;
+  }
+
+  blocks = iso_blocks_new(scalars,blocksize);
+  Py_DECREF(scalars);
+
+  return (PyObject*)blocks;
+}
+
+/* Helpers for delaunay */
+
+#define DELAUNAY_HILBERT_BITS 16
+#define DELAUNAY_MAX_ROUNDS 24
+#define DELAUNAY_PARALLEL_MIN 10000
+
+typedef struct {
+  guint32 round, key;
+  guint index;
+} DelaunayPoint;
+
+/* Position of (x,y) along the 2-D Hilbert curve of order
+ * DELAUNAY_HILBERT_BITS.
+ */
+static guint32
+delaunay_hilbert_key(guint32 x, guint32 y)
+{
+  guint32 n=1U<<DELAUNAY_HILBERT_BITS, s, rx, ry, t, d=0;
+
+  for(s=n/2;s>0;s/=2) {
+    rx = (x&s)>0;
+    ry = (y&s)>0;
+    d += s*s*((3*rx)^ry);
+    if(ry==0) {
+      if(rx==1) {
+	x = n-1-x;
+	y = n-1-y;
+      }
+      t = x; x = y; y = t;
+    }
+  }
+  return d;
+}
+
+static int
+delaunay_point_compare(const void *a, const void *b)
+{
+  const DelaunayPoint *p1=(const DelaunayPoint*)a, *p2=(const DelaunayPoint*)b;
+
+  if(p1->round!=p2->round) return p1->round<p2->round ? -1 : 1;
+  if(p1->key!=p2->key) return p1->key<p2->key ? -1 : 1;
+  return p1->index<p2->index ? -1 : (p1->index>p2->index);
+}
+
+/* Biased randomized insertion order: point i lands in the last round
+ * with probability 1/2, in the one before with probability 1/4, and so
+ * on.  Each round is sorted along a Hilbert curve so that successive
+ * insertions are close together and point location stays short.
+ */
+static DelaunayPoint*
+delaunay_order(gdouble *p, guint N, guint stride)
+{
+  DelaunayPoint *order;
+  gdouble lo[2], hi[2], scale[2];
+  guint32 nrounds=1, r, seed=2463534242U;
+  guint i, l;
+
+  order = g_new(DelaunayPoint,N);
+
+  for(i=N;i>1 && nrounds<DELAUNAY_MAX_ROUNDS;i/=2) {
+    nrounds++;
+  }
+
+  lo[0] = hi[0] = p[0];
+  lo[1] = hi[1] = p[1];
+  for(i=1;i<N;i++) {
+    for(l=0;l<2;l++) {
+      if(p[stride*i+l]<lo[l]) lo[l] = p[stride*i+l];
+      if(p[stride*i+l]>hi[l]) hi[l] = p[stride*i+l];
+    }
+  }
+  for(l=0;l<2;l++) {
+    scale[l] = hi[l]>lo[l] ? 
+      ((1U<<DELAUNAY_HILBERT_BITS)-1)/(hi[l]-lo[l]) : 0.;
+  }
+
+  for(i=0;i<N;i++) {
+    /* xorshift32; deterministic so that results are reproducible */
+    seed ^= seed<<13;
+    seed ^= seed>>17;
+    seed ^= seed<<5;
+    r = nrounds-1;
+    while(r>0 && (seed & (1U<<r))) {
+      r--;
+    }
+    order[i].round = r;
+    order[i].index = i;
+  }
+
+#pragma omp parallel for if(N>=DELAUNAY_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    order[i].key = delaunay_hilbert_key(
+		     (guint32)((p[stride*i]-lo[0])*scale[0]),
+		     (guint32)((p[stride*i+1]-lo[1])*scale[1]));
+  }
+
+  qsort(order,N,sizeof(DelaunayPoint),delaunay_point_compare);
+  return order;
+}
+
+/* Removes the enclosing triangle with vertices w */
+static void
+delaunay_unenclose(GtsVertex **w)
+{
+  guint i;
+
+  gts_allow_floating_vertices = TRUE;
+  for(i=0;i<3;i++) {
+    gts_object_destroy(GTS_OBJECT(w[i]));
+  }
+  gts_allow_floating_vertices = FALSE;
+}
+
+/* Triangulates the (N,3) points c in the (x,y) plane.  vertices[i]
+ * receives the vertex of point i (duplicates share one) and w the
+ * vertices of the enclosing triangle, which delaunay_unenclose()
+ * removes once any constraints are in place.  If a point cannot be
+ * located in the triangulation, ValueError is set and NULL returned.
+ */
+static GtsSurface*
+delaunay_surface(gdouble *c, guint N, GtsVertex **vertices, GtsVertex **w)
+{
+  DelaunayPoint *order;
+  GtsVertex *v, *u;
+  GtsFace *guess=NULL;
+  GSList *list=NULL;
+  GtsTriangle *t;
+  GtsSurface *s;
+  guint i, j;
+
+  if((s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			  gts_edge_class(), gts_vertex_class())) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create Surface");
+    return NULL;
+  }
+
+  /* Create the vertices and the triangle that encloses them */
+  order = delaunay_order(c,N,3);
+  for(i=0;i<N;i++) {
+    vertices[i] = gts_vertex_new(s->vertex_class, c[3*i], c[3*i+1], c[3*i+2]);
+    list = g_slist_prepend(list,vertices[i]);
+  }
+  t = gts_triangle_enclosing(gts_triangle_class(),list,10.);
+  g_slist_free(list);
+  if(t==NULL) {
+    for(i=0;i<N;i++) {
+      gts_object_destroy(GTS_OBJECT(vertices[i]));
+    }
+    g_free(order);
+    gts_object_destroy(GTS_OBJECT(s));
+    PyErr_SetString(PyExc_RuntimeError,"could not compute triangle");
+    return NULL;
+  }
+  gts_triangle_vertices(t, &w[0], &w[1], &w[2]);
+  gts_surface_add_face(s, gts_face_new(s->face_class, t->e1, t->e2, t->e3));
+
+  /* Insert in BRIO order, starting each search from the last vertex */
+  for(i=0;i<N;i++) {
+    v = vertices[order[i].index];
+    if( (u = gts_delaunay_add_vertex(s, v, guess)) == v ) {
+      /* The point is outside of the triangulation; v was not inserted */
+      PyErr_Format(PyExc_ValueError,"could not locate point %u",
+		   order[i].index);
+      for(j=i;j<N;j++) {
+	gts_object_destroy(GTS_OBJECT(vertices[order[j].index]));
+      }
+      g_free(order);
+      delaunay_unenclose(w);
+      gts_object_destroy(GTS_OBJECT(s));
+      return NULL;
+    }
+    if( u != NULL ) {
+      /* Duplicate point; refer to the vertex already in place */
+      gts_object_destroy(GTS_OBJECT(v));
+      vertices[order[i].index] = u;
+      continue;
+    }
+    guess = gts_edge_has_parent_surface(GTS_EDGE(v->segments->data), s);
+  }
+  g_free(order);
+
+  return s;
+}
+
+static void
+delaunay_orient(GtsTriangle *t, gpointer data)
+{
+  if(gts_triangle_orientation(t)<0) {
+    gts_triangle_revert(t);
+  }
+}
+
+typedef struct {
+  GHashTable *indices;
+  GPtrArray *extra;
+  gint *triangles;
+  guint n;
+} DelaunayIndexData;
+
+static void
+delaunay_vertex_index(GtsVertex *v, DelaunayIndexData *data)
+{
+  if(g_hash_table_lookup(data->indices, v)==NULL) {
+    /* Steiner point */
+    g_ptr_array_add(data->extra, v);
+    g_hash_table_insert(data->indices, v, 
+			GUINT_TO_POINTER(data->n + data->extra->len));
+  }
+}
+
+static void
+delaunay_face_index(GtsTriangle *t, DelaunayIndexData *data)
+{
+  GtsVertex *v[3];
+  guint i;
+
+  gts_triangle_vertices(t, &v[0], &v[1], &v[2]);
+  for(i=0;i<3;i++) {
+    data->triangles[3*data->n+i] =
+      GPOINTER_TO_UINT(g_hash_table_lookup(data->indices, v[i])) - 1;
+  }
+  data->n++;
+}
+
+/* Returns the triangulation s of the N points in coords as a Surface,
+ * or as the tuple (coords, triangles) with any Steiner points appended
+ * to coords.  Steals the references to s and coords.
+ */
+static PyObject*
+delaunay_output(GtsSurface *s, PyArrayObject *coords, GtsVertex **vertices,
+		guint N, char *output)
+{
+  PyArrayObject *acoords, *triangles;
+  PygtsSurface *surface;
+  DelaunayIndexData data;
+  npy_intp dims[2];
+  gdouble *c;
+  guint i;
+
+  gts_surface_foreach_face(s, (GtsFunc)delaunay_orient, NULL);
+
+  if(output[0]!='a') {
+    Py_DECREF(coords);
+    if( (surface = pygts_surface_new(s)) == NULL )  {
+      gts_object_destroy(GTS_OBJECT(s));
+      return NULL;
+    }
+    return (PyObject*)surface;
+  }
+
+  /* Number the input points first; the first of any duplicates wins */
+  data.indices = g_hash_table_new(NULL,NULL);
+  data.extra = g_ptr_array_new();
+  for(i=0;i<N;i++) {
+    if(g_hash_table_lookup(data.indices, vertices[i])==NULL) {
+      g_hash_table_insert(data.indices, vertices[i], GUINT_TO_POINTER(i+1));
+    }
+  }
+  data.n = N;
+  gts_surface_foreach_vertex(s, (GtsFunc)delaunay_vertex_index, &data);
+
+  acoords = coords;
+  if(data.extra->len>0) {
+    dims[0] = N + data.extra->len;
+    dims[1] = 3;
+    if( (acoords = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_DOUBLE))
+	== NULL ) {
+      g_ptr_array_free(data.extra, TRUE);
+      g_hash_table_destroy(data.indices);
+      gts_object_destroy(GTS_OBJECT(s));
+      Py_DECREF(coords);
+      return NULL;
+    }
+    memcpy(acoords->data, coords->data, 3*N*sizeof(gdouble));
+    Py_DECREF(coords);
+    c = (gdouble*)acoords->data + 3*N;
+    for(i=0;i<data.extra->len;i++) {
+      c[3*i] = GTS_POINT(g_ptr_array_index(data.extra,i))->x;
+      c[3*i+1] = GTS_POINT(g_ptr_array_index(data.extra,i))->y;
+      c[3*i+2] = GTS_POINT(g_ptr_array_index(data.extra,i))->z;
+    }
+  }
+  g_ptr_array_free(data.extra, TRUE);
+
+  dims[0] = gts_surface_face_number(s);
+  dims[1] = 3;
+  if( (triangles = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_INT))
+      == NULL ) {
+    g_hash_table_destroy(data.indices);
+    gts_object_destroy(GTS_OBJECT(s));
+    Py_DECREF(acoords);
+    return NULL;
+  }
+  data.triangles = (gint*)triangles->data;
+  data.n = 0;
+  gts_surface_foreach_face(s, (GtsFunc)delaunay_face_index, &data);
+
+  g_hash_table_destroy(data.indices);
+  gts_object_destroy(GTS_OBJECT(s));
+  return Py_BuildValue("NN", acoords, triangles);
+}
+
+/* Returns the (N,3) copy of the (N,2) or (N,3) points, or NULL */
+static PyArrayObject*
+delaunay_points(PyObject *Opoints)
+{
+  PyArrayObject *points, *coords;
+  npy_intp dims[2];
+  gdouble *p, *c;
+  guint N, stride, i;
+
+  if(!(points = (PyArrayObject *) 
+       PyArray_ContiguousFromObject(Opoints, PyArray_DOUBLE, 2, 2))) {
+    return NULL;
+  }
+  N = points->dimensions[0];
+  stride = points->dimensions[1];
+  if(stride!=2 && stride!=3) {
+    Py_DECREF(points);
+    PyErr_SetString(PyExc_ValueError,"points must have shape (N,2) or (N,3)");
+    return NULL;
+  }
+  if(N<3) {
+    Py_DECREF(points);
+    PyErr_SetString(PyExc_ValueError,"need at least 3 points");
+    return NULL;
+  }
+
+  dims[0] = N;
+  dims[1] = 3;
+  if( (coords = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_DOUBLE))
+      == NULL ) {
+    Py_DECREF(points);
+    return NULL;
+  }
+  p = (gdouble*)points->data;
+  c = (gdouble*)coords->data;
+  for(i=0;i<N;i++) {
+    if( !Py_IS_FINITE(p[stride*i]) || !Py_IS_FINITE(p[stride*i+1]) ) {
+      Py_DECREF(points);
+      Py_DECREF(coords);
+      PyErr_SetString(PyExc_ValueError,"points must be finite");
+      return NULL;
+    }
+    c[3*i] = p[stride*i];
+    c[3*i+1] = p[stride*i+1];
+    c[3*i+2] = stride==3 ? p[stride*i+2] : 0.;
+  }
+  Py_DECREF(points);
+
+  return coords;
+}
+
+
+static PyObject*
+delaunay(PyObject *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *Opoints;
+  PyArrayObject *coords;
+  char *output = "surface";
+  GtsVertex **vertices, *w[3];
+  GtsSurface *s;
+  PyObject *result;
+  guint N;
+
+  static char *kwlist[] = {"points", "output", NULL};
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|s", kwlist, 
+				  &Opoints, &output)) {
+    return NULL;
+  }
+
+  if(strcmp(output,"surface")!=0 && strcmp(output,"arrays")!=0) {
+    PyErr_SetString(PyExc_ValueError,
+		    "output must be 'surface' or 'arrays'");
+    return NULL;
+  }
+
+  if( (coords = delaunay_points(Opoints)) == NULL ) {
+    return NULL;
+  }
+  N = coords->dimensions[0];
+
+  vertices = g_new(GtsVertex*,N);
+  if( (s = delaunay_surface((gdouble*)coords->data,N,vertices,w)) == NULL ) {
+    g_free(vertices);
+    Py_DECREF(coords);
+    return NULL;
+  }
+  delaunay_unenclose(w);
+
+  result = delaunay_output(s, coords, vertices, N, output);
+  g_free(vertices);
+  return result;
+}
+
+/* Helpers for constrained_delaunay */
+
+/* Replaces the edge e of the triangulation with a constraint */
+static GtsEdge*
+delaunay_constrain(GtsEdge *e)
+{
+  GtsEdge *c;
+
+  if(GTS_IS_CONSTRAINT(e)) {
+    return e;
+  }
+  c = gts_edge_new(GTS_EDGE_CLASS(gts_constraint_class()),
+		   GTS_SEGMENT(e)->v1, GTS_SEGMENT(e)->v2);
+  gts_edge_replace(e, c);
+  gts_object_destroy(GTS_OBJECT(e));
+  return c;
+}
+
+typedef struct {
+  GtsSurface *s;
+  GSList *edges;
+} DelaunayBoundaryData;
+
+static void
+delaunay_boundary_edge(GtsEdge *e, DelaunayBoundaryData *data)
+{
+  if(!GTS_IS_CONSTRAINT(e) && gts_edge_is_boundary(e, data->s)) {
+    data->edges = g_slist_prepend(data->edges, e);
+  }
+}
+
+typedef struct {
+  gdouble min_angle, max_area;
+} DelaunayRefineData;
+
+/* Refinement cost: triangles with a negative cost are split, the most
+ * negative first.
+ */
+static gdouble
+delaunay_refine_cost(GtsTriangle *t, DelaunayRefineData *data)
+{
+  gdouble a, b, c, angle, area, cost=0.;
+
+  if(data->min_angle>0.) {
+    /* The smallest angle is opposite the shortest side */
+    a = gts_point_distance(GTS_POINT(GTS_SEGMENT(t->e1)->v1),
+			   GTS_POINT(GTS_SEGMENT(t->e1)->v2));
+    b = gts_point_distance(GTS_POINT(GTS_SEGMENT(t->e2)->v1),
+			   GTS_POINT(GTS_SEGMENT(t->e2)->v2));
+    c = gts_point_distance(GTS_POINT(GTS_SEGMENT(t->e3)->v1),
+			   GTS_POINT(GTS_SEGMENT(t->e3)->v2));
+    if(b<a) { angle = a; a = b; b = angle; }
+    if(c<a) { angle = a; a = c; c = angle; }
+    angle = acos(MIN(1., MAX(-1., (b*b+c*c-a*a)/(2.*b*c))));
+    if(angle<data->min_angle) {
+      cost = angle/data->min_angle - 2.;
+    }
+  }
+  if(data->max_area>0.) {
+    area = gts_triangle_area(t);
+    if(area>data->max_area) {
+      cost = MIN(cost, -area/data->max_area);
+    }
+  }
+  return cost;
+}
+
+/* Largest min_angle (degrees) for which refinement is guaranteed to 
+ * terminate, asin(1/(2*sqrt(2))).  Larger angles need a finite 
+ * steiner_max.
+ */
+#define DELAUNAY_MAX_MIN_ANGLE 20.7
+
+#define CDT_CLEANUP \
+  Py_XDECREF(coords); \
+  Py_XDECREF(segments); \
+  g_free(vertices);
+
+static PyObject*
+constrained_delaunay(PyObject *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *Opoints, *Osegments;
+  PyArrayObject *coords=NULL, *segments=NULL;
+  char *output = "surface";
+  gint conform = FALSE, steiner_max = -1;
+  gdouble min_angle = 0., max_area = 0.;
+  GtsVertex **vertices=NULL, *w[3];
+  GtsSurface *s;
+  GtsEdge *e;
+  GSList *conflicts, *i;
+  DelaunayBoundaryData bdata;
+  DelaunayRefineData rdata;
+  PyObject *result;
+  gint *seg;
+  guint N, K, k, nvertices;
+
+  static char *kwlist[] = {"points", "segments", "min_angle", "max_area",
+			   "conform", "steiner_max", "output", NULL};
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|ddiis", kwlist, 
+				  &Opoints, &Osegments, &min_angle, &max_area,
+				  &conform, &steiner_max, &output)) {
+    return NULL;
+  }
+
+  if(strcmp(output,"surface")!=0 && strcmp(output,"arrays")!=0) {
+    PyErr_SetString(PyExc_ValueError,
+		    "output must be 'surface' or 'arrays'");
+    return NULL;
+  }
+  if(min_angle<0. || min_angle>=60. || max_area<0.) {
+    PyErr_SetString(PyExc_ValueError,
+		    "min_angle must be in [0,60) and max_area non-negative");
+    return NULL;
+  }
+  if(min_angle>DELAUNAY_MAX_MIN_ANGLE && steiner_max<0) {
+    PyErr_SetString(PyExc_ValueError,
+		    "min_angle above 20.7 needs a non-negative steiner_max");
+    return NULL;
+  }
+
+  if( (coords = delaunay_points(Opoints)) == NULL ) {
+    return NULL;
+  }
+  N = coords->dimensions[0];
+
+  /* An empty sequence has no shape to convert to (K,2) */
+  if(PySequence_Check(Osegments) && PySequence_Size(Osegments)==0) {
+    K = 0;
+  }
+  else {
+    if(!(segments = (PyArrayObject *) 
+	 PyArray_ContiguousFromObject(Osegments, PyArray_INT, 2, 2))) {
+      CDT_CLEANUP;
+      return NULL;
+    }
+    if(segments->dimensions[1]!=2) {
+      PyErr_SetString(PyExc_ValueError,"segments must have shape (K,2)");
+      CDT_CLEANUP;
+      return NULL;
+    }
+    K = segments->dimensions[0];
+  }
+  seg = segments ? (gint*)segments->data : NULL;
+  for(k=0;k<2*K;k++) {
+    if(seg[k]<0 || seg[k]>=(gint)N) {
+      PyErr_SetString(PyExc_IndexError,"segment index out of range");
+      CDT_CLEANUP;
+      return NULL;
+    }
+  }
+
+  vertices = g_new(GtsVertex*,N);
+  if( (s = delaunay_surface((gdouble*)coords->data,N,vertices,w)) == NULL ) {
+    CDT_CLEANUP;
+    return NULL;
+  }
+
+  /* Insert the constraints while the enclosing triangle is in place */
+  for(k=0;k<K;k++) {
+    if(vertices[seg[2*k]]==vertices[seg[2*k+1]]) {
+      continue;
+    }
+    if( (e = GTS_EDGE(gts_vertices_are_connected(vertices[seg[2*k]],
+						 vertices[seg[2*k+1]]))) ) {
+      delaunay_constrain(e);
+      continue;
+    }
+    e = gts_edge_new(GTS_EDGE_CLASS(gts_constraint_class()),
+		     vertices[seg[2*k]], vertices[seg[2*k+1]]);
+    if( (conflicts = gts_delaunay_add_constraint(s, GTS_CONSTRAINT(e))) ) {
+      for(i=conflicts;i!=NULL;i=i->next) {
+	gts_object_destroy(GTS_OBJECT(i->data));
+      }
+      g_slist_free(conflicts);
+      delaunay_unenclose(w);
+      gts_object_destroy(GTS_OBJECT(s));
+      PyErr_SetString(PyExc_ValueError,"constraint segments intersect");
+      CDT_CLEANUP;
+      return NULL;
+    }
+  }
+  delaunay_unenclose(w);
+
+  if(conform || min_angle>0. || max_area>0.) {
+    /* Steiner points must not escape the hull, so constrain it too */
+    bdata.s = s;
+    bdata.edges = NULL;
+    gts_surface_foreach_edge(s, (GtsFunc)delaunay_boundary_edge, &bdata);
+    for(i=bdata.edges;i!=NULL;i=i->next) {
+      delaunay_constrain(GTS_EDGE(i->data));
+    }
+    g_slist_free(bdata.edges);
+
+    /* Conforming and refinement share the one budget of Steiner points */
+    nvertices = gts_surface_vertex_number(s);
+    if(gts_delaunay_conform(s, steiner_max,
+			    (GtsEncroachFunc)gts_vertex_encroaches_edge,
+			    NULL) == 0 && (min_angle>0. || max_area>0.)) {
+      if(steiner_max>=0) {
+	steiner_max = MAX(0, steiner_max - 
+			  (gint)(gts_surface_vertex_number(s)-nvertices));
+      }
+      rdata.min_angle = min_angle*M_PI/180.;
+      rdata.max_area = max_area;
+      gts_delaunay_refine(s, steiner_max,
+			  (GtsEncroachFunc)gts_vertex_encroaches_edge, NULL,
+			  (GtsKeyFunc)delaunay_refine_cost, &rdata);
+    }
+  }
+
+  Py_XDECREF(segments);
+  result = delaunay_output(s, coords, vertices, N, output);
+  g_free(vertices);
+  return result;
+}
+
+#endif /* PYGTS_HAS_NUMPY */
+
+
+static PyMethodDef gts_methods[] = {
+
+  {"read", (PyCFunction)pygts_read,
+   METH_VARARGS,
+   "Returns the data read from File f as a Surface.\n"
+   "The File data must be in GTS format (e.g., as written using\n"
+   "Surface.write())\n"
+   "\n"
+   "Signature: read(f)\n"
+  },
+
+  {"read_progressive", (PyCFunction)read_progressive,
+   METH_VARARGS,
+   "Returns the data read from File f as a ProgressiveSurface.\n"
+   "The File data must be in the format written by\n"
+   "ProgressiveSurface.write().  Only the coarsest Surface is read\n"
+   "at first; the vertex splits are read with ps.read_vertices() as\n"
+   "they are needed.\n"
+   "\n"
+   "Signature: read_progressive(f)\n"
+  },
+
+  { "sphere", sphere, METH_VARARGS,
+    "Returns a unit sphere generated by recursive subdivision.\n"
+    "First approximation is an isocahedron; each level of refinement\n"
+    "(geodesation_order) increases the number of triangles by a factor\n"
+    "of 4.\n"
+    "\n"
+    "Signature: sphere(geodesation_order)\n"
+  },
+
+#if PYGTS_HAS_NUMPY
+  {"isosurface",  (PyCFunction)isosurface, 
+   METH_VARARGS|METH_KEYWORDS,
+   "Adds to surface new faces defining the isosurface data[x,y,z] = c\n"
+   "\n"
+   "Signature: isosurface(data, c, ...)\n"
+   "\n"
+   "data is a 3D numpy array, or a callable f(k) or iterator that\n"
+   "     provides the 2D slices data[:,:,k] in order.  Sliced data\n"
+   "     is used for volumes that don't fit in memory; only two\n"
+   "     slices are held at a time.\n"
+   "c    is the isovalue defining the surface\n"
+   "\n"
+   "Keyword arguments:\n"
+   "nz=      The number of slices (required for sliced data).\n"
+   "extents= [xmin, xmax, ymin, ymax, zmin, zmax]\n"
+   "         A numpy array defining the extent of the data cube.\n" 
+   "         Default is the cube with corners at (-1,-1,-1) and (1,1,1)\n"
+   "         Data is assumed to be regularly sampled in the cube.\n"
+   "method=  ['cube'|'tetra'|'dual'|'bounded']\n"
+   "         String (only the first character counts) specifying the\n"
+   "         method.\n"
+   "         cube    -- marching cubes (default)\n"
+   "         tetra   -- marching tetrahedra\n"
+   "         dual    -- maching tetrahedra producing dual 'body-centred'\n"
+   "                    faces relative to 'tetra'\n"
+   "         bounded -- marching tetrahedra ensuring the surface is\n"
+   "                    bounded by adding a border of large negative\n"
+   "                    values around the domain.\n"
+   "\n"
+   "blocksize= The side-length, in cells, of the blocks used to skip\n"
+   "         regions of the data that cannot contain the isosurface\n"
+   "         (cube and tetra methods only; must be even for tetra).\n"
+   "         Default is 0 (no blocks).\n"
+   "blocks=  The array returned by isosurface_blocks(data,blocksize);\n"
+   "         pass it to reuse the block ranges for many values of c.\n"
+   "output=  ['surface'|'arrays']\n"
+   "         surface -- return a Surface (default)\n"
+   "         arrays  -- return the tuple (coords, triangles) of numpy\n"
+   "                    arrays with shapes (N,3) and (M,3), without\n"
+   "                    creating any Vertex, Edge or Face objects.\n"
+   "                    The cube and tetra methods emit the arrays\n"
+   "                    directly; their triangles differ from those\n"
+   "                    of the Surface output.\n"
+   "normals= If True, arrays output also includes the (N,3) array of\n"
+   "         unit vertex normals.  Only for arrays output.  Default\n"
+   "         is False.\n"
+   "\n"
+   "By convention, the normals to the surface are pointing towards\n"
+   "positive values of data[x,y,z] - c.\n"
+  },
+
+  {"isosurface_blocks",  (PyCFunction)isosurface_blocks, 
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns an array with the minimum and maximum of data over blocks\n"
+   "of blocksize cells along each axis.  The array may be passed to\n"
+   "isosurface() to skip the blocks that do not contain a given c.\n"
+   "\n"
+   "Signature: isosurface_blocks(data, blocksize=8)\n"
+   "\n"
+   "data is a 3D numpy array.  The returned array has shape\n"
+   "(nbx,nby,nbz,2), with nb = ceil((n-1)/blocksize) for each axis;\n"
+   "[...,0] holds the minima and [...,1] the maxima.\n"
+  },
+  {"delaunay",  (PyCFunction)delaunay, 
+   METH_VARARGS|METH_KEYWORDS,
+   "Returns the Delaunay triangulation of points in the (x,y) plane.\n"
+   "\n"
+   "Signature: delaunay(points, output='surface')\n"
+   "\n"
+   "points is a numpy array (or sequence) with shape (N,2) or (N,3);\n"
+   "       z defaults to 0 and is carried along but not used.\n"
+   "\n"
+   "Keyword arguments:\n"
+   "output=  ['surface'|'arrays']\n"
+   "         surface -- return a Surface (default)\n"
+   "         arrays  -- return the tuple (coords, triangles) of numpy\n"
+   "                    arrays with shapes (N,3) and (M,3); triangles\n"
+   "                    index the input points.\n"
+   "\n"
+   "The points are inserted in a biased randomized order, with each\n"
+   "round sorted along a Hilbert curve.  Duplicate points are\n"
+   "inserted once.  Faces are oriented counter-clockwise in (x,y).\n"
+  },
+
+  {"constrained_delaunay",  (PyCFunction)constrained_delaunay, 
+   METH_VARARGS|METH_KEYWORDS,
+   "Returns the constrained Delaunay triangulation of points in the\n"
+   "(x,y) plane, optionally conformed and refined.\n"
+   "\n"
+   "Signature: constrained_delaunay(points, segments, ...)\n"
+   "\n"
+   "points   is a numpy array (or sequence) with shape (N,2) or (N,3).\n"
+   "segments is an integer array with shape (K,2) of pairs of indices\n"
+   "         into points giving the edges (e.g., breaklines) that\n"
+   "         must appear in the triangulation.  Segments may not\n"
+   "         cross.\n"
+   "\n"
+   "Keyword arguments:\n"
+   "min_angle=   Refine until no triangle has an angle smaller than\n"
+   "             this (degrees).  Refinement is only guaranteed to\n"
+   "             terminate for values up to 20.7; larger values need\n"
+   "             a non-negative steiner_max.  Default is 0.\n"
+   "max_area=    Refine until no triangle is larger than this.\n"
+   "             Default is 0 (no limit).\n"
+   "conform=     If True, split the constraints until they are\n"
+   "             Delaunay edges.  Implied by refinement.\n"
+   "steiner_max= The maximum number of Steiner points to add while\n"
+   "             conforming and refining together, or -1 for no\n"
+   "             limit (default).\n"
+   "output=      ['surface'|'arrays']\n"
+   "             surface -- return a Surface (default)\n"
+   "             arrays  -- return the tuple (coords, triangles); the\n"
+   "                        Steiner points follow the N input points\n"
+   "                        in coords.\n"
+   "\n"
+   "Conforming and refinement also constrain the convex hull of the\n"
+   "points, so that Steiner points stay inside it.\n"
+  },
+#endif /* PYGTS_HAS_NUMPY */
+
+  { "merge", merge, METH_VARARGS,
+    "Merges list of Vertices that are within a box of side-length\n"
+    "epsilon of each other.\n"
+    "\n"
+    "Signature: merge(list,epsilon)\n"
+  },
+
+  { "vertices", vertices, METH_VARARGS,
+    "Returns tuple of Vertices from a list or tuple of Segments.\n"
+    "\n"
+    "Signature: vertices(list)\n"
+  },
+
+  { "segments", segments, METH_VARARGS,
+    "Returns tuple of Segments from a list or tuple of Vertices.\n"
+    "\n"
+    "Signature: segments(list)\n"
+  },
+
+  { "triangles", triangles, METH_VARARGS,
+    "Returns tuple of Triangles from a list or tuple of Edges.\n"
+    "\n"
+    "Signature: triangles(list)\n"
+  },
+
+  { "triangle_enclosing", triangle_enclosing, METH_VARARGS,
+    "Returns a Triangle that encloses the plane projection of a list\n"
+    "or tuple of Points.  The Triangle is equilateral and encloses a\n"
+    "rectangle defined by the maximum and minimum x and y coordinates\n"
+    "of the points.\n"
+    "\n"
+    "Signature: triangles(list)\n"
+  },
 
 
   {NULL}  /* Sentinel */
@@ -757,6 +2518,12 @@ init_gts(void)
   PygtsSurfaceType.tp_base = &PygtsObjectType;
   if (PyType_Ready(&PygtsSurfaceType) < 0) return;
 
+  PygtsProgressiveSurfaceType.tp_base = &PygtsObjectType;
+  if (PyType_Ready(&PygtsProgressiveSurfaceType) < 0) return;
+
+  PyStructSequence_InitType(&PygtsRangeType,&pygts_range_desc);
+  PyStructSequence_InitType(&PygtsMetricsType,&pygts_metrics_desc);
+
 
   /* Initialize the module */
   m = Py_InitModule3("_gts", gts_methods,"Gnu Triangulated Surface Library");
@@ -791,4 +2558,14 @@ init_gts(void)
 
   Py_INCREF(&PygtsSurfaceType);
   PyModule_AddObject(m, "Surface", (PyObject *)&PygtsSurfaceType);
+
+  Py_INCREF(&PygtsProgressiveSurfaceType);
+  PyModule_AddObject(m, "ProgressiveSurface", 
+		     (PyObject *)&PygtsProgressiveSurfaceType);
+
+  Py_INCREF(&PygtsRangeType);
+  PyModule_AddObject(m, "Range", (PyObject *)&PygtsRangeType);
+
+  Py_INCREF(&PygtsMetricsType);
+  PyModule_AddObject(m, "Metrics", (PyObject *)&PygtsMetricsType);
 }
@@ -38,6 +38,7 @@
 
 #include <Python.h>
 #include <structmember.h>
+#include <structseq.h>
 
 /* Defined for arrayobject.h which is only included where needed */
 #define PY_ARRAY_UNIQUE_SYMBOL PYGTS
@@ -53,6 +54,7 @@
 #include "triangle.h"
 #include "face.h"
 #include "surface.h"
+#include "psurface.h"
 
 #include "cleanup.h"
 
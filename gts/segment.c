@@ -445,6 +445,8 @@ compare(PygtsSegment *s1_, PygtsSegment *s2_)
   pygts_segment_check((PyObject*)s2_);
 #endif
 
+  if( pygts_surface_apply_pending_transform()==-1 ) return -1;
+
   s1 = PYGTS_SEGMENT_AS_GTS_SEGMENT(s1_);
   s2 = PYGTS_SEGMENT_AS_GTS_SEGMENT(s2_);
   
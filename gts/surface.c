@@ -27,6 +27,11 @@
 
 #include "pygts.h"
 
+#if PYGTS_HAS_NUMPY
+  #define NO_IMPORT_ARRAY
+  #include "numpy/arrayobject.h"
+#endif
+
 #if PYGTS_DEBUG
   #define SELF_CHECK if(!pygts_surface_check((PyObject*)self)) {      \
                        PyErr_SetString(PyExc_RuntimeError,            \
@@ -38,6 +43,492 @@
 #endif
 
 
+/* Helpers for the cached invariants.  The cache is dropped whenever the
+ * Surface or any element that may be shared with it has changed.  
+ * Cached values are for the vertices as they are, without any pending
+ * transform.
+ */
+#define CACHE_IS_MANIFOLD    (1<<0)
+#define CACHE_IS_ORIENTABLE  (1<<1)
+#define CACHE_IS_CLOSED      (1<<2)
+#define CACHE_AREA           (1<<3)
+#define CACHE_VOLUME         (1<<4)
+#define CACHE_CENTER_OF_MASS (1<<5)
+#define CACHE_CENTER_OF_AREA (1<<6)
+
+static gboolean
+cache_has(PygtsSurface *self, guint flag)
+{
+  if( self->cache.version!=self->version || 
+      self->cache.geometry!=self->geometry ) {
+    self->cache.version = self->version;
+    self->cache.geometry = self->geometry;
+    self->cache.valid = 0;
+  }
+  return (self->cache.valid & flag) != 0;
+}
+
+
+static gboolean
+surface_is_manifold(PygtsSurface *self)
+{
+  if( !cache_has(self,CACHE_IS_MANIFOLD) ) {
+    self->cache.is_manifold = 
+      gts_surface_is_manifold(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+    self->cache.valid |= CACHE_IS_MANIFOLD;
+  }
+  return self->cache.is_manifold;
+}
+
+
+static gboolean
+surface_is_orientable(PygtsSurface *self)
+{
+  if( !cache_has(self,CACHE_IS_ORIENTABLE) ) {
+    self->cache.is_orientable = 
+      gts_surface_is_orientable(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+    self->cache.valid |= CACHE_IS_ORIENTABLE;
+  }
+  return self->cache.is_orientable;
+}
+
+
+static gboolean
+surface_is_closed(PygtsSurface *self)
+{
+  if( !cache_has(self,CACHE_IS_CLOSED) ) {
+    self->cache.is_closed = 
+      gts_surface_is_closed(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+    self->cache.valid |= CACHE_IS_CLOSED;
+  }
+  return self->cache.is_closed;
+}
+
+
+/* Helpers for changes to elements that may be shared between Surfaces.
+ * Operations that change the connectivity around a vertex mark every 
+ * wrapped Surface with a Face on it as changed, so that orders and 
+ * caches that depend on the connectivity are redone.  Operations that
+ * move a vertex mark the same Surfaces as moved.  GtsSurface skip, if 
+ * not NULL, is passed over.
+ */
+static void
+vertex_foreach_surface(GtsVertex *v, GtsSurface *skip,
+		       void (*func)(PygtsSurface*))
+{
+  GSList *i, *j, *k;
+  PyObject *o;
+
+  for(i=v->segments; i!=NULL; i=g_slist_next(i)) {
+    if( !GTS_IS_EDGE(i->data) ) continue;
+    for(j=GTS_EDGE(i->data)->triangles; j!=NULL; j=g_slist_next(j)) {
+      if( !GTS_IS_FACE(j->data) ) continue;
+      for(k=GTS_FACE(j->data)->surfaces; k!=NULL; k=g_slist_next(k)) {
+	if( k->data==skip ) continue;
+	o = (PyObject*)g_hash_table_lookup(obj_table,k->data);
+	if( o!=NULL && PyObject_TypeCheck(o,&PygtsSurfaceType) ) {
+	  func(PYGTS_SURFACE(o));
+	}
+      }
+    }
+  }
+}
+
+static void
+surface_changed(PygtsSurface *self)
+{
+  PYGTS_SURFACE_CHANGED(self);
+}
+
+void
+pygts_surface_vertex_changed(GtsVertex *v)
+{
+  vertex_foreach_surface(v,NULL,surface_changed);
+}
+
+static void
+surface_moved(PygtsSurface *self)
+{
+  PYGTS_SURFACE_MOVED(self);
+}
+
+void
+pygts_surface_vertex_moved(GtsVertex *v)
+{
+  vertex_foreach_surface(v,NULL,surface_moved);
+}
+
+/* Marks self, and every Surface that shares a vertex with it, as changed */
+static void
+surface_shared_changed(PygtsSurface *self)
+{
+  PYGTS_SURFACE_CHANGED(self);
+  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			     (GtsFunc)pygts_surface_vertex_changed,NULL);
+}
+
+
+/* Helpers for the element order.  Traversals that give elements in an
+ * order seen from python (vertices(), face_indices() and the arrays) go
+ * through surface_foreach_vertex() and surface_foreach_face(), which use 
+ * the order from reorder() for as long as it is valid.  The order only
+ * depends on the connectivity, so it is kept against the Surface version
+ * alone and survives changes to the coordinates.
+ */
+static void
+order_clear(PygtsSurface *self)
+{
+  g_free(self->order.vertices);
+  g_free(self->order.faces);
+  self->order.vertices = NULL;
+  self->order.faces = NULL;
+  self->order.nvertices = self->order.nfaces = 0;
+}
+
+static gboolean
+order_valid(PygtsSurface *self)
+{
+  if( self->order.vertices!=NULL && self->order.version!=self->version ) {
+    order_clear(self);
+  }
+  return self->order.vertices!=NULL;
+}
+
+static void
+surface_foreach_vertex(PygtsSurface *self, GtsFunc func, gpointer data)
+{
+  guint i;
+
+  if( order_valid(self) ) {
+    for(i=0;i<self->order.nvertices;i++) {
+      func(self->order.vertices[i],data);
+    }
+  }
+  else {
+    gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),func,data);
+  }
+}
+
+static void
+surface_foreach_face(PygtsSurface *self, GtsFunc func, gpointer data)
+{
+  guint i;
+
+  if( order_valid(self) ) {
+    for(i=0;i<self->order.nfaces;i++) {
+      func(self->order.faces[i],data);
+    }
+  }
+  else {
+    gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),func,data);
+  }
+}
+
+
+/* Helpers for the bounding-box tree of the faces.  The tree is kept 
+ * against the Surface version and geometry, so that repeated queries 
+ * against an unchanged Surface share it.
+ */
+static void
+tree_clear(PygtsSurface *self)
+{
+  if( self->tree.tree!=NULL ) {
+    gts_bb_tree_destroy(self->tree.tree,TRUE);
+    self->tree.tree = NULL;
+  }
+}
+
+/* Returns the tree, or NULL if the Surface has no faces */
+static GNode*
+surface_bb_tree(PygtsSurface *self)
+{
+  if( self->tree.tree!=NULL &&
+      (self->tree.version!=self->version || 
+       self->tree.geometry!=self->geometry) ) {
+    tree_clear(self);
+  }
+  if( self->tree.tree==NULL && 
+      gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(self))>0 ) {
+    self->tree.tree = gts_bb_tree_surface(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+    self->tree.version = self->version;
+    self->tree.geometry = self->geometry;
+  }
+  return self->tree.tree;
+}
+
+
+/* Breadth-first traversal of the faces, one connected component after 
+ * another.  Unlike gts_surface_traverse_new(), the visited faces are 
+ * kept in a hash table rather than in the GTS reserved fields, so that
+ * a traversal doesn't interfere with other operations.  Faces that are
+ * removed from the surface during a traversal are skipped.
+ */
+struct _PygtsSurfaceTraverse {
+  GtsSurface *s;
+  GHashTable *visited;  /* Faces that have been queued */
+  GQueue *queue;        /* Faces to visit */
+  GPtrArray *faces;     /* Faces to start each component from */
+  guint next;           /* Next start candidate in faces */
+};
+
+/* Tests if f is on s without dereferencing f, which may be gone */
+static gboolean
+surface_has_face(GtsSurface *s, gpointer f)
+{
+  return g_hash_table_lookup(s->faces,f) != NULL;
+}
+
+static void
+gather_face(GtsFace *f, GPtrArray *faces)
+{
+  g_ptr_array_add(faces,f);
+}
+
+static void
+gather_vertex(GtsVertex *v, GPtrArray *vertices)
+{
+  g_ptr_array_add(vertices,v);
+}
+
+static PygtsSurfaceTraverse*
+traverse_new(PygtsSurface *self)
+{
+  PygtsSurfaceTraverse *t;
+
+  t = g_new(PygtsSurfaceTraverse,1);
+  t->s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+  t->visited = g_hash_table_new(NULL,NULL);
+  t->queue = g_queue_new();
+  t->faces = g_ptr_array_sized_new(gts_surface_face_number(t->s));
+  surface_foreach_face(self,(GtsFunc)gather_face,t->faces);
+  t->next = 0;
+  return t;
+}
+
+static void
+traverse_destroy(PygtsSurfaceTraverse *t)
+{
+  g_hash_table_destroy(t->visited);
+  g_queue_free(t->queue);
+  g_ptr_array_free(t->faces,TRUE);
+  g_free(t);
+}
+
+/* Returns the next face, or NULL when all have been visited */
+static GtsFace*
+traverse_next(PygtsSurfaceTraverse *t)
+{
+  GtsFace *f;
+  GtsEdge *e[3];
+  GSList *i;
+  guint j;
+
+  for(;;) {
+    while( (f=GTS_FACE(g_queue_pop_head(t->queue))) != NULL ) {
+      if( !surface_has_face(t->s,f) ) continue;
+
+      /* Queue the neighbors */
+      e[0] = GTS_TRIANGLE(f)->e1;
+      e[1] = GTS_TRIANGLE(f)->e2;
+      e[2] = GTS_TRIANGLE(f)->e3;
+      for(j=0;j<3;j++) {
+	for(i=e[j]->triangles;i!=NULL;i=g_slist_next(i)) {
+	  if( surface_has_face(t->s,i->data) &&
+	      !g_hash_table_lookup(t->visited,i->data) ) {
+	    g_hash_table_insert(t->visited,i->data,i->data);
+	    g_queue_push_tail(t->queue,i->data);
+	  }
+	}
+      }
+      return f;
+    }
+
+    /* Start on the next component */
+    while( t->next < t->faces->len ) {
+      f = GTS_FACE(g_ptr_array_index(t->faces,t->next++));
+      if( surface_has_face(t->s,f) && !g_hash_table_lookup(t->visited,f) ) {
+	g_hash_table_insert(t->visited,f,f);
+	g_queue_push_tail(t->queue,f);
+	break;
+      }
+    }
+    if( g_queue_is_empty(t->queue) ) return NULL;
+  }
+}
+
+
+/* Helpers for the self-intersection tests.  Each face is checked
+ * against the faces whose boxes overlap its own in the bb-tree, and the
+ * faces are shared between threads.  As for 
+ * gts_surface_is_self_intersecting(), two faces intersect if an edge of
+ * one meets the other, boundary included, and shares no vertex with it.
+ */
+#define INTERSECT_PARALLEL_MIN 1000
+
+typedef struct {
+  gint i, j;
+} IntersectPair;
+
+/* As gts_segment_triangle_intersection() with boundary TRUE, without
+ * creating the point
+ */
+static gboolean
+edge_crosses_triangle(GtsSegment *s, GtsTriangle *t)
+{
+  GtsVertex *v1, *v2, *v3;
+  GtsPoint *A, *B, *C, *D, *E, *tmpp;
+  gdouble ABCE, ABCD, tmp;
+
+  gts_triangle_vertices(t,&v1,&v2,&v3);
+  if( s->v1==v1 || s->v1==v2 || s->v1==v3 ||
+      s->v2==v1 || s->v2==v2 || s->v2==v3 ) {
+    return FALSE;
+  }
+  A = GTS_POINT(v1); B = GTS_POINT(v2); C = GTS_POINT(v3);
+  D = GTS_POINT(s->v1); E = GTS_POINT(s->v2);
+
+  ABCE = gts_point_orientation_3d(A,B,C,E);
+  ABCD = gts_point_orientation_3d(A,B,C,D);
+  if( ABCE<0. || ABCD>0. ) {
+    tmpp = E; E = D; D = tmpp;
+    tmp = ABCE; ABCE = ABCD; ABCD = tmp;
+  }
+  if( ABCE<0. || ABCD>0. ) {
+    return FALSE;
+  }
+  if( ABCE==0. && ABCD==0. ) {
+    /* s is in the plane of t */
+    return FALSE;
+  }
+  return gts_point_orientation_3d(A,D,C,E)>=0. &&
+    gts_point_orientation_3d(A,B,D,E)>=0. &&
+    gts_point_orientation_3d(B,C,D,E)>=0.;
+}
+
+static gboolean
+triangles_intersect(GtsTriangle *t1, GtsTriangle *t2)
+{
+  return edge_crosses_triangle(GTS_SEGMENT(t1->e1),t2) ||
+    edge_crosses_triangle(GTS_SEGMENT(t1->e2),t2) ||
+    edge_crosses_triangle(GTS_SEGMENT(t1->e3),t2) ||
+    edge_crosses_triangle(GTS_SEGMENT(t2->e1),t1) ||
+    edge_crosses_triangle(GTS_SEGMENT(t2->e2),t1) ||
+    edge_crosses_triangle(GTS_SEGMENT(t2->e3),t1);
+}
+
+typedef struct {
+  GHashTable *indices;  /* Maps faces to their index+1 */
+  GtsBBox **boxes;
+} IntersectBoxData;
+
+static gboolean
+intersect_box(GNode *node, IntersectBoxData *data)
+{
+  GtsBBox *bbox = GTS_BBOX(node->data);
+
+  data->boxes[GPOINTER_TO_INT(g_hash_table_lookup(data->indices,
+						  bbox->bounded))-1] = bbox;
+  return FALSE;
+}
+
+static int
+intersect_pair_compare(const void *a, const void *b)
+{
+  const IntersectPair *p1=(const IntersectPair*)a, *p2=(const IntersectPair*)b;
+
+  if(p1->i!=p2->i) return p1->i<p2->i ? -1 : 1;
+  return p1->j<p2->j ? -1 : (p1->j>p2->j);
+}
+
+/* Returns the sorted pairs (i,j), i<j, of intersecting faces, indexed in
+ * surface_foreach_face() order.  If first is TRUE, stops once any pair
+ * is found.
+ */
+static GArray*
+surface_self_intersections(PygtsSurface *self, gboolean first)
+{
+  GNode *tree;
+  GPtrArray *faces;
+  IntersectBoxData data;
+  GArray *pairs;
+  gboolean found=FALSE;
+  gint i, N;
+
+  pairs = g_array_new(FALSE,FALSE,sizeof(IntersectPair));
+  if( (tree=surface_bb_tree(self)) == NULL ) {
+    return pairs;
+  }
+
+  faces = g_ptr_array_new();
+  surface_foreach_face(self,(GtsFunc)gather_face,faces);
+  N = faces->len;
+  data.indices = g_hash_table_new(NULL,NULL);
+  for(i=0;i<N;i++) {
+    g_hash_table_insert(data.indices,g_ptr_array_index(faces,i),
+			GINT_TO_POINTER(i+1));
+  }
+  data.boxes = g_new(GtsBBox*,N);
+  g_node_traverse(tree,G_PRE_ORDER,G_TRAVERSE_LEAVES,-1,
+		  (GNodeTraverseFunc)intersect_box,&data);
+
+#pragma omp parallel if(N>=INTERSECT_PARALLEL_MIN)
+  {
+    GArray *local = g_array_new(FALSE,FALSE,sizeof(IntersectPair));
+    IntersectPair pair;
+    GSList *overlap, *k;
+    GtsTriangle *t;
+    gboolean done;
+
+#pragma omp for schedule(dynamic,64)
+    for(i=0;i<N;i++) {
+#pragma omp atomic read
+      done = found;
+      if(done) continue;
+
+      overlap = gts_bb_tree_overlap(tree,data.boxes[i]);
+      for(k=overlap;k!=NULL;k=k->next) {
+	t = GTS_TRIANGLE(GTS_BBOX(k->data)->bounded);
+	pair.i = i;
+	pair.j = GPOINTER_TO_INT(g_hash_table_lookup(data.indices,t))-1;
+	if( pair.j>i && 
+	    triangles_intersect(GTS_TRIANGLE(g_ptr_array_index(faces,i)),t) ) {
+	  g_array_append_val(local,pair);
+	  if(first) {
+#pragma omp atomic write
+	    found = TRUE;
+	    break;
+	  }
+	}
+      }
+      g_slist_free(overlap);
+    }
+
+#pragma omp critical
+    g_array_append_vals(pairs,local->data,local->len);
+    g_array_free(local,TRUE);
+  }
+
+  g_free(data.boxes);
+  g_hash_table_destroy(data.indices);
+  g_ptr_array_free(faces,TRUE);
+
+  qsort(pairs->data,pairs->len,sizeof(IntersectPair),intersect_pair_compare);
+  return pairs;
+}
+
+static gboolean
+surface_is_self_intersecting(PygtsSurface *self)
+{
+  GArray *pairs;
+  gboolean ret;
+
+  pairs = surface_self_intersections(self,TRUE);
+  ret = pairs->len>0;
+  g_array_free(pairs,TRUE);
+  return ret;
+}
+
+
 /*-------------------------------------------------------------------------*/
 /* Methods exported to python */
 
@@ -87,6 +578,7 @@ add(PygtsSurface *self, PyObject *args)
     PyErr_SetString(PyExc_TypeError,"expected a Face or a Surface");
     return NULL;
   }
+  PYGTS_SURFACE_CHANGED(self);
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -115,12 +607,81 @@ pygts_remove(PygtsSurface *self, PyObject *args)
   /* Make the call */
   gts_surface_remove_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),
 			  PYGTS_FACE_AS_GTS_FACE(f));
+  PYGTS_SURFACE_CHANGED(self);
 
   Py_INCREF(Py_None);
   return Py_None;
 }
 
 
+/* Copies the faces of s to self in the order from s.reorder(), as
+ * gts_surface_copy() does otherwise.  The new vertices, edges and faces
+ * are allocated in that order, which carries over to self if it was 
+ * empty.
+ */
+static void
+surface_copy_ordered(PygtsSurface *self, PygtsSurface *s)
+{
+  GtsSurface *s1=PYGTS_SURFACE_AS_GTS_SURFACE(self);
+  GHashTable *copies;
+  GtsVertex **vertices, *v;
+  GtsEdge *e[3], *ec[3];
+  GtsFace **faces, *f;
+  gboolean empty;
+  guint i, j;
+
+  empty = gts_surface_face_number(s1)==0;
+  copies = g_hash_table_new(NULL,NULL);
+  vertices = g_new(GtsVertex*,s->order.nvertices+1);
+  faces = g_new(GtsFace*,s->order.nfaces+1);
+
+  for(i=0;i<s->order.nvertices;i++) {
+    v = s->order.vertices[i];
+    vertices[i] = gts_vertex_new(s1->vertex_class,
+				 GTS_POINT(v)->x,GTS_POINT(v)->y,
+				 GTS_POINT(v)->z);
+    gts_object_attributes(GTS_OBJECT(vertices[i]),GTS_OBJECT(v));
+    g_hash_table_insert(copies,v,vertices[i]);
+  }
+
+  for(i=0;i<s->order.nfaces;i++) {
+    f = s->order.faces[i];
+    e[0] = GTS_TRIANGLE(f)->e1;
+    e[1] = GTS_TRIANGLE(f)->e2;
+    e[2] = GTS_TRIANGLE(f)->e3;
+    for(j=0;j<3;j++) {
+      if( (ec[j]=GTS_EDGE(g_hash_table_lookup(copies,e[j]))) == NULL ) {
+	ec[j] = gts_edge_new(s1->edge_class,
+		      GTS_VERTEX(g_hash_table_lookup(copies,
+						     GTS_SEGMENT(e[j])->v1)),
+		      GTS_VERTEX(g_hash_table_lookup(copies,
+						     GTS_SEGMENT(e[j])->v2)));
+	gts_object_attributes(GTS_OBJECT(ec[j]),GTS_OBJECT(e[j]));
+	g_hash_table_insert(copies,e[j],ec[j]);
+      }
+    }
+    faces[i] = gts_face_new(s1->face_class,ec[0],ec[1],ec[2]);
+    gts_object_attributes(GTS_OBJECT(faces[i]),GTS_OBJECT(f));
+    gts_surface_add_face(s1,faces[i]);
+  }
+  g_hash_table_destroy(copies);
+
+  PYGTS_SURFACE_CHANGED(self);
+  order_clear(self);
+  if(empty) {
+    self->order.vertices = vertices;
+    self->order.faces = faces;
+    self->order.nvertices = s->order.nvertices;
+    self->order.nfaces = s->order.nfaces;
+    self->order.version = self->version;
+  }
+  else {
+    g_free(vertices);
+    g_free(faces);
+  }
+}
+
+
 static PyObject*
 copy(PygtsSurface *self, PyObject *args)
 {
@@ -141,8 +702,14 @@ copy(PygtsSurface *self, PyObject *args)
   s = PYGTS_SURFACE(s_);
 
   /* Make the call */
-  gts_surface_copy(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-		   PYGTS_SURFACE_AS_GTS_SURFACE(s));
+  if( s!=self && order_valid(s) ) {
+    surface_copy_ordered(self,s);
+  }
+  else {
+    gts_surface_copy(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+		     PYGTS_SURFACE_AS_GTS_SURFACE(s));
+    PYGTS_SURFACE_CHANGED(self);
+  }
 
   Py_INCREF((PyObject*)self);
   return (PyObject*)self;
@@ -155,7 +722,7 @@ is_manifold(PygtsSurface *self, PyObject *args)
 
   SELF_CHECK
 
-  if( gts_surface_is_manifold(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ) {
+  if( surface_is_manifold(self) ) {
     Py_INCREF(Py_True);
     return Py_True;
   }
@@ -213,7 +780,7 @@ is_orientable(PygtsSurface *self, PyObject *args)
 {
   SELF_CHECK
 
-  if(gts_surface_is_orientable(PYGTS_SURFACE_AS_GTS_SURFACE(self))) {
+  if(surface_is_orientable(self)) {
     Py_INCREF(Py_True);
     return Py_True;
   }
@@ -229,7 +796,7 @@ is_closed(PygtsSurface *self, PyObject *args)
 {
   SELF_CHECK
 
-  if(gts_surface_is_closed(PYGTS_SURFACE_AS_GTS_SURFACE(self))) {
+  if(surface_is_closed(self)) {
     Py_INCREF(Py_True);
     return Py_True;
   }
@@ -287,7 +854,21 @@ area(PygtsSurface *self, PyObject *args)
   SELF_CHECK
 
   s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
-  return Py_BuildValue("d",gts_surface_area(s));
+  if( !cache_has(self,CACHE_AREA) ) {
+    self->cache.area = gts_surface_area(s);
+    self->cache.valid |= CACHE_AREA;
+  }
+  return Py_BuildValue("d",self->cache.area);
+}
+
+
+/* Determinant of the linear part of an affine matrix */
+static gdouble
+det3(GtsMatrix *m)
+{
+  return m[0][0]*(m[1][1]*m[2][2]-m[1][2]*m[2][1])
+    - m[0][1]*(m[1][0]*m[2][2]-m[1][2]*m[2][0])
+    + m[0][2]*(m[1][0]*m[2][1]-m[1][1]*m[2][0]);
 }
 
 
@@ -295,22 +876,34 @@ static PyObject*
 volume(PygtsSurface *self, PyObject *args)
 {
   GtsSurface *s;
+  gdouble volume;
 
   SELF_CHECK
 
   s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
 
-  if(!gts_surface_is_closed(s)) {
+  if(!surface_is_closed(self)) {
     PyErr_SetString(PyExc_RuntimeError,"Surface is not closed");
     return NULL;
   }
 
-  if(!gts_surface_is_orientable(s)) {
+  if(!surface_is_orientable(self)) {
     PyErr_SetString(PyExc_RuntimeError,"Surface is not orientable");
     return NULL;
   }
 
-  return Py_BuildValue("d",gts_surface_volume(s));
+  if( !cache_has(self,CACHE_VOLUME) ) {
+    self->cache.volume = gts_surface_volume(s);
+    self->cache.valid |= CACHE_VOLUME;
+  }
+
+  /* A pending transform scales the volume by its determinant */
+  volume = self->cache.volume;
+  if( self->transform != NULL ) {
+    volume *= det3(self->transform);
+  }
+
+  return Py_BuildValue("d",volume);
 }
 
 
@@ -318,12 +911,26 @@ static PyObject*
 center_of_mass(PygtsSurface *self, PyObject *args)
 {
   GtsSurface *s;
-  GtsVector cm;
+  gdouble *cm;
+  GtsMatrix *m;
 
   SELF_CHECK
 
   s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
-  gts_surface_center_of_mass(s,cm);
+  if( !cache_has(self,CACHE_CENTER_OF_MASS) ) {
+    gts_surface_center_of_mass(s,self->cache.center_of_mass);
+    self->cache.valid |= CACHE_CENTER_OF_MASS;
+  }
+  cm = self->cache.center_of_mass;
+
+  /* The center of mass moves with any pending transform */
+  if( (m=self->transform) != NULL ) {
+    return Py_BuildValue("ddd",
+			 m[0][0]*cm[0]+m[0][1]*cm[1]+m[0][2]*cm[2]+m[0][3],
+			 m[1][0]*cm[0]+m[1][1]*cm[1]+m[1][2]*cm[2]+m[1][3],
+			 m[2][0]*cm[0]+m[2][1]*cm[1]+m[2][2]*cm[2]+m[2][3]);
+  }
+
   return Py_BuildValue("ddd",cm[0],cm[1],cm[2]);
 }
 
@@ -332,12 +939,16 @@ static PyObject*
 center_of_area(PygtsSurface *self, PyObject *args)
 {
   GtsSurface *s;
-  GtsVector cm;
+  gdouble *cm;
 
   SELF_CHECK
 
   s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
-  gts_surface_center_of_area(s,cm);
+  if( !cache_has(self,CACHE_CENTER_OF_AREA) ) {
+    gts_surface_center_of_area(s,self->cache.center_of_area);
+    self->cache.valid |= CACHE_CENTER_OF_AREA;
+  }
+  cm = self->cache.center_of_area;
   return Py_BuildValue("ddd",cm[0],cm[1],cm[2]);
 }
 
@@ -476,7 +1087,7 @@ fan_oriented(PygtsSurface *self, PyObject *args)
   /* Check that the Surface is orientable; the calculation will
    * fail otherwise.
    */
-  if(!gts_surface_is_orientable(PYGTS_SURFACE_AS_GTS_SURFACE(self))) {
+  if(!surface_is_orientable(self)) {
     PyErr_SetString(PyExc_RuntimeError,"Surface must be orientable");
     return NULL;
   }
@@ -506,16 +1117,36 @@ fan_oriented(PygtsSurface *self, PyObject *args)
 }
 
 
+#if PYGTS_HAS_NUMPY
+static PyObject* split_arrays(PygtsSurface *self);
+#endif
+
 static PyObject*
-split(PygtsSurface *self, PyObject *args)
+split(PygtsSurface *self, PyObject *args, PyObject *kwds)
 {
   GSList *surfaces, *s;
   PyObject *tuple;
   PygtsSurface *surface;
   guint n,N;
+  gint as_arrays=FALSE;
+
+  static char *kwlist[] = {"as_arrays", NULL};
 
   SELF_CHECK
 
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &as_arrays) ) {
+    return NULL;
+  }
+  if(as_arrays) {
+#if PYGTS_HAS_NUMPY
+    return split_arrays(self);
+#else
+    PyErr_SetString(PyExc_RuntimeError,"as_arrays requires numpy");
+    return NULL;
+#endif
+  }
+
   surfaces = gts_surface_split(PYGTS_SURFACE_AS_GTS_SURFACE(self));
   
   /* Create a tuple to put the Surfaces into */
@@ -568,8 +1199,7 @@ vertices(PygtsSurface *self, PyObject *args)
   }
   v = vertices;
 
-  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			     (GtsFunc)get_vertex,&v);
+  surface_foreach_vertex(self,(GtsFunc)get_vertex,&v);
 
   /* Create a tuple to put the vertices into */
   if( (tuple=PyTuple_New(N)) == NULL) {
@@ -897,8 +1527,7 @@ face_indices(PygtsSurface *self, PyObject *args)
   data.errflag = FALSE;
 
   /* Process each face */
-  gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			   (GtsFunc)get_indices,&data);
+  surface_foreach_face(self,(GtsFunc)get_indices,&data);
   if(data.errflag) {
     Py_DECREF(data.indices);
     return NULL;
@@ -969,39 +1598,245 @@ distance(PygtsSurface *self, PyObject *args)
   }
 }
 
+/* Helpers for hausdorff().  The faces of one surface are sampled on a 
+ * regular barycentric grid with a spacing of about h, and each sample
+ * is located in the bounding-box tree of the other surface.  Faces are
+ * shared between threads; the trees are only read.
+ */
+#define HAUSDORFF_PARALLEL_MIN 1000
 
-static PyObject*
-strip(PygtsSurface *self, PyObject *args)
+/* Sets *dmax to the largest sampled distance from the faces to tree, 
+ * and returns the area-weighted mean distance.
+ */
+static gdouble
+hausdorff_sample(GPtrArray *faces, GNode *tree, gdouble h, gdouble *dmax)
 {
-  GSList *strips, *s, *f;
-  PyObject *tuple, **tuples;
-  guint i,j,n,N;
-  PygtsFace *face=NULL;
+  gdouble max=0., sum=0., area=0.;
+  gint i, N=faces->len;
+
+#pragma omp parallel reduction(max:max) reduction(+:sum,area) if(N>=HAUSDORFF_PARALLEL_MIN)
+  {
+    GtsPoint *p;
+    GtsVertex *v1, *v2, *v3;
+    GtsPoint *a, *b, *c;
+    GtsTriangle *t;
+    gdouble l, d, fsum, A;
+    guint k, u, w, n;
+
+#pragma omp critical
+    p = gts_point_new(gts_point_class(),0.,0.,0.);
+
+#pragma omp for schedule(dynamic,64)
+    for(i=0;i<N;i++) {
+      t = GTS_TRIANGLE(g_ptr_array_index(faces,i));
+      gts_triangle_vertices(t,&v1,&v2,&v3);
+      a = GTS_POINT(v1); b = GTS_POINT(v2); c = GTS_POINT(v3);
+
+      /* Subdivide the longest edge into k pieces of at most h */
+      l = MAX(gts_point_distance(a,b),
+	      MAX(gts_point_distance(b,c),gts_point_distance(c,a)));
+      k = h>0. ? (guint)ceil(l/h) : 1;
+      if(k<1) k = 1;
+
+      fsum = 0.;
+      n = 0;
+      for(u=0;u<=k;u++) {
+	for(w=0;w<=k-u;w++) {
+	  gts_point_set(p,
+			a->x + (u*(b->x-a->x) + w*(c->x-a->x))/k,
+			a->y + (u*(b->y-a->y) + w*(c->y-a->y))/k,
+			a->z + (u*(b->z-a->z) + w*(c->z-a->z))/k);
+	  d = gts_bb_tree_point_distance(tree,p,
+			   (GtsBBoxDistFunc)gts_point_triangle_distance,NULL);
+	  if(d>max) max = d;
+	  fsum += d;
+	  n++;
+	}
+      }
+      A = gts_triangle_area(t);
+      sum += A*fsum/n;
+      area += A;
+    }
 
-  SELF_CHECK
+#pragma omp critical
+    gts_object_destroy(GTS_OBJECT(p));
+  }
 
-  strips = gts_surface_strip(PYGTS_SURFACE_AS_GTS_SURFACE(self));
-  
-  /* Create tuples to put the Faces into */
-  N = g_slist_length(strips);
+  *dmax = max;
+  return area>0. ? sum/area : 0.;
+}
 
-  if( (tuple=PyTuple_New(N)) == NULL) {
-    PyErr_SetString(PyExc_MemoryError,"could not create tuple");
-    return NULL;
-  }
-  if( (tuples = (PyObject**)malloc(N*sizeof(PyObject*))) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"could not create array");
-    Py_DECREF(tuple);
+#if PYGTS_HAS_NUMPY
+/* Returns the distances from the vertices of self, in vertices() order,
+ * to tree.
+ */
+static PyObject*
+hausdorff_vertex_distances(PygtsSurface *self, GNode *tree)
+{
+  GPtrArray *vertices;
+  PyArrayObject *a;
+  npy_intp dims[1];
+  gdouble *d;
+  gint i, N;
+
+  vertices = g_ptr_array_new();
+  surface_foreach_vertex(self,(GtsFunc)gather_vertex,vertices);
+  N = dims[0] = vertices->len;
+  if( (a = (PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_DOUBLE)) 
+      == NULL ) {
+    g_ptr_array_free(vertices,TRUE);
     return NULL;
   }
-  s = strips;
+  d = (gdouble*)a->data;
+
+#pragma omp parallel for if(N>=HAUSDORFF_PARALLEL_MIN)
   for(i=0;i<N;i++) {
-    f = (GSList*)(s->data);
+    d[i] = gts_bb_tree_point_distance(tree,
+			   GTS_POINT(g_ptr_array_index(vertices,i)),
+			   (GtsBBoxDistFunc)gts_point_triangle_distance,NULL);
+  }
+
+  g_ptr_array_free(vertices,TRUE);
+  return (PyObject*)a;
+}
+#endif /* PYGTS_HAS_NUMPY */
+
+
+static PyObject*
+hausdorff(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *s_;
+  PygtsSurface *s;
+  gdouble delta=0.01, h, max1, max2, mean1, mean2;
+  gint vertex_distances=FALSE;
+  GNode *tree1, *tree2;
+  GtsBBox *b1, *b2;
+  GPtrArray *faces1, *faces2;
+#if PYGTS_HAS_NUMPY
+  PyObject *d1, *d2;
+#endif
+
+  static char *kwlist[] = {"s", "delta", "vertex_distances", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */  
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "O|di", kwlist,
+				   &s_, &delta, &vertex_distances) ) {
+    return NULL;
+  }
+
+  /* Convert to PygtsObjects */
+  if(!pygts_surface_check(s_)) {
+    PyErr_SetString(PyExc_TypeError,"expected a Surface");
+    return NULL;
+  }
+  s = PYGTS_SURFACE(s_);
+
+  if(delta<=0.) {
+    PyErr_SetString(PyExc_ValueError,"delta must be positive");
+    return NULL;
+  }
+#if !PYGTS_HAS_NUMPY
+  if(vertex_distances) {
+    PyErr_SetString(PyExc_RuntimeError,"vertex_distances requires numpy");
+    return NULL;
+  }
+#endif
+
+  if( (tree1=surface_bb_tree(self))==NULL || 
+      (tree2=surface_bb_tree(s))==NULL ) {
+    PyErr_SetString(PyExc_ValueError,"Surfaces must have faces");
+    return NULL;
+  }
+
+  /* The spacing is relative to the diagonal of both bounding boxes */
+  b1 = GTS_BBOX(tree1->data);
+  b2 = GTS_BBOX(tree2->data);
+  h = delta*sqrt(pow(MAX(b1->x2,b2->x2)-MIN(b1->x1,b2->x1),2) +
+		 pow(MAX(b1->y2,b2->y2)-MIN(b1->y1,b2->y1),2) +
+		 pow(MAX(b1->z2,b2->z2)-MIN(b1->z1,b2->z1),2));
+
+  faces1 = g_ptr_array_new();
+  gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			   (GtsFunc)gather_face,faces1);
+  faces2 = g_ptr_array_new();
+  gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(s),
+			   (GtsFunc)gather_face,faces2);
+
+  mean1 = hausdorff_sample(faces1,tree2,h,&max1);
+  mean2 = hausdorff_sample(faces2,tree1,h,&max2);
+
+  g_ptr_array_free(faces1,TRUE);
+  g_ptr_array_free(faces2,TRUE);
+
+  if(!vertex_distances) {
+    return Py_BuildValue("dd",MAX(max1,max2),(mean1+mean2)/2.);
+  }
+
+#if PYGTS_HAS_NUMPY
+  if( (d1=hausdorff_vertex_distances(self,tree2)) == NULL ) {
+    return NULL;
+  }
+  if( (d2=hausdorff_vertex_distances(s,tree1)) == NULL ) {
+    Py_DECREF(d1);
+    return NULL;
+  }
+  return Py_BuildValue("ddNN",MAX(max1,max2),(mean1+mean2)/2.,d1,d2);
+#else
+  return NULL;
+#endif
+}
+
+
+/* Frees the list of strips from gts_surface_strip() */
+static void
+strips_free(GSList *strips)
+{
+  GSList *s;
+
+  for(s=strips;s!=NULL;s=g_slist_next(s)) {
+    g_slist_free((GSList*)s->data);
+  }
+  g_slist_free(strips);
+}
+
+
+static PyObject*
+strip(PygtsSurface *self, PyObject *args)
+{
+  GSList *strips, *s, *f;
+  PyObject *tuple, **tuples;
+  guint i,j,n,N;
+  PygtsFace *face=NULL;
+
+  SELF_CHECK
+
+  strips = gts_surface_strip(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+  
+  /* Create tuples to put the Faces into */
+  N = g_slist_length(strips);
+
+  if( (tuple=PyTuple_New(N)) == NULL) {
+    PyErr_SetString(PyExc_MemoryError,"could not create tuple");
+    strips_free(strips);
+    return NULL;
+  }
+  if( (tuples = (PyObject**)malloc(N*sizeof(PyObject*))) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create array");
+    Py_DECREF(tuple);
+    strips_free(strips);
+    return NULL;
+  }
+  s = strips;
+  for(i=0;i<N;i++) {
+    f = (GSList*)(s->data);
     n = g_slist_length(f);
     if( (tuples[i]=PyTuple_New(n)) == NULL) {
       PyErr_SetString(PyExc_MemoryError,"could not create tuple");
       Py_DECREF(tuple);
       free(tuples);
+      strips_free(strips);
       return NULL;
     }
     PyTuple_SET_ITEM(tuple, i, tuples[i]);
@@ -1015,6 +1850,10 @@ strip(PygtsSurface *self, PyObject *args)
     n = g_slist_length(f);
     for(j=0;j<n;j++) {
       if( (face = pygts_face_new(GTS_FACE(f->data))) == NULL ) {
+	Py_DECREF(tuple);
+	free(tuples);
+	strips_free(strips);
+	return NULL;
       }
       PyTuple_SET_ITEM(tuples[i], j, (PyObject*)face);
       f = g_slist_next(f);
@@ -1023,81 +1862,81 @@ strip(PygtsSurface *self, PyObject *args)
   }
 
   free(tuples);
+  strips_free(strips);
 
   return tuple;
 }
 
 
+/* Sets d[key] to v, stealing the reference to v */
+static gint
+dict_set(PyObject *d, char *key, PyObject *v)
+{
+  gint ret;
+
+  if( v == NULL ) return -1;
+  ret = PyDict_SetItemString(d,key,v);
+  Py_DECREF(v);
+  return ret;
+}
+
+
+/* Returns a dict for the GtsRange r */
+static PyObject*
+range_dict(GtsRange *r)
+{
+  PyObject *dict;
+
+  if( (dict = PyDict_New()) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
+    return NULL;
+  }
+
+  if( dict_set(dict,"min",PyFloat_FromDouble(r->min))==-1 ||
+      dict_set(dict,"max",PyFloat_FromDouble(r->max))==-1 ||
+      dict_set(dict,"sum",PyFloat_FromDouble(r->sum))==-1 ||
+      dict_set(dict,"sum2",PyFloat_FromDouble(r->sum2))==-1 ||
+      dict_set(dict,"mean",PyFloat_FromDouble(r->mean))==-1 ||
+      dict_set(dict,"stddev",PyFloat_FromDouble(r->stddev))==-1 ||
+      dict_set(dict,"n",PyInt_FromLong(r->n))==-1 ) {
+    Py_DECREF(dict);
+    return NULL;
+  }
+
+  return dict;
+}
+
+
 static PyObject*
 stats(PygtsSurface *self, PyObject *args)
 {
   GtsSurfaceStats stats;
-  PyObject *dict, *edges_per_vertex, *faces_per_edge;
+  PyObject *dict;
 
   SELF_CHECK
 
   /* Make the call */
   gts_surface_stats(PYGTS_SURFACE_AS_GTS_SURFACE(self),&stats);
 
-  /* Create the dictionaries */
+  /* Create and populate the dict */
   if( (dict = PyDict_New()) == NULL ) {
     PyErr_SetString(PyExc_MemoryError,"cannot create dict");
     return NULL;
   }
-  if( (edges_per_vertex = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
+  if( dict_set(dict,"n_faces",PyInt_FromLong(stats.n_faces))==-1 ||
+      dict_set(dict,"n_incompatible_faces",
+	       PyInt_FromLong(stats.n_incompatible_faces))==-1 ||
+      dict_set(dict,"n_boundary_edges",
+	       PyInt_FromLong(stats.n_boundary_edges))==-1 ||
+      dict_set(dict,"n_non_manifold_edges",
+	       PyInt_FromLong(stats.n_non_manifold_edges))==-1 ||
+      dict_set(dict,"edges_per_vertex",
+	       range_dict(&(stats.edges_per_vertex)))==-1 ||
+      dict_set(dict,"faces_per_edge",
+	       range_dict(&(stats.faces_per_edge)))==-1 ) {
     Py_DECREF(dict);
     return NULL;
   }
-  if( (faces_per_edge = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
-    Py_DECREF(dict);
-    Py_DECREF(edges_per_vertex);
-    return NULL;
-  }
-
-  /* Populate the edges_per_vertex dict */
-  PyDict_SetItemString(edges_per_vertex,"min", 
-		       Py_BuildValue("d",stats.edges_per_vertex.min));
-  PyDict_SetItemString(edges_per_vertex,"max", 
-		       Py_BuildValue("d",stats.edges_per_vertex.max));
-  PyDict_SetItemString(edges_per_vertex,"sum", 
-		       Py_BuildValue("d",stats.edges_per_vertex.sum));
-  PyDict_SetItemString(edges_per_vertex,"sum2", 
-		       Py_BuildValue("d",stats.edges_per_vertex.sum2));
-  PyDict_SetItemString(edges_per_vertex,"mean", 
-		       Py_BuildValue("d",stats.edges_per_vertex.mean));
-  PyDict_SetItemString(edges_per_vertex,"stddev", 
-		       Py_BuildValue("d",stats.edges_per_vertex.stddev));
-  PyDict_SetItemString(edges_per_vertex,"n", 
-		       Py_BuildValue("i",stats.edges_per_vertex.n));
-
-  /* Populate the faces_per_edge dict */
-  PyDict_SetItemString(faces_per_edge,"min", 
-		       Py_BuildValue("d",stats.faces_per_edge.min));
-  PyDict_SetItemString(faces_per_edge,"max", 
-		       Py_BuildValue("d",stats.faces_per_edge.max));
-  PyDict_SetItemString(faces_per_edge,"sum", 
-		       Py_BuildValue("d",stats.faces_per_edge.sum));
-  PyDict_SetItemString(faces_per_edge,"sum2", 
-		       Py_BuildValue("d",stats.faces_per_edge.sum2));
-  PyDict_SetItemString(faces_per_edge,"mean", 
-		       Py_BuildValue("d",stats.faces_per_edge.mean));
-  PyDict_SetItemString(faces_per_edge,"stddev", 
-		       Py_BuildValue("d",stats.faces_per_edge.stddev));
-  PyDict_SetItemString(faces_per_edge,"n", 
-		       Py_BuildValue("i",stats.faces_per_edge.n));
-
-  /* Populate the main dict */
-  PyDict_SetItemString(dict,"n_faces", Py_BuildValue("i",stats.n_faces));
-  PyDict_SetItemString(dict,"n_incompatible_faces", 
-		       Py_BuildValue("i",stats.n_incompatible_faces));
-  PyDict_SetItemString(dict,"n_boundary_edges", 
-		       Py_BuildValue("i",stats.n_boundary_edges));
-  PyDict_SetItemString(dict,"n_non_manifold_edges", 
-		       Py_BuildValue("i",stats.n_non_manifold_edges));
-  PyDict_SetItemString(dict,"edges_per_vertex", edges_per_vertex);
-  PyDict_SetItemString(dict,"faces_per_edge", faces_per_edge);
 
   return dict;
 }
@@ -1107,516 +1946,3526 @@ static PyObject*
 quality_stats(PygtsSurface *self, PyObject *args)
 {
   GtsSurfaceQualityStats stats;
-  PyObject *dict, *face_quality, *face_area, *edge_length, *edge_angle;
+  PyObject *dict;
 
   SELF_CHECK
 
   /* Make the call */
   gts_surface_quality_stats(PYGTS_SURFACE_AS_GTS_SURFACE(self),&stats);
 
-  /* Create the dictionaries */
+  /* Create and populate the dict */
   if( (dict = PyDict_New()) == NULL ) {
     PyErr_SetString(PyExc_MemoryError,"cannot create dict");
     return NULL;
   }
-  if( (face_quality = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
-    Py_DECREF(dict);
-    return NULL;
-  }
-  if( (face_area = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
-    Py_DECREF(dict);
-    Py_DECREF(face_quality);
-    return NULL;
-  }
-  if( (edge_length = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
+  if( dict_set(dict,"face_quality",range_dict(&(stats.face_quality)))==-1 ||
+      dict_set(dict,"face_area",range_dict(&(stats.face_area)))==-1 ||
+      dict_set(dict,"edge_length",range_dict(&(stats.edge_length)))==-1 ||
+      dict_set(dict,"edge_angle",range_dict(&(stats.edge_angle)))==-1 ) {
     Py_DECREF(dict);
-    Py_DECREF(face_quality);
-    Py_DECREF(face_area);
     return NULL;
   }
-  if( (edge_angle = PyDict_New()) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"cannot create dict");
-    Py_DECREF(dict);
-    Py_DECREF(face_quality);
-    Py_DECREF(face_area);
-    Py_DECREF(edge_length);
-    return NULL;
-  }
-
-  /* Populate the face_quality dict */
-  PyDict_SetItemString(face_quality,"min", 
-		       Py_BuildValue("d",stats.face_quality.min));
-  PyDict_SetItemString(face_quality,"max", 
-		       Py_BuildValue("d",stats.face_quality.max));
-  PyDict_SetItemString(face_quality,"sum", 
-		       Py_BuildValue("d",stats.face_quality.sum));
-  PyDict_SetItemString(face_quality,"sum2", 
-		       Py_BuildValue("d",stats.face_quality.sum2));
-  PyDict_SetItemString(face_quality,"mean", 
-		       Py_BuildValue("d",stats.face_quality.mean));
-  PyDict_SetItemString(face_quality,"stddev", 
-		       Py_BuildValue("d",stats.face_quality.stddev));
-  PyDict_SetItemString(face_quality,"n", 
-		       Py_BuildValue("i",stats.face_quality.n));
-
-  /* Populate the face_area dict */
-  PyDict_SetItemString(face_area,"min", 
-		       Py_BuildValue("d",stats.face_area.min));
-  PyDict_SetItemString(face_area,"max", 
-		       Py_BuildValue("d",stats.face_area.max));
-  PyDict_SetItemString(face_area,"sum", 
-		       Py_BuildValue("d",stats.face_area.sum));
-  PyDict_SetItemString(face_area,"sum2", 
-		       Py_BuildValue("d",stats.face_area.sum2));
-  PyDict_SetItemString(face_area,"mean", 
-		       Py_BuildValue("d",stats.face_area.mean));
-  PyDict_SetItemString(face_area,"stddev", 
-		       Py_BuildValue("d",stats.face_area.stddev));
-  PyDict_SetItemString(face_area,"n", 
-		       Py_BuildValue("i",stats.face_area.n));
-
-  /* Populate the edge_length dict */
-  PyDict_SetItemString(edge_length,"min", 
-		       Py_BuildValue("d",stats.edge_length.min));
-  PyDict_SetItemString(edge_length,"max", 
-		       Py_BuildValue("d",stats.edge_length.max));
-  PyDict_SetItemString(edge_length,"sum", 
-		       Py_BuildValue("d",stats.edge_length.sum));
-  PyDict_SetItemString(edge_length,"sum2", 
-		       Py_BuildValue("d",stats.edge_length.sum2));
-  PyDict_SetItemString(edge_length,"mean", 
-		       Py_BuildValue("d",stats.edge_length.mean));
-  PyDict_SetItemString(edge_length,"stddev", 
-		       Py_BuildValue("d",stats.edge_length.stddev));
-  PyDict_SetItemString(edge_length,"n", 
-		       Py_BuildValue("i",stats.edge_length.n));
-
-  /* Populate the edge_angle dict */
-  PyDict_SetItemString(edge_angle,"min", 
-		       Py_BuildValue("d",stats.edge_angle.min));
-  PyDict_SetItemString(edge_angle,"max", 
-		       Py_BuildValue("d",stats.edge_angle.max));
-  PyDict_SetItemString(edge_angle,"sum", 
-		       Py_BuildValue("d",stats.edge_angle.sum));
-  PyDict_SetItemString(edge_angle,"sum2", 
-		       Py_BuildValue("d",stats.edge_angle.sum2));
-  PyDict_SetItemString(edge_angle,"mean", 
-		       Py_BuildValue("d",stats.edge_angle.mean));
-  PyDict_SetItemString(edge_angle,"stddev", 
-		       Py_BuildValue("d",stats.edge_angle.stddev));
-  PyDict_SetItemString(edge_angle,"n", 
-		       Py_BuildValue("i",stats.edge_angle.n));
-
-  /* Populate the main dict */
-  PyDict_SetItemString(dict,"face_quality", face_quality);
-  PyDict_SetItemString(dict,"face_area", face_area);
-  PyDict_SetItemString(dict,"edge_length", edge_length);
-  PyDict_SetItemString(dict,"edge_angle", edge_angle);
 
   return dict;
 }
 
 
-static PyObject*
-tessellate(PygtsSurface *self, PyObject *args)
-{
-  SELF_CHECK
+/* Helpers for metrics().  The statistics are gathered in one pass over
+ * the faces.  Each edge is handled through the first of its faces that
+ * is on the Surface, which visits every edge once without a hash table.
+ */
+#define METRICS_AREA           (1<<0)
+#define METRICS_VOLUME         (1<<1)
+#define METRICS_BOUNDARY       (1<<2)
+#define METRICS_INCOMPATIBLE   (1<<3)
+#define METRICS_FACES_PER_EDGE (1<<4)
+#define METRICS_FACE_QUALITY   (1<<5)
+#define METRICS_FACE_AREA      (1<<6)
+#define METRICS_EDGE_LENGTH    (1<<7)
+#define METRICS_EDGE_ANGLE     (1<<8)
+#define METRICS_EDGES_PER_VERTEX (1<<9)
+
+/* Names of the metrics that may be selected, in the order of the flags */
+static char *metrics_names[] = {"area", "volume", "boundary", 
+				"incompatible", "faces_per_edge",
+				"face_quality", "face_area", "edge_length", 
+				"edge_angle", "edges_per_vertex", NULL};
+
+/* Metrics with ranges, which index the values arrays */
+enum { METRICS_RANGE_FACE_QUALITY, METRICS_RANGE_FACE_AREA, 
+       METRICS_RANGE_EDGE_LENGTH, METRICS_RANGE_EDGE_ANGLE,
+       METRICS_NRANGES };
 
-  gts_surface_tessellate(PYGTS_SURFACE_AS_GTS_SURFACE(self),NULL,NULL);
+typedef struct {
+  GtsSurface *s;
+  guint which;
+  guint n_faces, n_edges, n_boundary_edges, n_non_manifold_edges,
+    n_incompatible_faces;
+  gdouble area, volume;
+  GtsRange faces_per_edge, edges_per_vertex;
+  GtsRange ranges[METRICS_NRANGES];
+  GArray *values[METRICS_NRANGES];  /* For histograms, if wanted */
+} MetricsData;
 
-  Py_INCREF(Py_None);
-  return Py_None;
+
+static void
+metrics_add(MetricsData *data, guint i, gdouble value)
+{
+  gts_range_add_value(&(data->ranges[i]),value);
+  if( data->values[i] != NULL ) {
+    g_array_append_val(data->values[i],value);
+  }
 }
 
 
-/* Helper function for inter() */
-void
-get_largest_coord(GtsVertex *v,gdouble *val) {
-  if( fabs(GTS_POINT(v)->x) > *val ) *val = fabs(GTS_POINT(v)->x);
-  if( fabs(GTS_POINT(v)->y) > *val ) *val = fabs(GTS_POINT(v)->y);
-  if( fabs(GTS_POINT(v)->z) > *val ) *val = fabs(GTS_POINT(v)->z);
+static void
+metrics_edge(GtsEdge *e, GtsFace *f, MetricsData *data)
+{
+  GSList *i;
+  GtsFace *f1=NULL, *f2=NULL;
+  guint n=0;
+  GtsPoint *p1, *p2;
+
+  /* Find the faces of e on the surface */
+  for(i=e->triangles; i!=NULL; i=g_slist_next(i)) {
+    if( GTS_IS_FACE(i->data) && 
+	gts_face_has_parent_surface(GTS_FACE(i->data),data->s) ) {
+      if(n==0) f1 = GTS_FACE(i->data);
+      else if(n==1) f2 = GTS_FACE(i->data);
+      n++;
+    }
+  }
+  if( f1 != f ) return; /* e was or will be handled with f1 */
+
+  data->n_edges++;
+  if( n==1 ) data->n_boundary_edges++;
+  if( n>2 ) data->n_non_manifold_edges++;
+  if( data->which & METRICS_FACES_PER_EDGE ) {
+    gts_range_add_value(&(data->faces_per_edge),n);
+  }
+  if( data->which & METRICS_EDGE_LENGTH ) {
+    p1 = GTS_POINT(GTS_SEGMENT(e)->v1);
+    p2 = GTS_POINT(GTS_SEGMENT(e)->v2);
+    metrics_add(data,METRICS_RANGE_EDGE_LENGTH,gts_point_distance(p1,p2));
+  }
+  if( (data->which & METRICS_EDGE_ANGLE) && n==2 ) {
+    metrics_add(data,METRICS_RANGE_EDGE_ANGLE,
+		gts_triangles_angle(GTS_TRIANGLE(f1),GTS_TRIANGLE(f2)));
+  }
 }
 
-/* Helper function for intersection operations */
-static PyObject*
-inter(PygtsSurface *self, PyObject *args, GtsBooleanOperation op1,
-      GtsBooleanOperation op2)
+
+/* As for the edges, each vertex is handled with the first of its faces */
+static void
+metrics_vertex(GtsVertex *v, GtsFace *f, MetricsData *data)
 {
-  PyObject *obj;
-  PyObject *s_;
-  PygtsSurface *s;
-  GtsSurface *surface;
-  GtsVector cm1, cm2;
-  gdouble area1, area2;
-  GtsSurfaceInter *si;
-  GNode *tree1, *tree2;
-  gboolean is_open1, is_open2, closed;
-  gdouble eps=0.;
+  GSList *i, *j;
+  GtsFace *f1=NULL;
+  guint n=0;
+  gboolean on_surface;
+
+  for(i=v->segments; i!=NULL; i=g_slist_next(i)) {
+    if( !GTS_IS_EDGE(i->data) ) continue;
+    on_surface = FALSE;
+    for(j=GTS_EDGE(i->data)->triangles; j!=NULL; j=g_slist_next(j)) {
+      if( GTS_IS_FACE(j->data) && 
+	  gts_face_has_parent_surface(GTS_FACE(j->data),data->s) ) {
+	if( f1==NULL ) f1 = GTS_FACE(j->data);
+	on_surface = TRUE;
+      }
+    }
+    if( on_surface ) n++;
+  }
+  if( f1 != f ) return;
 
-  /* Parse the args */  
-  if(! PyArg_ParseTuple(args, "O", &s_) )
-    return NULL;
+  gts_range_add_value(&(data->edges_per_vertex),n);
+}
 
-  /* Convert to PygtsObjects */
-  if(!pygts_surface_check(s_)) {
-    PyErr_SetString(PyExc_TypeError,"expected a Surface");
-    return NULL;
+
+static void
+metrics_face(GtsFace *f, MetricsData *data)
+{
+  GtsTriangle *t = GTS_TRIANGLE(f);
+  GtsVertex *v1, *v2, *v3;
+  GtsPoint *a, *b, *c;
+  gdouble area=0.;
+
+  data->n_faces++;
+
+  if( data->which & (METRICS_AREA|METRICS_FACE_AREA) ) {
+    area = gts_triangle_area(t);
+    data->area += area;
+    if( data->which & METRICS_FACE_AREA ) {
+      metrics_add(data,METRICS_RANGE_FACE_AREA,area);
+    }
+  }
+  if( data->which & METRICS_FACE_QUALITY ) {
+    metrics_add(data,METRICS_RANGE_FACE_QUALITY,gts_triangle_quality(t));
+  }
+  if( data->which & METRICS_VOLUME ) {
+    /* As for gts_surface_volume() */
+    gts_triangle_vertices(t,&v1,&v2,&v3);
+    a = GTS_POINT(v1); b = GTS_POINT(v2); c = GTS_POINT(v3);
+    data->volume += a->x*(b->y*c->z - b->z*c->y) +
+      b->x*(c->y*a->z - c->z*a->y) + c->x*(a->y*b->z - a->z*b->y);
+  }
+  if( (data->which & METRICS_INCOMPATIBLE) && 
+      !gts_face_is_compatible(f,data->s) ) {
+    data->n_incompatible_faces++;
   }
-  s = PYGTS_SURFACE(s_);
 
-  /* Make sure that we don't have two pointers to the same surface */
-  if( self == s ) {
-      PyErr_SetString(PyExc_RuntimeError,
-		      "can't determine intersection with self");
-      return NULL;
+  metrics_edge(t->e1,f,data);
+  metrics_edge(t->e2,f,data);
+  metrics_edge(t->e3,f,data);
+
+  if( data->which & METRICS_EDGES_PER_VERTEX ) {
+    gts_triangle_vertices(t,&v1,&v2,&v3);
+    metrics_vertex(v1,f,data);
+    metrics_vertex(v2,f,data);
+    metrics_vertex(v3,f,data);
   }
+}
 
 
-  /* *** ATTENTION ***
-   * Eliminate any active gts traverse objects.  They appear to interfere
-   * with the intersection calculation.  I would guess that this is due
-   * to the use of the "reserved" field (i.e., it doesn't get properly
-   * reset until the traverse is destroyed).
-   *
-   * I don't expect this to cause problems here, but a bug report should be
-   * filed.
-   */
-  if(self->traverse!=NULL) {
-    gts_surface_traverse_destroy(self->traverse);
-    self->traverse = NULL;
+/* Returns a Range for r, with a histogram of values over nbins bins */
+static PyObject*
+metrics_range(GtsRange *r, GArray *values, guint nbins)
+{
+  PyObject *range, *histogram;
+  guint *counts, i, k;
+  gdouble value;
+
+  if( (range = PyStructSequence_New(&PygtsRangeType)) == NULL ) {
+    return NULL;
   }
-  if(s->traverse!=NULL) {
-    gts_surface_traverse_destroy(s->traverse);
-    s->traverse = NULL;
+  PyStructSequence_SET_ITEM(range,0,PyFloat_FromDouble(r->min));
+  PyStructSequence_SET_ITEM(range,1,PyFloat_FromDouble(r->max));
+  PyStructSequence_SET_ITEM(range,2,PyFloat_FromDouble(r->sum));
+  PyStructSequence_SET_ITEM(range,3,PyFloat_FromDouble(r->sum2));
+  PyStructSequence_SET_ITEM(range,4,PyFloat_FromDouble(r->mean));
+  PyStructSequence_SET_ITEM(range,5,PyFloat_FromDouble(r->stddev));
+  PyStructSequence_SET_ITEM(range,6,PyInt_FromLong(r->n));
+  PyStructSequence_SET_ITEM(range,7,NULL);
+
+  if( values == NULL ) {
+    Py_INCREF(Py_None);
+    PyStructSequence_SET_ITEM(range,7,Py_None);
+    return range;
   }
-  /* *** ATTENTION *** */
 
-  /* Check for self-intersections in either surface */
-  if( gts_surface_is_self_intersecting(PYGTS_SURFACE_AS_GTS_SURFACE(self))
-      != NULL ) {
-    PyErr_SetString(PyExc_RuntimeError,"Surface is self-intersecting");
-    return NULL;
+  /* Bin the values between min and max; max goes in the last bin */
+  counts = g_new0(guint,nbins);
+  for(i=0;i<values->len;i++) {
+    value = g_array_index(values,gdouble,i);
+    k = r->max>r->min ? (guint)((value-r->min)/(r->max-r->min)*nbins) : 0;
+    counts[k<nbins ? k : nbins-1]++;
   }
-  if( gts_surface_is_self_intersecting(PYGTS_SURFACE_AS_GTS_SURFACE(s))
-      != NULL ) {
-    PyErr_SetString(PyExc_RuntimeError,"Surface is self-intersecting");
+  if( (histogram = PyTuple_New(nbins)) == NULL ) {
+    g_free(counts);
+    Py_DECREF(range);
     return NULL;
   }
+  for(i=0;i<nbins;i++) {
+    PyTuple_SET_ITEM(histogram,i,PyInt_FromLong(counts[i]));
+  }
+  g_free(counts);
+  PyStructSequence_SET_ITEM(range,7,histogram);
 
-  /* Avoid complete self-intersection of two surfaces*/
-  if( (gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
-      gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
-      (gts_surface_edge_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
-       gts_surface_edge_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
-      (gts_surface_vertex_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
-       gts_surface_vertex_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
-      (gts_surface_area(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
-       gts_surface_area(PYGTS_SURFACE_AS_GTS_SURFACE(s))) ) {
+  return range;
+}
 
-    area1 = \
-      gts_surface_center_of_area(PYGTS_SURFACE_AS_GTS_SURFACE(self),cm1);
 
-    area2 = \
-      gts_surface_center_of_area(PYGTS_SURFACE_AS_GTS_SURFACE(s),cm2);
+static PyObject*
+metrics(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *which_=NULL, *o, *ret, *item;
+  MetricsData data;
+  gint bins=0;
+  guint i, j, N;
+  char *name;
+  gboolean failed=FALSE;
 
-    if( (area1==area2) && (cm1[0]==cm2[0]) && (cm1[1]==cm2[1]) && 
-	(cm1[2]==cm2[2]) ) {
-      PyErr_SetString(PyExc_RuntimeError,"Surfaces mutually intersect");
-      return NULL;
-    }
-  }
+  static char *kwlist[] = {"which", "bins", NULL};
 
-  /* Get bounding boxes */
-  if( (tree1=gts_bb_tree_surface(PYGTS_SURFACE_AS_GTS_SURFACE(self)))
-      ==NULL ) {
-    PyErr_SetString(PyExc_MemoryError,"could not create tree");
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|Oi", kwlist,
+				   &which_, &bins) ) {
     return NULL;
   }
-  is_open1 = !gts_surface_is_closed(PYGTS_SURFACE_AS_GTS_SURFACE(self));
-  if( (tree2=gts_bb_tree_surface(PYGTS_SURFACE_AS_GTS_SURFACE(s)))
-      ==NULL ) {
-    gts_bb_tree_destroy(tree1, TRUE);
-    PyErr_SetString(PyExc_MemoryError,"could not create tree");
+  if( bins<0 ) {
+    PyErr_SetString(PyExc_ValueError,"bins must not be negative");
     return NULL;
   }
-  is_open2 = !gts_surface_is_closed(PYGTS_SURFACE_AS_GTS_SURFACE(s));
 
-  /* Get the surface intersection object */
-  if( (si = gts_surface_inter_new(gts_surface_inter_class(),
-				  PYGTS_SURFACE_AS_GTS_SURFACE(self),
-				  PYGTS_SURFACE_AS_GTS_SURFACE(s),
-				  tree1, tree2, is_open1, is_open2))==NULL) {
-    gts_bb_tree_destroy(tree1, TRUE);
-    gts_bb_tree_destroy(tree2, TRUE);
-    PyErr_SetString(PyExc_RuntimeError,"could not create GtsSurfaceInter");
-    return NULL;
+  /* Select the metrics */
+  if( which_ == NULL || which_ == Py_None ) {
+    data.which = ~0;
   }
-  gts_bb_tree_destroy(tree1, TRUE);
-  gts_bb_tree_destroy(tree2, TRUE);
-
-  /* Check that the surface intersection object is closed  */
-  gts_surface_inter_check(si,&closed);
-  if( closed == FALSE ) {
-    gts_object_destroy(GTS_OBJECT(si));
+  else {
+    if( !PySequence_Check(which_) || PyString_Check(which_) ) {
+      PyErr_SetString(PyExc_TypeError,"expected a sequence of metric names");
+      return NULL;
+    }
+    data.which = 0;
+    N = PySequence_Size(which_);
+    for(i=0;i<N;i++) {
+      if( (o = PySequence_GetItem(which_,i)) == NULL ) return NULL;
+      if( !PyString_Check(o) ) {
+	Py_DECREF(o);
+	PyErr_SetString(PyExc_TypeError,"expected a sequence of metric names");
+	return NULL;
+      }
+      name = PyString_AsString(o);
+      for(j=0; metrics_names[j]!=NULL; j++) {
+	if( strcmp(name,metrics_names[j])==0 ) break;
+      }
+      if( metrics_names[j]==NULL ) {
+	PyErr_Format(PyExc_ValueError,"unknown metric '%s'",name);
+	Py_DECREF(o);
+	return NULL;
+      }
+      Py_DECREF(o);
+      data.which |= 1<<j;
+    }
+  }
+
+  /* Gather the metrics in one pass */
+  data.s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+  data.n_faces = data.n_edges = 0;
+  data.n_boundary_edges = data.n_non_manifold_edges = 0;
+  data.n_incompatible_faces = 0;
+  data.area = data.volume = 0.;
+  gts_range_init(&(data.faces_per_edge));
+  gts_range_init(&(data.edges_per_vertex));
+  for(i=0;i<METRICS_NRANGES;i++) {
+    gts_range_init(&(data.ranges[i]));
+    data.values[i] = NULL;
+    if( bins>0 && (data.which & (METRICS_FACE_QUALITY<<i)) ) {
+      data.values[i] = g_array_new(FALSE,FALSE,sizeof(gdouble));
+    }
+  }
+  gts_surface_foreach_face(data.s,(GtsFunc)metrics_face,&data);
+  gts_range_update(&(data.faces_per_edge));
+  gts_range_update(&(data.edges_per_vertex));
+  for(i=0;i<METRICS_NRANGES;i++) {
+    gts_range_update(&(data.ranges[i]));
+  }
+
+  /* Assemble the Metrics */
+  if( (ret = PyStructSequence_New(&PygtsMetricsType)) == NULL ) {
+    for(i=0;i<METRICS_NRANGES;i++) {
+      if( data.values[i]!=NULL ) g_array_free(data.values[i],TRUE);
+    }
+    return NULL;
+  }
+#define METRICS_SET(k,flag,value) \
+  if( data.which & (flag) ) { item = (value); }                 \
+  else { Py_INCREF(Py_None); item = Py_None; }                  \
+  if( item == NULL ) failed = TRUE;                             \
+  PyStructSequence_SET_ITEM(ret,k,item);
+
+  METRICS_SET(0,~0,PyInt_FromLong(data.n_faces));
+  METRICS_SET(1,~0,PyInt_FromLong(data.n_edges));
+  METRICS_SET(2,METRICS_AREA,PyFloat_FromDouble(data.area));
+  METRICS_SET(3,METRICS_VOLUME,PyFloat_FromDouble(data.volume/6.));
+  METRICS_SET(4,METRICS_BOUNDARY,PyInt_FromLong(data.n_boundary_edges));
+  METRICS_SET(5,METRICS_BOUNDARY,PyInt_FromLong(data.n_non_manifold_edges));
+  METRICS_SET(6,METRICS_INCOMPATIBLE,
+	      PyInt_FromLong(data.n_incompatible_faces));
+  METRICS_SET(7,METRICS_FACES_PER_EDGE,
+	      metrics_range(&(data.faces_per_edge),NULL,0));
+  METRICS_SET(8,METRICS_EDGES_PER_VERTEX,
+	      metrics_range(&(data.edges_per_vertex),NULL,0));
+  for(i=0;i<METRICS_NRANGES;i++) {
+    METRICS_SET(9+i,METRICS_FACE_QUALITY<<i,
+		metrics_range(&(data.ranges[i]),data.values[i],bins));
+  }
+
+#undef METRICS_SET
+
+  for(i=0;i<METRICS_NRANGES;i++) {
+    if( data.values[i]!=NULL ) g_array_free(data.values[i],TRUE);
+  }
+
+  if( failed ) {
+    Py_DECREF(ret);
+    return NULL;
+  }
+
+  return ret;
+}
+
+
+/* Struct sequence types returned by metrics() */
+static PyStructSequence_Field range_fields[] = {
+  {"min", "minimum value"},
+  {"max", "maximum value"},
+  {"sum", "sum of the values"},
+  {"sum2", "sum of the squared values"},
+  {"mean", "mean value"},
+  {"stddev", "standard deviation"},
+  {"n", "number of values"},
+  {"histogram", "counts in equal bins from min to max, or None"},
+  {NULL}
+};
+
+PyStructSequence_Desc pygts_range_desc = {
+  "gts.Range",
+  "Statistics for a set of values.",
+  range_fields,
+  8
+};
+
+PyTypeObject PygtsRangeType;
+
+static PyStructSequence_Field metrics_fields[] = {
+  {"n_faces", "number of faces"},
+  {"n_edges", "number of edges"},
+  {"area", "total area"},
+  {"volume", "signed volume; meaningful for closed, orientable surfaces"},
+  {"n_boundary_edges", "number of edges with one face"},
+  {"n_non_manifold_edges", "number of edges with more than two faces"},
+  {"n_incompatible_faces", "number of faces incompatible with a neighbor"},
+  {"faces_per_edge", "Range of the number of faces per edge"},
+  {"edges_per_vertex", "Range of the number of edges per vertex"},
+  {"face_quality", "Range of the face qualities"},
+  {"face_area", "Range of the face areas"},
+  {"edge_length", "Range of the edge lengths"},
+  {"edge_angle", "Range of the angles between the faces of each edge"},
+  {NULL}
+};
+
+PyStructSequence_Desc pygts_metrics_desc = {
+  "gts.Metrics",
+  "Metrics for a Surface.",
+  metrics_fields,
+  13
+};
+
+PyTypeObject PygtsMetricsType;
+
+
+/* Helpers for the per-element arrays.  The corner coordinates of the 
+ * faces (or edges) are gathered into a contiguous array in a single 
+ * traversal, and the values are then computed in tight loops over that
+ * array.  The loops are shared between threads for large surfaces.
+ */
+#define ARRAYS_PARALLEL_MIN 10000
+
+typedef struct {
+  gdouble *p;           /* Corner coordinates; 9 per face or 6 per edge */
+  gint *indices;        /* Vertex indices, 3 per face, or NULL */
+  GHashTable *vertices; /* Maps vertices to their index+1 */
+  gint n;               /* Number of elements gathered */
+} ElementCoords;
+
+
+/* Helper for face_coords_gather(); indexes vertices as vertices() does */
+static void
+index_vertex(GtsVertex *v, GHashTable *vertices)
+{
+  g_hash_table_insert(vertices,v,
+		      GUINT_TO_POINTER(g_hash_table_size(vertices)+1));
+}
+
+static void
+gather_face_coords(GtsFace *f, ElementCoords *data)
+{
+  GtsVertex *v[3];
+  GtsPoint *p;
+  gdouble *c = data->p + 9*data->n;
+  guint i;
+
+  gts_triangle_vertices(GTS_TRIANGLE(f),&v[0],&v[1],&v[2]);
+  for(i=0;i<3;i++) {
+    p = GTS_POINT(v[i]);
+    c[3*i] = p->x; c[3*i+1] = p->y; c[3*i+2] = p->z;
+    if(data->indices) {
+      data->indices[3*data->n+i] = 
+	GPOINTER_TO_UINT(g_hash_table_lookup(data->vertices,v[i])) - 1;
+    }
+  }
+  data->n++;
+}
+
+
+/* Gathers the corner coordinates of the faces of self in the order of 
+ * face_indices().  If indices is TRUE, the vertex indices (for the order
+ * of vertices()) are gathered too.  Returns the number of faces, or -1 with an exception 
+ * set.
+ */
+static gint
+face_coords_gather(PygtsSurface *self, ElementCoords *data, gboolean indices)
+{
+  guint N = gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+
+  data->n = 0;
+  data->indices = NULL;
+  data->vertices = NULL;
+  if( (data->p = g_try_new(gdouble,9*N+1)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not allocate coordinates");
+    return -1;
+  }
+  if(indices) {
+    if( (data->indices = g_try_new(gint,3*N+1)) == NULL ) {
+      g_free(data->p);
+      PyErr_SetString(PyExc_MemoryError,"could not allocate indices");
+      return -1;
+    }
+    data->vertices = g_hash_table_new(NULL,NULL);
+    surface_foreach_vertex(self,(GtsFunc)index_vertex,data->vertices);
+  }
+  surface_foreach_face(self,(GtsFunc)gather_face_coords,data);
+  return data->n;
+}
+
+
+static void
+element_coords_free(ElementCoords *data)
+{
+  g_free(data->p);
+  g_free(data->indices);
+  if(data->vertices) g_hash_table_destroy(data->vertices);
+}
+
+
+#if PYGTS_HAS_NUMPY
+
+/* Gathers the end coordinates of the edges of s in the order of edges(),
+ * which is the reverse of gts_surface_foreach_edge().
+ */
+static void
+gather_edge_coords(GtsEdge *e, ElementCoords *data)
+{
+  GtsPoint *p1 = GTS_POINT(GTS_SEGMENT(e)->v1);
+  GtsPoint *p2 = GTS_POINT(GTS_SEGMENT(e)->v2);
+  gdouble *c;
+
+  data->n--;
+  c = data->p + 6*data->n;
+  c[0] = p1->x; c[1] = p1->y; c[2] = p1->z;
+  c[3] = p2->x; c[4] = p2->y; c[5] = p2->z;
+}
+
+
+/* Computes the unnormalized normal of the triangle with corners c, as 
+ * gts_triangle_normal() does.
+ */
+static void
+corner_normal(const gdouble *c, gdouble *n)
+{
+  gdouble x1=c[3]-c[0], y1=c[4]-c[1], z1=c[5]-c[2];
+  gdouble x2=c[6]-c[0], y2=c[7]-c[1], z2=c[8]-c[2];
+
+  n[0] = y1*z2 - z1*y2;
+  n[1] = z1*x2 - x1*z2;
+  n[2] = x1*y2 - y1*x2;
+}
+
+
+/* Creates a double array with dimensions (n,) or (n,3) */
+static PyArrayObject*
+double_array_new(gint n, gint m)
+{
+  npy_intp dims[2];
+
+  dims[0] = n;
+  dims[1] = m;
+  return (PyArrayObject*)PyArray_SimpleNew(m>1?2:1,dims,PyArray_DOUBLE);
+}
+
+
+static PyObject*
+face_areas(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  PyArrayObject *a;
+  gdouble *r;
+  gint i, N;
+
+  SELF_CHECK
+
+  if( (N=face_coords_gather(self,&data,FALSE)) < 0 ) {
+    return NULL;
+  }
+  if( (a=double_array_new(N,1)) == NULL ) {
+    element_coords_free(&data);
+    return NULL;
+  }
+  r = (gdouble*)a->data;
+
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    gdouble n[3];
+    corner_normal(data.p+9*i,n);
+    r[i] = 0.5*sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+  }
+
+  element_coords_free(&data);
+  return (PyObject*)a;
+}
+
+
+static PyObject*
+face_normals(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  PyArrayObject *a;
+  gdouble *r;
+  gint i, N;
+
+  SELF_CHECK
+
+  if( (N=face_coords_gather(self,&data,FALSE)) < 0 ) {
+    return NULL;
+  }
+  if( (a=double_array_new(N,3)) == NULL ) {
+    element_coords_free(&data);
+    return NULL;
+  }
+  r = (gdouble*)a->data;
+
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    corner_normal(data.p+9*i,r+3*i);
+  }
+
+  element_coords_free(&data);
+  return (PyObject*)a;
+}
+
+
+static PyObject*
+face_qualities(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  PyArrayObject *a;
+  gdouble *r;
+  gint i, N;
+
+  SELF_CHECK
+
+  if( (N=face_coords_gather(self,&data,FALSE)) < 0 ) {
+    return NULL;
+  }
+  if( (a=double_array_new(N,1)) == NULL ) {
+    element_coords_free(&data);
+    return NULL;
+  }
+  r = (gdouble*)a->data;
+
+  /* This is the quality of gts_triangle_quality() */
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    const gdouble *c = data.p+9*i;
+    gdouble n[3], perimeter;
+    corner_normal(c,n);
+    perimeter = 
+      sqrt((c[3]-c[0])*(c[3]-c[0])+(c[4]-c[1])*(c[4]-c[1])+
+	   (c[5]-c[2])*(c[5]-c[2])) +
+      sqrt((c[6]-c[3])*(c[6]-c[3])+(c[7]-c[4])*(c[7]-c[4])+
+	   (c[8]-c[5])*(c[8]-c[5])) +
+      sqrt((c[0]-c[6])*(c[0]-c[6])+(c[1]-c[7])*(c[1]-c[7])+
+	   (c[2]-c[8])*(c[2]-c[8]));
+    if(perimeter>0.) {
+      r[i] = 4.559014113909555 * 
+	sqrt(0.5*sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2])) / perimeter;
+    }
+    else {
+      r[i] = 0.;
+    }
+  }
+
+  element_coords_free(&data);
+  return (PyObject*)a;
+}
+
+
+static PyObject*
+vertex_normals(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  ElementCoords data;
+  PyArrayObject *a;
+  gchar *weighting="angle";
+  gboolean angle;
+  gdouble *w, *r;
+  gint i, j, k, N, Nv;
+
+  static char *kwlist[] = {"weighting", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &weighting) ) {
+    return NULL;
+  }
+  if( strcmp(weighting,"angle")==0 ) {
+    angle = TRUE;
+  }
+  else if( strcmp(weighting,"area")==0 ) {
+    angle = FALSE;
+  }
+  else {
+    PyErr_SetString(PyExc_ValueError,"weighting must be 'angle' or 'area'");
+    return NULL;
+  }
+
+  if( (N=face_coords_gather(self,&data,TRUE)) < 0 ) {
+    return NULL;
+  }
+  Nv = g_hash_table_size(data.vertices);
+  if( (w = g_try_new(gdouble,9*N+1)) == NULL ) {
+    element_coords_free(&data);
+    PyErr_SetString(PyExc_MemoryError,"could not allocate weights");
+    return NULL;
+  }
+  if( (a=(PyArrayObject*)double_array_new(Nv,3)) == NULL ) {
+    g_free(w);
+    element_coords_free(&data);
+    return NULL;
+  }
+  r = (gdouble*)a->data;
+  memset(r,0,3*Nv*sizeof(gdouble));
+
+  /* Compute the weighted normal for each corner.  The unnormalized normal
+   * is proportional to the face area.
+   */
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    const gdouble *c = data.p+9*i;
+    gdouble n[3], u[3], v[3], x[3], norm, theta;
+    gint l;
+    corner_normal(c,n);
+    if(!angle) {
+      for(l=0;l<3;l++) {
+	w[9*i+3*l] = n[0]; w[9*i+3*l+1] = n[1]; w[9*i+3*l+2] = n[2];
+      }
+      continue;
+    }
+    norm = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    for(l=0;l<3;l++) {
+      u[0] = c[3*((l+1)%3)]-c[3*l];
+      u[1] = c[3*((l+1)%3)+1]-c[3*l+1];
+      u[2] = c[3*((l+1)%3)+2]-c[3*l+2];
+      v[0] = c[3*((l+2)%3)]-c[3*l];
+      v[1] = c[3*((l+2)%3)+1]-c[3*l+1];
+      v[2] = c[3*((l+2)%3)+2]-c[3*l+2];
+      x[0] = u[1]*v[2]-u[2]*v[1];
+      x[1] = u[2]*v[0]-u[0]*v[2];
+      x[2] = u[0]*v[1]-u[1]*v[0];
+      theta = atan2(sqrt(x[0]*x[0]+x[1]*x[1]+x[2]*x[2]),
+		    u[0]*v[0]+u[1]*v[1]+u[2]*v[2]);
+      theta = norm>0. ? theta/norm : 0.;
+      w[9*i+3*l] = theta*n[0];
+      w[9*i+3*l+1] = theta*n[1];
+      w[9*i+3*l+2] = theta*n[2];
+    }
+  }
+
+  /* Accumulate at the vertices; this is serial to avoid races */
+  for(i=0;i<N;i++) {
+    for(j=0;j<3;j++) {
+      k = data.indices[3*i+j];
+      r[3*k] += w[9*i+3*j];
+      r[3*k+1] += w[9*i+3*j+1];
+      r[3*k+2] += w[9*i+3*j+2];
+    }
+  }
+  g_free(w);
+  element_coords_free(&data);
+
+#pragma omp parallel for if(Nv>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<Nv;i++) {
+    gdouble norm = sqrt(r[3*i]*r[3*i]+r[3*i+1]*r[3*i+1]+r[3*i+2]*r[3*i+2]);
+    if(norm>0.) {
+      r[3*i] /= norm;
+      r[3*i+1] /= norm;
+      r[3*i+2] /= norm;
+    }
+  }
+
+  return (PyObject*)a;
+}
+
+
+static PyObject*
+edge_lengths(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  PyArrayObject *a;
+  gdouble *r;
+  gint i, N;
+
+  SELF_CHECK
+
+  N = gts_surface_edge_number(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+  if( (data.p = g_try_new(gdouble,6*N+1)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not allocate coordinates");
+    return NULL;
+  }
+  data.indices = NULL;
+  data.vertices = NULL;
+  data.n = N;
+  gts_surface_foreach_edge(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			   (GtsFunc)gather_edge_coords,&data);
+
+  if( (a=double_array_new(N,1)) == NULL ) {
+    element_coords_free(&data);
+    return NULL;
+  }
+  r = (gdouble*)a->data;
+
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    const gdouble *c = data.p+6*i;
+    r[i] = sqrt((c[3]-c[0])*(c[3]-c[0])+(c[4]-c[1])*(c[4]-c[1])+
+		(c[5]-c[2])*(c[5]-c[2]));
+  }
+
+  element_coords_free(&data);
+  return (PyObject*)a;
+}
+
+
+/* Helper for curvatures(); marks the vertices of edges that do not have 
+ * exactly two faces on the surface.
+ */
+typedef struct {
+  GtsSurface *s;
+  GHashTable *vertices;
+  guchar *boundary;
+} CurvatureBoundaryData;
+
+static void
+curvature_boundary(GtsEdge *e, CurvatureBoundaryData *data)
+{
+  if( gts_edge_face_number(e,data->s) != 2 ) {
+    data->boundary[GPOINTER_TO_UINT(g_hash_table_lookup(data->vertices,
+				       GTS_SEGMENT(e)->v1)) - 1] = 1;
+    data->boundary[GPOINTER_TO_UINT(g_hash_table_lookup(data->vertices,
+				       GTS_SEGMENT(e)->v2)) - 1] = 1;
+  }
+}
+
+
+/* The curvatures are those of gts_vertex_mean_curvature_normal(),
+ * gts_vertex_gaussian_curvature() and gts_vertex_principal_curvatures(),
+ * after Meyer et al.  Each face contributes its mixed area, its angle and
+ * its part of the mean curvature normal to each of its corners.  These
+ * are computed in parallel and then summed at the vertices.
+ */
+#define CORNER_SIZE 5  /* area, angle and the mean curvature normal */
+
+static PyObject*
+curvatures(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  CurvatureBoundaryData bdata;
+  PyArrayObject *a[4];
+  gdouble *w, *sums, *H, *Kg, *K1, *K2;
+  gint i, j, k, m, N, Nv;
+
+  SELF_CHECK
+
+  if( (N=face_coords_gather(self,&data,TRUE)) < 0 ) {
+    return NULL;
+  }
+  Nv = g_hash_table_size(data.vertices);
+
+  w = g_try_new(gdouble,3*CORNER_SIZE*N+1);
+  sums = g_try_new0(gdouble,CORNER_SIZE*Nv+1);
+  bdata.boundary = g_try_new0(guchar,Nv+1);
+  if( w==NULL || sums==NULL || bdata.boundary==NULL ) {
+    g_free(w);
+    g_free(sums);
+    g_free(bdata.boundary);
+    element_coords_free(&data);
+    PyErr_SetString(PyExc_MemoryError,"could not allocate curvature data");
+    return NULL;
+  }
+  for(i=0;i<4;i++) {
+    if( (a[i]=double_array_new(Nv,1)) == NULL ) {
+      for(j=0;j<i;j++) Py_DECREF(a[j]);
+      g_free(w);
+      g_free(sums);
+      g_free(bdata.boundary);
+      element_coords_free(&data);
+      return NULL;
+    }
+  }
+
+  /* Curvatures are undefined on the boundary, as in GTS */
+  bdata.s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+  bdata.vertices = data.vertices;
+  gts_surface_foreach_edge(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			   (GtsFunc)curvature_boundary,&bdata);
+
+  /* Compute the contributions of each face to its corners */
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    const gdouble *c = data.p+9*i;
+    gdouble *wi = w+3*CORNER_SIZE*i;
+    gdouble n[3], area2, dot[3], cot[3], len2[3], area;
+    const gdouble *p0, *p1, *p2;
+    gint l;
+
+    corner_normal(c,n);
+    area2 = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    if(area2<=0.) {
+      for(l=0;l<3*CORNER_SIZE;l++) wi[l] = 0.;
+      continue;
+    }
+
+    /* Angles at each corner; len2[l] is for the edge opposite corner l */
+    for(l=0;l<3;l++) {
+      p0 = c+3*l; p1 = c+3*((l+1)%3); p2 = c+3*((l+2)%3);
+      dot[l] = (p1[0]-p0[0])*(p2[0]-p0[0]) + (p1[1]-p0[1])*(p2[1]-p0[1]) +
+	(p1[2]-p0[2])*(p2[2]-p0[2]);
+      cot[l] = dot[l]/area2;
+      len2[l] = (p2[0]-p1[0])*(p2[0]-p1[0]) + (p2[1]-p1[1])*(p2[1]-p1[1]) +
+	(p2[2]-p1[2])*(p2[2]-p1[2]);
+    }
+
+    area = 0.5*area2;
+    for(l=0;l<3;l++) {
+      gint l1=(l+1)%3, l2=(l+2)%3;
+      p0 = c+3*l; p1 = c+3*l1; p2 = c+3*l2;
+
+      /* Mixed area */
+      if( dot[0]<0. || dot[1]<0. || dot[2]<0. ) {
+	wi[CORNER_SIZE*l] = dot[l]<0. ? area/2. : area/4.;
+      }
+      else {
+	wi[CORNER_SIZE*l] = (cot[l1]*len2[l1] + cot[l2]*len2[l2])/8.;
+      }
+
+      /* Angle */
+      wi[CORNER_SIZE*l+1] = atan2(area2,dot[l]);
+
+      /* Mean curvature normal */
+      wi[CORNER_SIZE*l+2] = cot[l1]*(p2[0]-p0[0]) + cot[l2]*(p1[0]-p0[0]);
+      wi[CORNER_SIZE*l+3] = cot[l1]*(p2[1]-p0[1]) + cot[l2]*(p1[1]-p0[1]);
+      wi[CORNER_SIZE*l+4] = cot[l1]*(p2[2]-p0[2]) + cot[l2]*(p1[2]-p0[2]);
+    }
+  }
+
+  /* Accumulate at the vertices; this is serial to avoid races */
+  for(i=0;i<N;i++) {
+    for(j=0;j<3;j++) {
+      k = data.indices[3*i+j];
+      for(m=0;m<CORNER_SIZE;m++) {
+	sums[CORNER_SIZE*k+m] += w[3*CORNER_SIZE*i+CORNER_SIZE*j+m];
+      }
+    }
+  }
+  g_free(w);
+  element_coords_free(&data);
+
+  H = (gdouble*)a[0]->data;
+  Kg = (gdouble*)a[1]->data;
+  K1 = (gdouble*)a[2]->data;
+  K2 = (gdouble*)a[3]->data;
+
+#pragma omp parallel for if(Nv>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<Nv;i++) {
+    const gdouble *si = sums+CORNER_SIZE*i;
+    gdouble area=si[0], temp;
+
+    if( bdata.boundary[i] || area<=0. ) {
+      H[i] = Kg[i] = K1[i] = K2[i] = Py_NAN;
+      continue;
+    }
+    H[i] = sqrt(si[2]*si[2]+si[3]*si[3]+si[4]*si[4])/(4.*area);
+    Kg[i] = (2.*M_PI-si[1])/area;
+    temp = H[i]*H[i]-Kg[i];
+    temp = temp>0. ? sqrt(temp) : 0.;
+    K1[i] = H[i]+temp;
+    K2[i] = H[i]-temp;
+  }
+
+  g_free(sums);
+  g_free(bdata.boundary);
+
+  return Py_BuildValue("NNNN",a[0],a[1],a[2],a[3]);
+}
+
+#undef CORNER_SIZE
+
+
+/* Helpers for adjacency() */
+typedef struct {
+  gint v1, v2;  /* Vertex indices, v1<v2 */
+  gint f;       /* Face index */
+} CornerEdge;
+
+static int
+corner_edge_compare(const void *a, const void *b)
+{
+  const CornerEdge *e1=(const CornerEdge*)a, *e2=(const CornerEdge*)b;
+
+  if(e1->v1!=e2->v1) return e1->v1<e2->v1 ? -1 : 1;
+  if(e1->v2!=e2->v2) return e1->v2<e2->v2 ? -1 : 1;
+  if(e1->f!=e2->f) return e1->f<e2->f ? -1 : 1;
+  return 0;
+}
+
+/* Returns the edges of the gathered faces sorted by their vertices, 
+ * which brings together the faces that share each edge.  Returns NULL
+ * with an exception set on failure.
+ */
+static CornerEdge*
+corner_edges_sorted(ElementCoords *data)
+{
+  CornerEdge *edges;
+  gint i, j, k, l;
+
+  if( (edges = g_try_new(CornerEdge,3*data->n+1)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not allocate edges");
+    return NULL;
+  }
+  for(i=0;i<data->n;i++) {
+    for(j=0;j<3;j++) {
+      k = data->indices[3*i+j];
+      l = data->indices[3*i+(j+1)%3];
+      edges[3*i+j].v1 = MIN(k,l);
+      edges[3*i+j].v2 = MAX(k,l);
+      edges[3*i+j].f = i;
+    }
+  }
+  qsort(edges,3*data->n,sizeof(CornerEdge),corner_edge_compare);
+  return edges;
+}
+
+
+static int
+index_compare(const void *a, const void *b)
+{
+  gint i=*(const gint*)a, j=*(const gint*)b;
+  return i<j ? -1 : (i>j ? 1 : 0);
+}
+
+
+/* Builds the CSR arrays (indptr,indices) for n rows from m (row,col) 
+ * pairs.  The indices in each row are sorted.
+ */
+static PyObject*
+csr_from_pairs(gint n, gint *rows, gint *cols, gint m)
+{
+  PyArrayObject *indptr, *indices;
+  npy_intp dims[1];
+  gint *p, *q, *next, i;
+
+  dims[0] = n+1;
+  if( (indptr=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_INT)) 
+      == NULL ) {
+    return NULL;
+  }
+  dims[0] = m;
+  if( (indices=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_INT)) 
+      == NULL ) {
+    Py_DECREF(indptr);
+    return NULL;
+  }
+  if( (next = g_try_new(gint,n+1)) == NULL ) {
+    Py_DECREF(indptr);
+    Py_DECREF(indices);
+    PyErr_SetString(PyExc_MemoryError,"could not allocate rows");
+    return NULL;
+  }
+  p = (gint*)indptr->data;
+  q = (gint*)indices->data;
+
+  /* Count, then fill each row */
+  memset(p,0,(n+1)*sizeof(gint));
+  for(i=0;i<m;i++) p[rows[i]+1]++;
+  for(i=0;i<n;i++) p[i+1] += p[i];
+  memcpy(next,p,n*sizeof(gint));
+  for(i=0;i<m;i++) q[next[rows[i]]++] = cols[i];
+  g_free(next);
+
+  for(i=0;i<n;i++) {
+    qsort(q+p[i],p[i+1]-p[i],sizeof(gint),index_compare);
+  }
+
+  return Py_BuildValue("NN",indptr,indices);
+}
+
+
+#define ADJACENCY_CLEANUP \
+  g_free(rows); \
+  g_free(cols); \
+  g_free(edges); \
+  element_coords_free(&data);
+
+static PyObject*
+adjacency(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  ElementCoords data;
+  gchar *kind="vertex-vertex";
+  CornerEdge *edges=NULL;
+  gint *rows=NULL, *cols=NULL;
+  gint i, j, k, l, m, N, Nv;
+  PyObject *ret;
+
+  static char *kwlist[] = {"kind", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &kind) ) {
+    return NULL;
+  }
+  if( strcmp(kind,"vertex-vertex")!=0 && strcmp(kind,"vertex-face")!=0 &&
+      strcmp(kind,"face-face")!=0 ) {
+    PyErr_SetString(PyExc_ValueError,
+	   "kind must be 'vertex-vertex', 'vertex-face' or 'face-face'");
+    return NULL;
+  }
+
+  if( (N=face_coords_gather(self,&data,TRUE)) < 0 ) {
+    return NULL;
+  }
+  Nv = g_hash_table_size(data.vertices);
+
+  if( strcmp(kind,"vertex-face")==0 ) {
+    m = 3*N;
+  }
+  else {
+    if( (edges = corner_edges_sorted(&data)) == NULL ) {
+      ADJACENCY_CLEANUP
+      return NULL;
+    }
+
+    /* Count the pairs */
+    for(i=0,m=0;i<3*N;i=j) {
+      for(j=i+1; j<3*N && edges[j].v1==edges[i].v1 && 
+	    edges[j].v2==edges[i].v2; j++);
+      m += strcmp(kind,"vertex-vertex")==0 ? 2 : (j-i)*(j-i-1);
+    }
+  }
+
+  rows = g_try_new(gint,m+1);
+  cols = g_try_new(gint,m+1);
+  if( rows==NULL || cols==NULL ) {
+    ADJACENCY_CLEANUP
+    PyErr_SetString(PyExc_MemoryError,"could not allocate adjacency");
+    return NULL;
+  }
+
+  /* Assemble the pairs */
+  m = 0;
+  if( strcmp(kind,"vertex-face")==0 ) {
+    for(i=0;i<N;i++) {
+      for(j=0;j<3;j++) {
+	rows[m] = data.indices[3*i+j];
+	cols[m++] = i;
+      }
+    }
+  }
+  else {
+    for(i=0;i<3*N;i=j) {
+      for(j=i+1; j<3*N && edges[j].v1==edges[i].v1 && 
+	    edges[j].v2==edges[i].v2; j++);
+      if( strcmp(kind,"vertex-vertex")==0 ) {
+	rows[m] = edges[i].v1; cols[m++] = edges[i].v2;
+	rows[m] = edges[i].v2; cols[m++] = edges[i].v1;
+      }
+      else {
+	for(k=i;k<j;k++) {
+	  for(l=i;l<j;l++) {
+	    if(k!=l) {
+	      rows[m] = edges[k].f; cols[m++] = edges[l].f;
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  ret = csr_from_pairs(strcmp(kind,"face-face")==0 ? N : Nv, rows, cols, m);
+
+  ADJACENCY_CLEANUP
+  return ret;
+}
+
+#undef ADJACENCY_CLEANUP
+
+
+/* Helpers for component_labels() and split().  Faces are joined with a
+ * union-find over the edges they share.  As for gts_surface_split(), 
+ * only manifold edges (with exactly two faces) join faces.
+ */
+static gint
+component_find(gint *parent, gint i)
+{
+  while(parent[i]!=i) {
+    parent[i] = parent[parent[i]];  /* Path halving */
+    i = parent[i];
+  }
+  return i;
+}
+
+
+/* Labels the gathered faces with their component numbers, given in order
+ * of the first face of each component.  Returns the number of components,
+ * or -1 with an exception set.
+ */
+static gint
+face_components(ElementCoords *data, gint *labels)
+{
+  CornerEdge *edges;
+  gint i, j, a, b, n=0;
+
+  if( (edges = corner_edges_sorted(data)) == NULL ) {
+    return -1;
+  }
+
+  for(i=0;i<data->n;i++) labels[i] = i;
+  for(i=0;i<3*data->n;i=j) {
+    for(j=i+1; j<3*data->n && edges[j].v1==edges[i].v1 && 
+	  edges[j].v2==edges[i].v2; j++);
+    if(j-i==2) {
+      a = component_find(labels,edges[i].f);
+      b = component_find(labels,edges[i+1].f);
+      /* Keep the lowest face as the root */
+      if(a<b) labels[b] = a;
+      else if(b<a) labels[a] = b;
+    }
+  }
+  g_free(edges);
+
+  /* Point each face at its root, then number the roots.  Roots precede
+   * the other faces of their components.
+   */
+  for(i=0;i<data->n;i++) {
+    labels[i] = component_find(labels,i);
+  }
+  for(i=0;i<data->n;i++) {
+    labels[i] = labels[i]==i ? n++ : labels[labels[i]];
+  }
+
+  return n;
+}
+
+
+static PyObject*
+component_labels(PygtsSurface *self, PyObject *args)
+{
+  ElementCoords data;
+  PyArrayObject *labels;
+  npy_intp dims[1];
+
+  SELF_CHECK
+
+  if( face_coords_gather(self,&data,TRUE) < 0 ) {
+    return NULL;
+  }
+  dims[0] = data.n;
+  if( (labels=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_INT)) 
+      == NULL ) {
+    element_coords_free(&data);
+    return NULL;
+  }
+  if( face_components(&data,(gint*)labels->data) < 0 ) {
+    Py_DECREF(labels);
+    element_coords_free(&data);
+    return NULL;
+  }
+
+  element_coords_free(&data);
+  return (PyObject*)labels;
+}
+
+
+/* Builds the (coords,triangles) arrays for each component of self, 
+ * without creating any surfaces.
+ */
+#define SPLIT_CLEANUP \
+  g_free(labels); \
+  g_free(order); \
+  g_free(start); \
+  g_free(local); \
+  element_coords_free(&data);
+
+static PyObject*
+split_arrays(PygtsSurface *self)
+{
+  ElementCoords data;
+  PyObject *tuple;
+  PyArrayObject *coords, *triangles;
+  npy_intp dims[2];
+  gint *labels, *order=NULL, *start=NULL, *local=NULL, *t;
+  gdouble *x;
+  gint i, j, k, c, v, N, Nv, nc, nv;
+
+  if( (N=face_coords_gather(self,&data,TRUE)) < 0 ) {
+    return NULL;
+  }
+  Nv = g_hash_table_size(data.vertices);
+
+  if( (labels = g_try_new(gint,N+1)) == NULL ||
+      (order = g_try_new(gint,N+1)) == NULL ||
+      (local = g_try_new(gint,2*Nv+1)) == NULL ) {
+    SPLIT_CLEANUP
+    PyErr_SetString(PyExc_MemoryError,"could not allocate components");
+    return NULL;
+  }
+  if( (nc = face_components(&data,labels)) < 0 ) {
+    SPLIT_CLEANUP
+    return NULL;
+  }
+  if( (start = g_try_new0(gint,nc+1)) == NULL ) {
+    SPLIT_CLEANUP
+    PyErr_SetString(PyExc_MemoryError,"could not allocate components");
+    return NULL;
+  }
+
+  /* Sort the faces by component, keeping their order within each */
+  for(i=0;i<N;i++) start[labels[i]+1]++;
+  for(c=0;c<nc;c++) start[c+1] += start[c];
+  for(i=0;i<N;i++) order[start[labels[i]]++] = i;
+  for(c=nc;c>0;c--) start[c] = start[c-1];
+  start[0] = 0;
+
+  if( (tuple=PyTuple_New(nc)) == NULL) {
+    SPLIT_CLEANUP
+    PyErr_SetString(PyExc_MemoryError,"could not create tuple");
+    return NULL;
+  }
+
+  /* local[2*v] is the last component that v was indexed for, and 
+   * local[2*v+1] is its index there.
+   */
+  for(v=0;v<Nv;v++) local[2*v] = -1;
+
+  for(c=0;c<nc;c++) {
+    nv = 0;
+    for(k=start[c];k<start[c+1];k++) {
+      for(j=0;j<3;j++) {
+	v = data.indices[3*order[k]+j];
+	if(local[2*v]!=c) {
+	  local[2*v] = c;
+	  local[2*v+1] = nv++;
+	}
+      }
+    }
+
+    dims[0] = nv;
+    dims[1] = 3;
+    if( (coords = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_DOUBLE))
+	== NULL ) {
+      Py_DECREF(tuple);
+      SPLIT_CLEANUP
+      return NULL;
+    }
+    dims[0] = start[c+1]-start[c];
+    if( (triangles = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_INT))
+	== NULL ) {
+      Py_DECREF(coords);
+      Py_DECREF(tuple);
+      SPLIT_CLEANUP
+      return NULL;
+    }
+
+    x = (gdouble*)coords->data;
+    t = (gint*)triangles->data;
+    for(k=start[c];k<start[c+1];k++) {
+      i = order[k];
+      for(j=0;j<3;j++) {
+	v = local[2*data.indices[3*i+j]+1];
+	*(t++) = v;
+	x[3*v] = data.p[9*i+3*j];
+	x[3*v+1] = data.p[9*i+3*j+1];
+	x[3*v+2] = data.p[9*i+3*j+2];
+      }
+    }
+
+    PyTuple_SET_ITEM(tuple,c,Py_BuildValue("NN",coords,triangles));
+  }
+
+  SPLIT_CLEANUP
+  return tuple;
+}
+
+#undef SPLIT_CLEANUP
+
+
+/* Helpers for strip_indices() */
+static gboolean
+oriented_as(GtsVertex **w, GtsVertex *x, GtsVertex *y, GtsVertex *z)
+{
+  guint i;
+
+  for(i=0;i<3;i++) {
+    if(w[i]==x) return w[(i+1)%3]==y && w[(i+2)%3]==z;
+  }
+  return FALSE;
+}
+
+static gboolean
+has_vertex(GtsVertex **w, GtsVertex *v)
+{
+  return w[0]==v || w[1]==v || w[2]==v;
+}
+
+
+#define STRIP_INDEX(v) \
+  (GPOINTER_TO_UINT(g_hash_table_lookup(vertices,(v))) - 1)
+
+static PyObject*
+strip_indices(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *restart_=NULL;
+  guint restart=0xFFFFFFFF, index;
+  gboolean offsets;
+  GHashTable *vertices;
+  GSList *strips, *s, *f;
+  GArray *indices, *starts;
+  GtsVertex *w[3], *wnext[3], *v[3], *p, *q;
+  guint i, start, n;
+  PyArrayObject *a, *b;
+  npy_intp dims[1];
+
+  static char *kwlist[] = {"restart", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &restart_) ) {
+    return NULL;
+  }
+  offsets = (restart_==Py_None);
+  if( restart_!=NULL && !offsets ) {
+    if( !PyInt_Check(restart_) && !PyLong_Check(restart_) ) {
+      PyErr_SetString(PyExc_TypeError,"restart must be an int or None");
+      return NULL;
+    }
+    restart = (guint)PyInt_AsUnsignedLongMask(restart_);
+  }
+
+  vertices = g_hash_table_new(NULL,NULL);
+  surface_foreach_vertex(self,(GtsFunc)index_vertex,vertices);
+
+  strips = gts_surface_strip(PYGTS_SURFACE_AS_GTS_SURFACE(self));
+
+  /* A GTS strip is a list of faces that share an edge with their
+   * predecessors, but not necessarily the edge formed by the last two 
+   * vertices, or with the winding that the strip position calls for.  
+   * The strip is broken wherever that happens.
+   */
+  indices = g_array_new(FALSE,FALSE,sizeof(guint));
+  starts = g_array_new(FALSE,FALSE,sizeof(guint));
+  for(s=strips;s!=NULL;s=g_slist_next(s)) {
+    n = 0;
+    for(f=(GSList*)s->data;f!=NULL;f=g_slist_next(f)) {
+      gts_triangle_vertices(GTS_TRIANGLE(f->data),&w[0],&w[1],&w[2]);
+
+      /* Continue the current strip if possible */
+      if(n>=3) {
+	p = v[1];
+	q = v[2];
+	for(i=0;i<3;i++) {
+	  if(w[i]!=p && w[i]!=q) break;
+	}
+	if( n%2==1 ? oriented_as(w,q,p,w[i]) : oriented_as(w,p,q,w[i]) ) {
+	  index = STRIP_INDEX(w[i]);
+	  g_array_append_val(indices,index);
+	  v[1] = q;
+	  v[2] = w[i];
+	  n++;
+	  continue;
+	}
+      }
+
+      /* Start a new strip.  The vertex that is not on the next face 
+       * goes first, so that the strip can continue through it.
+       */
+      if(indices->len>0 && !offsets) {
+	g_array_append_val(indices,restart);
+      }
+      start = indices->len;
+      g_array_append_val(starts,start);
+      i = 0;
+      if(g_slist_next(f)!=NULL) {
+	gts_triangle_vertices(GTS_TRIANGLE(g_slist_next(f)->data),
+			      &wnext[0],&wnext[1],&wnext[2]);
+	for(i=0;i<3;i++) {
+	  if(!has_vertex(wnext,w[i])) break;
+	}
+	if(i==3) i = 0;
+      }
+      v[0] = w[i];
+      v[1] = w[(i+1)%3];
+      v[2] = w[(i+2)%3];
+      for(i=0;i<3;i++) {
+	index = STRIP_INDEX(v[i]);
+	g_array_append_val(indices,index);
+      }
+      n = 3;
+    }
+  }
+  strips_free(strips);
+  g_hash_table_destroy(vertices);
+
+  /* Assemble the arrays */
+  dims[0] = indices->len;
+  if( (a=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_UINT)) == NULL ) {
+    g_array_free(indices,TRUE);
+    g_array_free(starts,TRUE);
+    return NULL;
+  }
+  memcpy(a->data,indices->data,indices->len*sizeof(guint));
+
+  if(!offsets) {
+    g_array_free(indices,TRUE);
+    g_array_free(starts,TRUE);
+    return (PyObject*)a;
+  }
+
+  start = indices->len;
+  g_array_append_val(starts,start);
+  dims[0] = starts->len;
+  if( (b=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_UINT)) == NULL ) {
+    Py_DECREF(a);
+    g_array_free(indices,TRUE);
+    g_array_free(starts,TRUE);
+    return NULL;
+  }
+  memcpy(b->data,starts->data,starts->len*sizeof(guint));
+
+  g_array_free(indices,TRUE);
+  g_array_free(starts,TRUE);
+  return Py_BuildValue("NN",a,b);
+}
+
+#undef STRIP_INDEX
+
+
+static PyObject*
+traverse_indices(PygtsSurface *self, PyObject *args)
+{
+  PygtsSurfaceTraverse *t;
+  GHashTable *indices;
+  PyArrayObject *a;
+  npy_intp dims[1];
+  GtsFace *f;
+  gint *r;
+  guint i;
+
+  SELF_CHECK
+
+  t = traverse_new(self);
+
+  /* The faces are gathered in the order of face_indices() */
+  indices = g_hash_table_new(NULL,NULL);
+  for(i=0;i<t->faces->len;i++) {
+    g_hash_table_insert(indices,g_ptr_array_index(t->faces,i),
+			GUINT_TO_POINTER(i+1));
+  }
+
+  dims[0] = t->faces->len;
+  if( (a=(PyArrayObject*)PyArray_SimpleNew(1,dims,PyArray_INT)) == NULL ) {
+    g_hash_table_destroy(indices);
+    traverse_destroy(t);
+    return NULL;
+  }
+  r = (gint*)a->data;
+  while( (f=traverse_next(t)) != NULL ) {
+    *(r++) = GPOINTER_TO_UINT(g_hash_table_lookup(indices,f)) - 1;
+  }
+
+  g_hash_table_destroy(indices);
+  traverse_destroy(t);
+  return (PyObject*)a;
+}
+
+
+/* Iterator returned by iter_chunks().  The faces are gathered up front,
+ * and each block of them is given with its own vertices.
+ */
+typedef struct {
+  PyObject_HEAD
+  PygtsSurface *surface;
+  GPtrArray *faces;
+  GHashTable *vertices;  /* Maps vertices to their index+1 in a block */
+  guint next, size;
+  guint version, geometry;
+} PygtsSurfaceChunks;
+
+static void
+chunks_dealloc(PygtsSurfaceChunks *self)
+{
+  Py_XDECREF(self->surface);
+  if(self->faces) g_ptr_array_free(self->faces,TRUE);
+  if(self->vertices) g_hash_table_destroy(self->vertices);
+  PyObject_Del(self);
+}
+
+static PyObject*
+chunks_iternext(PygtsSurfaceChunks *self)
+{
+  PyArrayObject *coords, *triangles;
+  npy_intp dims[2];
+  GtsVertex *v[3];
+  GtsPoint *p;
+  gdouble *x;
+  gint *t;
+  guint i, j, n, end, index;
+
+  if( self->next >= self->faces->len ) {
+    PyErr_SetString(PyExc_StopIteration,"No more faces");
+    return NULL;
+  }
+
+  /* The faces must not have been destroyed since they were gathered */
+  if( pygts_surface_apply_pending_transform()==-1 ) {
+    return NULL;
+  }
+  if( self->version!=self->surface->version || 
+      self->geometry!=self->surface->geometry ) {
+    PyErr_SetString(PyExc_RuntimeError,"Surface changed during iteration");
+    return NULL;
+  }
+
+  /* Index the vertices of the block */
+  end = MIN(self->next+self->size,self->faces->len);
+  g_hash_table_remove_all(self->vertices);
+  for(i=self->next,n=0;i<end;i++) {
+    gts_triangle_vertices(GTS_TRIANGLE(g_ptr_array_index(self->faces,i)),
+			  &v[0],&v[1],&v[2]);
+    for(j=0;j<3;j++) {
+      if( g_hash_table_lookup(self->vertices,v[j]) == NULL ) {
+	g_hash_table_insert(self->vertices,v[j],GUINT_TO_POINTER(++n));
+      }
+    }
+  }
+
+  dims[0] = n;
+  dims[1] = 3;
+  if( (coords = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_DOUBLE))
+      == NULL ) {
+    return NULL;
+  }
+  dims[0] = end-self->next;
+  if( (triangles = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_INT))
+      == NULL ) {
+    Py_DECREF(coords);
+    return NULL;
+  }
+
+  x = (gdouble*)coords->data;
+  t = (gint*)triangles->data;
+  for(i=self->next;i<end;i++) {
+    gts_triangle_vertices(GTS_TRIANGLE(g_ptr_array_index(self->faces,i)),
+			  &v[0],&v[1],&v[2]);
+    for(j=0;j<3;j++) {
+      index = GPOINTER_TO_UINT(g_hash_table_lookup(self->vertices,v[j])) - 1;
+      *(t++) = index;
+      p = GTS_POINT(v[j]);
+      x[3*index] = p->x;
+      x[3*index+1] = p->y;
+      x[3*index+2] = p->z;
+    }
+  }
+  self->next = end;
+
+  return Py_BuildValue("NN",coords,triangles);
+}
+
+static PyTypeObject PygtsSurfaceChunksType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                       /* ob_size */
+    "gts.SurfaceChunks",     /* tp_name */
+    sizeof(PygtsSurfaceChunks), /* tp_basicsize */
+    0,                       /* tp_itemsize */
+    (destructor)chunks_dealloc, /* tp_dealloc */
+    0,                       /* tp_print */
+    0,                       /* tp_getattr */
+    0,                       /* tp_setattr */
+    0,                       /* tp_compare */
+    0,                       /* tp_repr */
+    0,                       /* tp_as_number */
+    0,                       /* tp_as_sequence */
+    0,                       /* tp_as_mapping */
+    0,                       /* tp_hash */
+    0,                       /* tp_call */
+    0,                       /* tp_str */
+    0,                       /* tp_getattro */
+    0,                       /* tp_setattro */
+    0,                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+      Py_TPFLAGS_HAVE_ITER,  /* tp_flags */
+    "Iterator over blocks of the faces of a Surface", /* tp_doc */
+    0,                       /* tp_traverse */
+    0,                       /* tp_clear */
+    0,                       /* tp_richcompare */
+    0,                       /* tp_weaklistoffset */
+    PyObject_SelfIter,       /* tp_iter */
+    (iternextfunc)chunks_iternext, /* tp_iternext */
+};
+
+
+static PyObject*
+iter_chunks(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  PygtsSurfaceChunks *chunks;
+  gint size=65536;
+
+  static char *kwlist[] = {"size", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &size) ) {
+    return NULL;
+  }
+  if( size<=0 ) {
+    PyErr_SetString(PyExc_ValueError,"size must be positive");
+    return NULL;
+  }
+
+  if( PyType_Ready(&PygtsSurfaceChunksType) < 0 ) {
+    return NULL;
+  }
+  if( (chunks = PyObject_New(PygtsSurfaceChunks,&PygtsSurfaceChunksType))
+      == NULL ) {
+    return NULL;
+  }
+  Py_INCREF((PyObject*)self);
+  chunks->surface = self;
+  chunks->faces = 
+    g_ptr_array_sized_new(gts_surface_face_number(
+			    PYGTS_SURFACE_AS_GTS_SURFACE(self)));
+  surface_foreach_face(self,(GtsFunc)gather_face,chunks->faces);
+  chunks->vertices = g_hash_table_new(NULL,NULL);
+  chunks->next = 0;
+  chunks->size = size;
+  chunks->version = self->version;
+  chunks->geometry = self->geometry;
+
+  return (PyObject*)chunks;
+}
+
+#endif /* PYGTS_HAS_NUMPY */
+
+
+/* Helpers for reorder() */
+static void
+gather_element(gpointer o, GPtrArray *elements)
+{
+  g_ptr_array_add(elements,o);
+}
+
+
+/* Forsyth's linear-speed vertex cache optimisation.  Faces are added 
+ * greedily by the scores of their vertices, which favour vertices that
+ * are in a simulated LRU cache and that have few faces left to add.
+ */
+#define FORSYTH_CACHE 32
+
+static gdouble
+forsyth_score(gint position, gint remaining)
+{
+  gdouble score;
+
+  if(remaining==0) return -1.;
+  if(position<0) {
+    score = 0.;
+  }
+  else if(position<3) {
+    score = 0.75;
+  }
+  else {
+    score = pow(1.-(gdouble)(position-3)/(FORSYTH_CACHE-3), 1.5);
+  }
+  return score + 2.*pow((gdouble)remaining,-0.5);
+}
+
+static void
+forsyth_order(ElementCoords *data, gint nv, gint *order)
+{
+  gint N=data->n, *t=data->indices;
+  gint *start, *faces, *remaining, *position, *cache, *next, ncache=0;
+  gdouble *vscore, *fscore, best_score;
+  gboolean *added;
+  gint i, j, k, l, m, v, f, best=-1, cursor=0, nnext;
+
+  start = g_new0(gint,nv+1);
+  faces = g_new(gint,3*N+1);
+  remaining = g_new0(gint,nv+1);
+  position = g_new(gint,nv+1);
+  vscore = g_new(gdouble,nv+1);
+  fscore = g_new(gdouble,N+1);
+  added = g_new0(gboolean,N+1);
+  cache = g_new(gint,FORSYTH_CACHE+3);
+  next = g_new(gint,FORSYTH_CACHE+3);
+
+  /* The faces of each vertex; the ones still to add come first */
+  for(i=0;i<3*N;i++) remaining[t[i]]++;
+  for(v=0;v<nv;v++) start[v+1] = start[v]+remaining[v];
+  for(v=0;v<nv;v++) position[v] = start[v];
+  for(i=0;i<3*N;i++) faces[position[t[i]]++] = i/3;
+
+  for(v=0;v<nv;v++) {
+    position[v] = -1;
+    vscore[v] = forsyth_score(-1,remaining[v]);
+  }
+  for(f=0;f<N;f++) {
+    fscore[f] = vscore[t[3*f]] + vscore[t[3*f+1]] + vscore[t[3*f+2]];
+  }
+
+  for(k=0;k<N;k++) {
+
+    /* Fall back to the next face not yet added */
+    if(best<0) {
+      while(added[cursor]) cursor++;
+      best = cursor;
+    }
+    order[k] = best;
+    added[best] = TRUE;
+
+    /* Take the face off the lists of its vertices, and put them at the
+     * front of the cache.
+     */
+    nnext = 0;
+    for(j=0;j<3;j++) {
+      v = t[3*best+j];
+      for(l=start[v];l<start[v]+remaining[v];l++) {
+	if(faces[l]==best) {
+	  faces[l] = faces[start[v]+remaining[v]-1];
+	  faces[start[v]+remaining[v]-1] = best;
+	  break;
+	}
+      }
+      remaining[v]--;
+      next[nnext++] = v;
+    }
+    for(i=0;i<ncache;i++) {
+      v = cache[i];
+      if( v!=next[0] && v!=next[1] && v!=next[2] ) next[nnext++] = v;
+    }
+
+    /* Rescore the vertices that are or were in the cache, and their
+     * faces.  The best face is picked from those.
+     */
+    best = -1;
+    best_score = -1.;
+    for(i=0;i<nnext;i++) {
+      v = next[i];
+      position[v] = i<FORSYTH_CACHE ? i : -1;
+      vscore[v] = forsyth_score(position[v],remaining[v]);
+    }
+    for(i=0;i<nnext;i++) {
+      v = next[i];
+      for(l=start[v];l<start[v]+remaining[v];l++) {
+	f = faces[l];
+	fscore[f] = vscore[t[3*f]] + vscore[t[3*f+1]] + vscore[t[3*f+2]];
+	if(fscore[f]>best_score) {
+	  best_score = fscore[f];
+	  best = f;
+	}
+      }
+    }
+
+    ncache = MIN(nnext,FORSYTH_CACHE);
+    for(m=0;m<ncache;m++) cache[m] = next[m];
+  }
+
+  g_free(start);
+  g_free(faces);
+  g_free(remaining);
+  g_free(position);
+  g_free(vscore);
+  g_free(fscore);
+  g_free(added);
+  g_free(cache);
+  g_free(next);
+}
+
+#undef FORSYTH_CACHE
+
+
+/* Orders the faces along a Hilbert curve through their centroids */
+#define HILBERT_BITS 21
+
+typedef struct {
+  guint64 key;
+  gint f;
+} HilbertFace;
+
+static int
+hilbert_face_compare(const void *a, const void *b)
+{
+  const HilbertFace *f1=(const HilbertFace*)a, *f2=(const HilbertFace*)b;
+
+  if(f1->key!=f2->key) return f1->key<f2->key ? -1 : 1;
+  return f1->f<f2->f ? -1 : (f1->f>f2->f ? 1 : 0);
+}
+
+/* The Hilbert index of x, from Skilling's transpose algorithm (AIP Conf.
+ * Proc. 707, 381, 2004).
+ */
+static guint64
+hilbert_key(guint32 *x)
+{
+  guint32 M=1U<<(HILBERT_BITS-1), P, Q, t;
+  guint64 key=0;
+  gint i;
+
+  /* Inverse undo */
+  for(Q=M;Q>1;Q>>=1) {
+    P = Q-1;
+    for(i=0;i<3;i++) {
+      if(x[i]&Q) {
+	x[0] ^= P;
+      }
+      else {
+	t = (x[0]^x[i]) & P;
+	x[0] ^= t;
+	x[i] ^= t;
+      }
+    }
+  }
+
+  /* Gray encode */
+  for(i=1;i<3;i++) x[i] ^= x[i-1];
+  t = 0;
+  for(Q=M;Q>1;Q>>=1) {
+    if(x[2]&Q) t ^= Q-1;
+  }
+  for(i=0;i<3;i++) x[i] ^= t;
+
+  /* Interleave the transposed bits */
+  for(Q=M;Q>0;Q>>=1) {
+    for(i=0;i<3;i++) {
+      key = (key<<1) | ((x[i]&Q) ? 1 : 0);
+    }
+  }
+  return key;
+}
+
+static void
+hilbert_order(ElementCoords *data, gint *order)
+{
+  gint N=data->n;
+  HilbertFace *keys;
+  gdouble lo[3], scale[3];
+  gint i, j;
+
+  if(N==0) return;
+
+  /* The bounding box of the corners */
+  for(j=0;j<3;j++) lo[j] = scale[j] = data->p[j];
+  for(i=0;i<3*N;i++) {
+    for(j=0;j<3;j++) {
+      lo[j] = MIN(lo[j],data->p[3*i+j]);
+      scale[j] = MAX(scale[j],data->p[3*i+j]);
+    }
+  }
+  for(j=0;j<3;j++) {
+    scale[j] = scale[j]>lo[j] ? 
+      ((1U<<HILBERT_BITS)-1)/(scale[j]-lo[j]) : 0.;
+  }
+
+  keys = g_new(HilbertFace,N);
+
+#pragma omp parallel for if(N>=ARRAYS_PARALLEL_MIN)
+  for(i=0;i<N;i++) {
+    const gdouble *c = data->p+9*i;
+    guint32 x[3];
+    gint l;
+    for(l=0;l<3;l++) {
+      x[l] = (guint32)(((c[l]+c[3+l]+c[6+l])/3.-lo[l])*scale[l]);
+    }
+    keys[i].key = hilbert_key(x);
+    keys[i].f = i;
+  }
+
+  qsort(keys,N,sizeof(HilbertFace),hilbert_face_compare);
+  for(i=0;i<N;i++) order[i] = keys[i].f;
+  g_free(keys);
+}
+
+#undef HILBERT_BITS
+
+
+static PyObject*
+reorder(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  gchar *method="forsyth";
+  ElementCoords data;
+  GPtrArray *vertices, *faces;
+  gint *order, *vindex;
+  gint i, j, v, N, Nv, n;
+
+  static char *kwlist[] = {"method", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &method) ) {
+    return NULL;
+  }
+  if( strcmp(method,"forsyth")!=0 && strcmp(method,"hilbert")!=0 ) {
+    PyErr_SetString(PyExc_ValueError,"method must be 'forsyth' or 'hilbert'");
+    return NULL;
+  }
+
+  /* Gather the elements in their GTS order */
+  order_clear(self);
+  if( (N=face_coords_gather(self,&data,TRUE)) < 0 ) {
+    return NULL;
+  }
+  Nv = g_hash_table_size(data.vertices);
+  vertices = g_ptr_array_sized_new(Nv);
+  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			     (GtsFunc)gather_element,vertices);
+  faces = g_ptr_array_sized_new(N);
+  gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			   (GtsFunc)gather_element,faces);
+
+  order = g_new(gint,N+1);
+  if( strcmp(method,"forsyth")==0 ) {
+    forsyth_order(&data,Nv,order);
+  }
+  else {
+    hilbert_order(&data,order);
+  }
+
+  /* Vertices are ordered by their first use */
+  self->order.faces = g_new(GtsFace*,N+1);
+  self->order.vertices = g_new(GtsVertex*,Nv+1);
+  vindex = g_new(gint,Nv+1);
+  for(v=0;v<Nv;v++) vindex[v] = -1;
+  for(i=0,n=0;i<N;i++) {
+    self->order.faces[i] = GTS_FACE(g_ptr_array_index(faces,order[i]));
+    for(j=0;j<3;j++) {
+      v = data.indices[3*order[i]+j];
+      if(vindex[v]<0) {
+	vindex[v] = n;
+	self->order.vertices[n++] = GTS_VERTEX(g_ptr_array_index(vertices,v));
+      }
+    }
+  }
+  self->order.nfaces = N;
+  self->order.nvertices = n;
+  self->order.version = self->version;
+
+  g_free(vindex);
+  g_free(order);
+  g_ptr_array_free(vertices,TRUE);
+  g_ptr_array_free(faces,TRUE);
+  element_coords_free(&data);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+static PyObject*
+tessellate(PygtsSurface *self, PyObject *args)
+{
+  SELF_CHECK
+
+  gts_surface_tessellate(PYGTS_SURFACE_AS_GTS_SURFACE(self),NULL,NULL);
+  surface_shared_changed(self);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+/* Helper for refine; stops when any of the criteria given is met */
+typedef struct {
+  gdouble max_cost;
+  gint max_faces;
+  GtsSurface *s;
+} RefineStop;
+
+static gboolean
+refine_stop(gdouble cost, guint nedge, RefineStop *stop)
+{
+  /* The GTS default cost is minus the squared edge length */
+  if( gts_coarsen_stop_cost(cost,nedge,&(stop->max_cost)) ) return TRUE;
+  if( stop->max_faces>=0 && gts_surface_face_number(stop->s)>=stop->max_faces )
+    return TRUE;
+  return FALSE;
+}
+
+
+/* Helper for refine; remembers the last Edge split for the curvature cost */
+typedef struct {
+  GtsSurface *s;
+  GtsVertex *v1, *v2, *v;
+  gdouble angle;
+} RefineCurvature;
+
+/* Helper for refine; the angle between the normals of the two faces on e */
+static gdouble
+refine_dihedral(GtsEdge *e, GtsSurface *s)
+{
+  GtsFace *f1, *f2;
+  GtsVector n1, n2, c;
+
+  if( !gts_edge_manifold_faces(e,s,&f1,&f2) ) return 0.;
+
+  gts_triangle_normal(GTS_TRIANGLE(f1),&n1[0],&n1[1],&n1[2]);
+  gts_triangle_normal(GTS_TRIANGLE(f2),&n2[0],&n2[1],&n2[2]);
+  c[0] = n1[1]*n2[2]-n1[2]*n2[1];
+  c[1] = n1[2]*n2[0]-n1[0]*n2[2];
+  c[2] = n1[0]*n2[1]-n1[1]*n2[0];
+  return atan2(sqrt(c[0]*c[0]+c[1]*c[1]+c[2]*c[2]),
+	       n1[0]*n2[0]+n1[1]*n2[1]+n1[2]*n2[2]);
+}
+
+/* Helper for refine; minus the edge length times the dihedral angle.
+ *
+ * GTS costs the Edges made by a split before their Faces exist.  A split
+ * at the midpoint does not change the shape, so the halves of the split
+ * Edge keep its angle and the Edges across the old Faces are flat.
+ */
+static gdouble
+refine_curvature_cost(GtsEdge *e, RefineCurvature *data)
+{
+  GtsVertex *v1=GTS_SEGMENT(e)->v1, *v2=GTS_SEGMENT(e)->v2;
+  gdouble angle;
+
+  if(gts_edge_face_number(e,data->s)==2) {
+    angle = refine_dihedral(e,data->s);
+  }
+  else if( (v1==data->v && (v2==data->v1 || v2==data->v2)) ||
+	   (v2==data->v && (v1==data->v1 || v1==data->v2)) ) {
+    angle = data->angle;
+  }
+  else {
+    angle = 0.;
+  }
+  return -gts_point_distance(GTS_POINT(v1),GTS_POINT(v2))*angle;
+}
+
+/* Helper for refine; splits e at its midpoint and remembers it */
+static GtsVertex*
+refine_curvature_split(GtsEdge *e, GtsVertexClass *klass,
+		       RefineCurvature *data)
+{
+  data->v1 = GTS_SEGMENT(e)->v1;
+  data->v2 = GTS_SEGMENT(e)->v2;
+  data->angle = refine_dihedral(e,data->s);
+  data->v = gts_segment_midvertex(GTS_SEGMENT(e),klass);
+  return data->v;
+}
+
+
+static PyObject*
+refine(PygtsSurface *self, PyObject *args, PyObject *kwds)
+{
+  gdouble max_edge_length=-1., max_cost=-1.;
+  gint max_faces=-1;
+  const char *cost=NULL;
+  gboolean curvature=FALSE;
+  RefineStop stop;
+  RefineCurvature data;
+
+  static char *kwlist[] = {"max_edge_length", "max_faces", "cost",
+			   "max_cost", NULL};
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|disd", kwlist,
+				   &max_edge_length, &max_faces,
+				   &cost, &max_cost) ) {
+    return NULL;
+  }
+
+  if(cost!=NULL) {
+    if(strcmp(cost,"curvature")==0) {
+      curvature = TRUE;
+    }
+    else if(strcmp(cost,"length")!=0) {
+      PyErr_SetString(PyExc_ValueError,
+		      "cost must be 'length' or 'curvature'");
+      return NULL;
+    }
+  }
+
+  if(max_edge_length<0. && max_cost<0. && max_faces<0) {
+    PyErr_SetString(PyExc_TypeError,
+		    "expected at least one of max_edge_length, max_cost "
+		    "or max_faces");
+    return NULL;
+  }
+  if(max_edge_length>=0. && max_cost>=0.) {
+    PyErr_SetString(PyExc_TypeError,
+		    "expected only one of max_edge_length or max_cost");
+    return NULL;
+  }
+  if(curvature && max_edge_length>=0.) {
+    PyErr_SetString(PyExc_ValueError,
+		    "max_edge_length needs cost='length'; use max_cost");
+    return NULL;
+  }
+  if(max_edge_length==0.) {
+    PyErr_SetString(PyExc_ValueError,"max_edge_length must be positive");
+    return NULL;
+  }
+  if(max_cost==0.) {
+    PyErr_SetString(PyExc_ValueError,"max_cost must be positive");
+    return NULL;
+  }
+
+  /* Both costs are negated so that the largest is split first */
+  if(max_edge_length>0.) max_cost = max_edge_length;
+  if(max_cost<0.) stop.max_cost = 0.;
+  else if(curvature) stop.max_cost = -max_cost;
+  else stop.max_cost = -max_cost*max_cost;
+  stop.max_faces = max_faces;
+  stop.s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+
+  /* Make the call; the costliest edges are split at their midpoints first */
+  if(curvature) {
+    data.s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+    data.v1 = data.v2 = data.v = NULL;
+    data.angle = 0.;
+    gts_surface_refine(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+		       (GtsKeyFunc)refine_curvature_cost, &data,
+		       (GtsRefineFunc)refine_curvature_split, &data,
+		       (GtsStopFunc)refine_stop, &stop);
+  }
+  else {
+    gts_surface_refine(PYGTS_SURFACE_AS_GTS_SURFACE(self), NULL, NULL,
+		       NULL, NULL, (GtsStopFunc)refine_stop, &stop);
+  }
+  surface_shared_changed(self);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+/* Helper function for inter() */
+void
+get_largest_coord(GtsVertex *v,gdouble *val) {
+  if( fabs(GTS_POINT(v)->x) > *val ) *val = fabs(GTS_POINT(v)->x);
+  if( fabs(GTS_POINT(v)->y) > *val ) *val = fabs(GTS_POINT(v)->y);
+  if( fabs(GTS_POINT(v)->z) > *val ) *val = fabs(GTS_POINT(v)->z);
+}
+
+/* Helper function for intersection operations */
+static PyObject*
+inter(PygtsSurface *self, PyObject *args, GtsBooleanOperation op1,
+      GtsBooleanOperation op2)
+{
+  PyObject *obj;
+  PyObject *s_;
+  PygtsSurface *s;
+  GtsSurface *surface;
+  GtsVector cm1, cm2;
+  gdouble area1, area2;
+  GtsSurfaceInter *si;
+  GNode *tree1, *tree2;
+  gboolean is_open1, is_open2, closed;
+  gdouble eps=0.;
+
+  /* Parse the args */  
+  if(! PyArg_ParseTuple(args, "O", &s_) )
+    return NULL;
+
+  /* Convert to PygtsObjects */
+  if(!pygts_surface_check(s_)) {
+    PyErr_SetString(PyExc_TypeError,"expected a Surface");
+    return NULL;
+  }
+  s = PYGTS_SURFACE(s_);
+
+  /* Make sure that we don't have two pointers to the same surface */
+  if( self == s ) {
+      PyErr_SetString(PyExc_RuntimeError,
+		      "can't determine intersection with self");
+      return NULL;
+  }
+
+  /* Check for self-intersections in either surface */
+  if( surface_is_self_intersecting(self) ) {
+    PyErr_SetString(PyExc_RuntimeError,"Surface is self-intersecting");
+    return NULL;
+  }
+  if( surface_is_self_intersecting(s) ) {
+    PyErr_SetString(PyExc_RuntimeError,"Surface is self-intersecting");
+    return NULL;
+  }
+
+  /* Avoid complete self-intersection of two surfaces*/
+  if( (gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
+      gts_surface_face_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
+      (gts_surface_edge_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
+       gts_surface_edge_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
+      (gts_surface_vertex_number(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
+       gts_surface_vertex_number(PYGTS_SURFACE_AS_GTS_SURFACE(s))) &&
+      (gts_surface_area(PYGTS_SURFACE_AS_GTS_SURFACE(self)) ==
+       gts_surface_area(PYGTS_SURFACE_AS_GTS_SURFACE(s))) ) {
+
+    area1 = \
+      gts_surface_center_of_area(PYGTS_SURFACE_AS_GTS_SURFACE(self),cm1);
+
+    area2 = \
+      gts_surface_center_of_area(PYGTS_SURFACE_AS_GTS_SURFACE(s),cm2);
+
+    if( (area1==area2) && (cm1[0]==cm2[0]) && (cm1[1]==cm2[1]) && 
+	(cm1[2]==cm2[2]) ) {
+      PyErr_SetString(PyExc_RuntimeError,"Surfaces mutually intersect");
+      return NULL;
+    }
+  }
+
+  /* Get bounding boxes */
+  if( (tree1=gts_bb_tree_surface(PYGTS_SURFACE_AS_GTS_SURFACE(self)))
+      ==NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create tree");
+    return NULL;
+  }
+  is_open1 = !surface_is_closed(self);
+  if( (tree2=gts_bb_tree_surface(PYGTS_SURFACE_AS_GTS_SURFACE(s)))
+      ==NULL ) {
+    gts_bb_tree_destroy(tree1, TRUE);
+    PyErr_SetString(PyExc_MemoryError,"could not create tree");
+    return NULL;
+  }
+  is_open2 = !gts_surface_is_closed(PYGTS_SURFACE_AS_GTS_SURFACE(s));
+
+  /* Get the surface intersection object */
+  if( (si = gts_surface_inter_new(gts_surface_inter_class(),
+				  PYGTS_SURFACE_AS_GTS_SURFACE(self),
+				  PYGTS_SURFACE_AS_GTS_SURFACE(s),
+				  tree1, tree2, is_open1, is_open2))==NULL) {
+    gts_bb_tree_destroy(tree1, TRUE);
+    gts_bb_tree_destroy(tree2, TRUE);
+    PyErr_SetString(PyExc_RuntimeError,"could not create GtsSurfaceInter");
+    return NULL;
+  }
+  gts_bb_tree_destroy(tree1, TRUE);
+  gts_bb_tree_destroy(tree2, TRUE);
+
+  /* Check that the surface intersection object is closed  */
+  gts_surface_inter_check(si,&closed);
+  if( closed == FALSE ) {
+    gts_object_destroy(GTS_OBJECT(si));
     PyErr_SetString(PyExc_RuntimeError,"result is not closed");
     return NULL;
   }
 
-  /* Create the surface */
-  if( (surface = gts_surface_new(gts_surface_class(), gts_face_class(),
-				 gts_edge_class(), gts_vertex_class()))
-      == NULL )  {
-    PyErr_SetString(PyExc_MemoryError, "could not create Surface");
+  /* Create the surface */
+  if( (surface = gts_surface_new(gts_surface_class(), gts_face_class(),
+				 gts_edge_class(), gts_vertex_class()))
+      == NULL )  {
+    PyErr_SetString(PyExc_MemoryError, "could not create Surface");
+    return NULL;
+  }
+
+  /* Calculate the new surface */
+  gts_surface_inter_boolean(si, surface ,op1);
+  gts_surface_inter_boolean(si, surface ,op2);
+  gts_object_destroy(GTS_OBJECT(si));
+
+  /* Clean up the result */
+  gts_surface_foreach_vertex(surface, (GtsFunc)get_largest_coord, &eps);
+  eps *= pow(2.,-50);
+  pygts_vertex_cleanup(surface,1.e-9);
+  pygts_edge_cleanup(surface);
+  pygts_face_cleanup(surface);
+
+  /* Check for self-intersection */
+  if( gts_surface_is_self_intersecting(surface) != NULL ) {
+    gts_object_destroy(GTS_OBJECT(surface));
+    PyErr_SetString(PyExc_RuntimeError,"result is self-intersecting surface");
+    return NULL;
+  }
+
+  /* Create the return Surface */
+  if( (obj = (PyObject*)pygts_surface_new(surface)) == NULL ) {
+    gts_object_destroy(GTS_OBJECT(surface));
+    return NULL;
+  }
+
+  return obj;
+}
+
+
+static PyObject*
+intersection(PygtsSurface *self, PyObject *args, GtsBooleanOperation op1,
+	     GtsBooleanOperation op2)
+{
+  SELF_CHECK
+  return inter(self,args,GTS_1_IN_2,GTS_2_IN_1);
+}
+
+
+static PyObject*
+pygts_union(PygtsSurface *self, PyObject *args)
+{
+  SELF_CHECK
+  return inter(self,args,GTS_1_OUT_2,GTS_2_OUT_1);
+}
+
+
+static PyObject*
+difference(PygtsSurface *self, PyObject *args)
+{
+  SELF_CHECK
+  return inter(self,args,GTS_1_OUT_2,GTS_2_IN_1);
+}
+
+
+/* Helpers for the transforms.  The vertices are gathered once and their
+ * coordinates are transformed in contiguous arrays before being 
+ * scattered back.
+ */
+
+/* Applies the affine part of m to n points.  There are no dependencies 
+ * between iterations, which leaves the loop free to be vectorized.
+ */
+static void
+transform_coords(gdouble *x, gdouble *y, gdouble *z, guint n, GtsMatrix *m)
+{
+  const gdouble m00=m[0][0], m01=m[0][1], m02=m[0][2], m03=m[0][3],
+    m10=m[1][0], m11=m[1][1], m12=m[1][2], m13=m[1][3],
+    m20=m[2][0], m21=m[2][1], m22=m[2][2], m23=m[2][3];
+  gdouble xi, yi, zi;
+  guint i;
+
+  for(i=0;i<n;i++) {
+    xi = x[i]; yi = y[i]; zi = z[i];
+    x[i] = m00*xi + m01*yi + m02*zi + m03;
+    y[i] = m10*xi + m11*yi + m12*zi + m13;
+    z[i] = m20*xi + m21*yi + m22*zi + m23;
+  }
+}
+
+
+/* Transforms all of the vertices of s by m in a single pass */
+static gint
+surface_transform(GtsSurface *s, GtsMatrix *m)
+{
+  GPtrArray *vertices;
+  GtsPoint *p;
+  gdouble *x, *y, *z;
+  guint i, n;
+  PyObject *o;
+
+  vertices = g_ptr_array_new();
+  gts_surface_foreach_vertex(s,(GtsFunc)gather_vertex,vertices);
+  if( (n=vertices->len) == 0 ) {
+    g_ptr_array_free(vertices,TRUE);
+    return 0;
+  }
+
+  if( (x = g_try_new(gdouble,3*n)) == NULL ) {
+    g_ptr_array_free(vertices,TRUE);
+    PyErr_SetString(PyExc_MemoryError,"could not allocate coordinates");
+    return -1;
+  }
+  y = x + n;
+  z = y + n;
+
+  for(i=0;i<n;i++) {
+    p = GTS_POINT(g_ptr_array_index(vertices,i));
+    x[i] = p->x; y[i] = p->y; z[i] = p->z;
+  }
+  transform_coords(x,y,z,n,m);
+  for(i=0;i<n;i++) {
+    p = GTS_POINT(g_ptr_array_index(vertices,i));
+    p->x = x[i]; p->y = y[i]; p->z = z[i];
+  }
+
+  /* Mark s, and any other Surface on the vertices, as moved */
+  o = (PyObject*)g_hash_table_lookup(obj_table,s);
+  if( o!=NULL && PyObject_TypeCheck(o,&PygtsSurfaceType) ) {
+    PYGTS_SURFACE_MOVED(o);
+  }
+  for(i=0;i<n;i++) {
+    vertex_foreach_surface(GTS_VERTEX(g_ptr_array_index(vertices,i)),s,
+			   surface_moved);
+  }
+
+  g_free(x);
+  g_ptr_array_free(vertices,TRUE);
+  return 0;
+}
+
+
+/* The Surface, if any, with a pending transform.  Transforms are
+ * accumulated as a matrix and only applied to the vertices when the
+ * coordinates are needed.  Only one Surface may have a pending 
+ * transform at a time, so that the order of transforms is kept when 
+ * vertices are shared.
+ */
+static PygtsSurface *pending = NULL;
+
+gint
+pygts_surface_apply_pending_transform(void)
+{
+  PygtsSurface *self;
+
+  if( (self=pending) == NULL ) return 0;
+
+  if( surface_transform(PYGTS_SURFACE_AS_GTS_SURFACE(self),
+			self->transform) == -1 ) {
+    return -1;
+  }
+  gts_matrix_destroy(self->transform);
+  self->transform = NULL;
+  pending = NULL;
+
+  return 0;
+}
+
+
+/* Composes m after any pending transform on self */
+static gint
+surface_defer_transform(PygtsSurface *self, GtsMatrix *m)
+{
+  GtsMatrix *product;
+
+  if( pending!=self && pygts_surface_apply_pending_transform()==-1 ) {
+    return -1;
+  }
+
+  /* Transforms are affine */
+  m[3][0] = 0; m[3][1] = 0; m[3][2] = 0; m[3][3] = 1;
+
+  if( self->transform == NULL ) {
+    self->transform = gts_matrix_identity(NULL);
+  }
+  if( (product = gts_matrix_product(m,self->transform)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create matrix");
+    return -1;
+  }
+  gts_matrix_destroy(self->transform);
+  self->transform = product;
+  pending = self;
+
+  return 0;
+}
+
+
+/* Reads a 4x4 matrix from a nested sequence */
+static gint
+matrix_from_sequence(PyObject *o, GtsMatrix *m)
+{
+  PyObject *row, *item;
+  guint i, j;
+
+  if( !PySequence_Check(o) || PySequence_Size(o)!=4 ) {
+    PyErr_SetString(PyExc_TypeError,"expected a 4x4 matrix");
+    return -1;
+  }
+  for(i=0;i<4;i++) {
+    row = PySequence_GetItem(o,i);
+    if( row==NULL || !PySequence_Check(row) || PySequence_Size(row)!=4 ) {
+      Py_XDECREF(row);
+      PyErr_SetString(PyExc_TypeError,"expected a 4x4 matrix");
+      return -1;
+    }
+    for(j=0;j<4;j++) {
+      item = PySequence_GetItem(row,j);
+      m[i][j] = item==NULL ? -1 : PyFloat_AsDouble(item);
+      Py_XDECREF(item);
+      if( PyErr_Occurred() ) {
+	Py_DECREF(row);
+	PyErr_SetString(PyExc_TypeError,"expected a 4x4 matrix of floats");
+	return -1;
+      }
+    }
+    Py_DECREF(row);
+  }
+  return 0;
+}
+
+
+/* True if o looks like a stack of matrices rather than a single one */
+static gboolean
+matrix_is_stack(PyObject *o)
+{
+  PyObject *row, *item;
+  gboolean ret = FALSE;
+
+  if( !PySequence_Check(o) || PySequence_Size(o)<1 ) return FALSE;
+  if( (row = PySequence_GetItem(o,0)) == NULL ) {
+    PyErr_Clear();
+    return FALSE;
+  }
+  if( PySequence_Check(row) && PySequence_Size(row)>0 ) {
+    if( (item = PySequence_GetItem(row,0)) != NULL ) {
+      ret = PySequence_Check(item);
+      Py_DECREF(item);
+    }
+    else {
+      PyErr_Clear();
+    }
+  }
+  Py_DECREF(row);
+  return ret;
+}
+
+
+static PyObject*
+transform(PygtsSurface* self, PyObject *args)
+{
+  PyObject *o, *tuple, *obj;
+  GtsMatrix *m;
+  GtsSurface *s;
+  guint i, N;
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTuple(args, "O", &o) ) {
+    return NULL;
+  }
+
+  /* A single matrix transforms this Surface */
+  if( !matrix_is_stack(o) ) {
+    m = gts_matrix_identity(NULL);
+    if( matrix_from_sequence(o,m)==-1 || 
+	surface_defer_transform(self,m)==-1 ) {
+      gts_matrix_destroy(m);
+      return NULL;
+    }
+    gts_matrix_destroy(m);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  /* A stack of matrices gives transformed copies */
+  if( pygts_surface_apply_pending_transform()==-1 ) {
+    return NULL;
+  }
+  N = PySequence_Size(o);
+  if( (tuple=PyTuple_New(N)) == NULL) {
+    PyErr_SetString(PyExc_MemoryError,"could not create tuple");
+    return NULL;
+  }
+  m = gts_matrix_identity(NULL);
+  for(i=0;i<N;i++) {
+    if( (obj = PySequence_GetItem(o,i)) == NULL ) {
+      gts_matrix_destroy(m);
+      Py_DECREF(tuple);
+      return NULL;
+    }
+    if( matrix_from_sequence(obj,m)==-1 ) {
+      Py_DECREF(obj);
+      gts_matrix_destroy(m);
+      Py_DECREF(tuple);
+      return NULL;
+    }
+    Py_DECREF(obj);
+
+    if( (s = gts_surface_new(gts_surface_class(), gts_face_class(),
+			     gts_edge_class(), gts_vertex_class())) == NULL ) {
+      gts_matrix_destroy(m);
+      Py_DECREF(tuple);
+      PyErr_SetString(PyExc_MemoryError, "could not create Surface");
+      return NULL;
+    }
+    gts_surface_copy(s,PYGTS_SURFACE_AS_GTS_SURFACE(self));
+    if( surface_transform(s,m) == -1 ) {
+      gts_object_destroy(GTS_OBJECT(s));
+      gts_matrix_destroy(m);
+      Py_DECREF(tuple);
+      return NULL;
+    }
+    if( (obj = (PyObject*)pygts_surface_new(s)) == NULL ) {
+      gts_object_destroy(GTS_OBJECT(s));
+      gts_matrix_destroy(m);
+      Py_DECREF(tuple);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(tuple,i,obj);
+  }
+  gts_matrix_destroy(m);
+
+  return tuple;
+}
+
+
+static PyObject*
+rotate(PygtsSurface* self, PyObject *args, PyObject *keywds)
+{
+  static char *kwlist[] = {"dx", "dy", "dz", "a", NULL};
+  gdouble dx=0,dy=0,dz=0,a=0;
+  GtsMatrix *m;
+  GtsVector v;
+  gint ret;
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|dddd", kwlist,
+				   &dx, &dy, &dz, &a) ) {
     return NULL;
   }
 
-  /* Calculate the new surface */
-  gts_surface_inter_boolean(si, surface ,op1);
-  gts_surface_inter_boolean(si, surface ,op2);
-  gts_object_destroy(GTS_OBJECT(si));
+  v[0] = dx; v[1] = dy; v[2] = dz;
+  if( (m = gts_matrix_rotate(NULL,v,a)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create matrix");
+    return NULL;
+  }
+  ret = surface_defer_transform(self,m);
+  gts_matrix_destroy(m);
+  if(ret==-1) return NULL;
 
-  /* Clean up the result */
-  gts_surface_foreach_vertex(surface, (GtsFunc)get_largest_coord, &eps);
-  eps *= pow(2.,-50);
-  pygts_vertex_cleanup(surface,1.e-9);
-  pygts_edge_cleanup(surface);
-  pygts_face_cleanup(surface);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-  /* Check for self-intersection */
-  if( gts_surface_is_self_intersecting(surface) != NULL ) {
-    gts_object_destroy(GTS_OBJECT(surface));
-    PyErr_SetString(PyExc_RuntimeError,"result is self-intersecting surface");
+
+static PyObject*
+scale(PygtsSurface* self, PyObject *args, PyObject *keywds)
+{
+  static char *kwlist[] = {"dx", "dy", "dz", NULL};
+  gdouble dx=1,dy=1,dz=1;
+  GtsMatrix *m;
+  GtsVector v;
+  gint ret;
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|ddd", kwlist,
+				   &dx, &dy, &dz) ) {
     return NULL;
   }
 
-  /* Create the return Surface */
-  if( (obj = (PyObject*)pygts_surface_new(surface)) == NULL ) {
-    gts_object_destroy(GTS_OBJECT(surface));
+  v[0] = dx; v[1] = dy; v[2] = dz;
+  if( (m = gts_matrix_scale(NULL,v)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create matrix");
     return NULL;
   }
+  ret = surface_defer_transform(self,m);
+  gts_matrix_destroy(m);
+  if(ret==-1) return NULL;
 
-  return obj;
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
 
 static PyObject*
-intersection(PygtsSurface *self, PyObject *args, GtsBooleanOperation op1,
-	     GtsBooleanOperation op2)
+translate(PygtsSurface* self, PyObject *args, PyObject *keywds)
 {
+  static char *kwlist[] = {"dx", "dy", "dz", NULL};
+  gdouble dx=0,dy=0,dz=0;
+  GtsMatrix *m;
+  GtsVector v;
+  gint ret;
+
   SELF_CHECK
-  return inter(self,args,GTS_1_IN_2,GTS_2_IN_1);
+
+  /* Parse the args */
+  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|ddd", kwlist,
+				   &dx, &dy, &dz) ) {
+    return NULL;
+  }
+
+  v[0] = dx; v[1] = dy; v[2] = dz;
+  if( (m = gts_matrix_translate(NULL,v)) == NULL ) {
+    PyErr_SetString(PyExc_MemoryError,"could not create matrix");
+    return NULL;
+  }
+  ret = surface_defer_transform(self,m);
+  gts_matrix_destroy(m);
+  if(ret==-1) return NULL;
+
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
 
 static PyObject*
-pygts_union(PygtsSurface *self, PyObject *args)
+is_self_intersecting(PygtsSurface *self, PyObject *args)
 {
   SELF_CHECK
-  return inter(self,args,GTS_1_OUT_2,GTS_2_OUT_1);
+
+  if( surface_is_self_intersecting(self) ) {
+    Py_INCREF(Py_True);
+    return Py_True;
+  }
+  else {
+    Py_INCREF(Py_False);
+    return Py_False;
+  }  
 }
 
 
+#if PYGTS_HAS_NUMPY
 static PyObject*
-difference(PygtsSurface *self, PyObject *args)
+self_intersections(PygtsSurface *self, PyObject *args)
 {
+  GArray *pairs;
+  PyArrayObject *a;
+  npy_intp dims[2];
+  gint *p;
+  guint k;
+
   SELF_CHECK
-  return inter(self,args,GTS_1_OUT_2,GTS_2_IN_1);
+
+  pairs = surface_self_intersections(self,FALSE);
+
+  dims[0] = pairs->len;
+  dims[1] = 2;
+  if( (a = (PyArrayObject*)PyArray_SimpleNew(2,dims,PyArray_INT)) == NULL ) {
+    g_array_free(pairs,TRUE);
+    return NULL;
+  }
+  p = (gint*)a->data;
+  for(k=0;k<pairs->len;k++) {
+    p[2*k] = g_array_index(pairs,IntersectPair,k).i;
+    p[2*k+1] = g_array_index(pairs,IntersectPair,k).j;
+  }
+  g_array_free(pairs,TRUE);
+
+  return (PyObject*)a;
+}
+#endif /* PYGTS_HAS_NUMPY */
+
+
+static PyObject*
+cleanup(PygtsSurface *self, PyObject *args)
+{
+  GtsSurface *s;
+  gdouble threshold = 0.;
+
+  SELF_CHECK
+
+  /* Parse the args */
+  if(! PyArg_ParseTuple(args,"|d", &threshold) ) {
+    return NULL;
+  }
+
+  s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
+
+  /* Do the cleanup */
+  if( threshold != 0. ) {
+    pygts_vertex_cleanup(s,threshold);
+  }
+  pygts_edge_cleanup(s);
+  pygts_face_cleanup(s);
+  surface_shared_changed(self);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+/* Helpers for coarsen with the quadric error metric.  Each vertex has a
+ * symmetric 4x4 quadric q (10 unique elements) that sums the squared
+ * distances to the planes of its faces.
+ */
+#define QUADRIC_BOUNDARY_WEIGHT 100.
+
+static void
+quadric_add_plane(gdouble *q, gdouble a, gdouble b, gdouble c, gdouble d,
+		  gdouble w)
+{
+  q[0] += w*a*a; q[1] += w*a*b; q[2] += w*a*c; q[3] += w*a*d;
+  q[4] += w*b*b; q[5] += w*b*c; q[6] += w*b*d;
+  q[7] += w*c*c; q[8] += w*c*d;
+  q[9] += w*d*d;
+}
+
+static gdouble*
+quadric_lookup(GHashTable *quadrics, GtsVertex *v)
+{
+  gdouble *q;
+
+  if( (q = g_hash_table_lookup(quadrics,v)) == NULL ) {
+    q = g_new0(gdouble,10);
+    g_hash_table_insert(quadrics,v,q);
+  }
+  return q;
+}
+
+static void
+quadric_add_face(GtsTriangle *t, GHashTable *quadrics)
+{
+  GtsVertex *v1, *v2, *v3;
+  gdouble a, b, c, norm;
+
+  gts_triangle_normal(t,&a,&b,&c);
+  if( (norm = sqrt(a*a+b*b+c*c)) == 0. ) return;
+  a /= norm; b /= norm; c /= norm;
+
+  gts_triangle_vertices(t,&v1,&v2,&v3);
+  norm = -(a*GTS_POINT(v1)->x + b*GTS_POINT(v1)->y + c*GTS_POINT(v1)->z);
+  quadric_add_plane(quadric_lookup(quadrics,v1),a,b,c,norm,1.);
+  quadric_add_plane(quadric_lookup(quadrics,v2),a,b,c,norm,1.);
+  quadric_add_plane(quadric_lookup(quadrics,v3),a,b,c,norm,1.);
+}
+
+typedef struct {
+  GHashTable *quadrics;
+  GtsSurface *s;
+} QuadricData;
+
+/* Boundary edges get a heavily-weighted plane perpendicular to their face
+ * so that the boundary is preserved.
+ */
+static void
+quadric_add_boundary(GtsEdge *e, QuadricData *data)
+{
+  GtsFace *f;
+  GtsVertex *v1, *v2;
+  gdouble nx, ny, nz, ex, ey, ez, a, b, c, d, norm;
+
+  if( (f = gts_edge_is_boundary(e,data->s)) == NULL ) return;
+
+  gts_triangle_normal(GTS_TRIANGLE(f),&nx,&ny,&nz);
+  v1 = GTS_SEGMENT(e)->v1;
+  v2 = GTS_SEGMENT(e)->v2;
+  ex = GTS_POINT(v2)->x - GTS_POINT(v1)->x;
+  ey = GTS_POINT(v2)->y - GTS_POINT(v1)->y;
+  ez = GTS_POINT(v2)->z - GTS_POINT(v1)->z;
+  a = ey*nz - ez*ny;
+  b = ez*nx - ex*nz;
+  c = ex*ny - ey*nx;
+  if( (norm = sqrt(a*a+b*b+c*c)) == 0. ) return;
+  a /= norm; b /= norm; c /= norm;
+  d = -(a*GTS_POINT(v1)->x + b*GTS_POINT(v1)->y + c*GTS_POINT(v1)->z);
+
+  quadric_add_plane(quadric_lookup(data->quadrics,v1),a,b,c,d,
+		    QUADRIC_BOUNDARY_WEIGHT);
+  quadric_add_plane(quadric_lookup(data->quadrics,v2),a,b,c,d,
+		    QUADRIC_BOUNDARY_WEIGHT);
+}
+
+static gdouble
+quadric_error(gdouble *q, gdouble x, gdouble y, gdouble z)
+{
+  return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+    + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+    + q[7]*z*z + 2*q[8]*z
+    + q[9];
+}
+
+/* Sums the quadrics of the end-points of e into q, and returns the 
+ * position in p that minimizes the error and the error itself.
+ */
+static gdouble
+quadric_collapse(GtsEdge *e, GHashTable *quadrics, gdouble *q, gdouble *p)
+{
+  GtsPoint *p1, *p2;
+  gdouble *q1, *q2, det, err, best, c[3][3], l2;
+  guint i;
+
+  p1 = GTS_POINT(GTS_SEGMENT(e)->v1);
+  p2 = GTS_POINT(GTS_SEGMENT(e)->v2);
+  q1 = quadric_lookup(quadrics,GTS_SEGMENT(e)->v1);
+  q2 = quadric_lookup(quadrics,GTS_SEGMENT(e)->v2);
+  for(i=0;i<10;i++) q[i] = q1[i]+q2[i];
+
+  /* Solve for the optimal position using Cramer's rule.  Solutions far
+   * from the edge come from nearly singular quadrics, and are rejected.
+   */
+  det = q[0]*(q[4]*q[7]-q[5]*q[5]) - q[1]*(q[1]*q[7]-q[5]*q[2])
+    + q[2]*(q[1]*q[5]-q[4]*q[2]);
+  if( fabs(det) > 1.e-10 ) {
+    p[0] = -( q[3]*(q[4]*q[7]-q[5]*q[5]) - q[1]*(q[6]*q[7]-q[5]*q[8])
+	      + q[2]*(q[6]*q[5]-q[4]*q[8]) )/det;
+    p[1] = -( q[0]*(q[6]*q[7]-q[8]*q[5]) - q[3]*(q[1]*q[7]-q[5]*q[2])
+	      + q[2]*(q[1]*q[8]-q[6]*q[2]) )/det;
+    p[2] = -( q[0]*(q[4]*q[8]-q[5]*q[6]) - q[1]*(q[1]*q[8]-q[6]*q[2])
+	      + q[3]*(q[1]*q[5]-q[4]*q[2]) )/det;
+    l2 = gts_point_distance2(p1,p2);
+    if( (p[0]-(p1->x+p2->x)/2)*(p[0]-(p1->x+p2->x)/2)
+	+ (p[1]-(p1->y+p2->y)/2)*(p[1]-(p1->y+p2->y)/2)
+	+ (p[2]-(p1->z+p2->z)/2)*(p[2]-(p1->z+p2->z)/2) <= 4*l2 ) {
+      return fabs(quadric_error(q,p[0],p[1],p[2]));
+    }
+  }
+
+  /* Otherwise choose the best of the end- and mid-points */
+  c[0][0] = p1->x; c[0][1] = p1->y; c[0][2] = p1->z;
+  c[1][0] = p2->x; c[1][1] = p2->y; c[1][2] = p2->z;
+  c[2][0] = (p1->x+p2->x)/2; c[2][1] = (p1->y+p2->y)/2;
+  c[2][2] = (p1->z+p2->z)/2;
+  best = G_MAXDOUBLE;
+  for(i=0;i<3;i++) {
+    if( (err = fabs(quadric_error(q,c[i][0],c[i][1],c[i][2]))) < best ) {
+      best = err;
+      p[0] = c[i][0]; p[1] = c[i][1]; p[2] = c[i][2];
+    }
+  }
+  return best;
+}
+
+static gdouble
+quadric_cost(GtsEdge *e, GHashTable *quadrics)
+{
+  gdouble q[10], p[3];
+
+  return quadric_collapse(e,quadrics,q,p);
+}
+
+static GtsVertex*
+quadric_vertex(GtsEdge *e, GtsVertexClass *klass, GHashTable *quadrics)
+{
+  GtsVertex *v;
+  gdouble q[10], p[3];
+
+  quadric_collapse(e,quadrics,q,p);
+  v = gts_vertex_new(klass,p[0],p[1],p[2]);
+  memcpy(quadric_lookup(quadrics,v),q,10*sizeof(gdouble));
+  return v;
+}
+
+
+/* Helper for coarsen; stops when any of the criteria given is met */
+typedef struct {
+  guint nedges;
+  gdouble max_cost;
+  gint nfaces;
+  GtsSurface *s;
+} CoarsenStop;
+
+static gboolean
+coarsen_stop(gdouble cost, guint nedge, CoarsenStop *stop)
+{
+  if( gts_coarsen_stop_number(cost,nedge,&(stop->nedges)) ) return TRUE;
+  if( stop->max_cost>=0. && gts_coarsen_stop_cost(cost,nedge,&(stop->max_cost)) )
+    return TRUE;
+  if( stop->nfaces>=0 && gts_surface_face_number(stop->s)<=stop->nfaces )
+    return TRUE;
+  return FALSE;
+}
+
+
+/* Helpers for coarsen_partitioned; spatially partitions the faces by
+ * recursive bisection of their centroids.
+ */
+typedef struct {
+  GtsFace *f;
+  gdouble c[3];
+} PartitionFace;
+
+static void
+partition_face_add(GtsTriangle *t, GArray *faces)
+{
+  PartitionFace pf;
+  GtsVertex *v1, *v2, *v3;
+
+  gts_triangle_vertices(t,&v1,&v2,&v3);
+  pf.f = GTS_FACE(t);
+  pf.c[0] = (GTS_POINT(v1)->x+GTS_POINT(v2)->x+GTS_POINT(v3)->x)/3;
+  pf.c[1] = (GTS_POINT(v1)->y+GTS_POINT(v2)->y+GTS_POINT(v3)->y)/3;
+  pf.c[2] = (GTS_POINT(v1)->z+GTS_POINT(v2)->z+GTS_POINT(v3)->z)/3;
+  g_array_append_val(faces,pf);
+}
+
+static guint partition_axis;
+
+static int
+partition_face_compare(const void *a, const void *b)
+{
+  gdouble ca = ((PartitionFace*)a)->c[partition_axis];
+  gdouble cb = ((PartitionFace*)b)->c[partition_axis];
+  return ca<cb ? -1 : (ca>cb ? 1 : 0);
+}
+
+static void
+partition_faces(PartitionFace *faces, guint n, guint npart, guint p0,
+		GHashTable *part)
+{
+  gdouble min[3], max[3];
+  guint i, j, nleft;
+
+  if(npart==1 || n<2) {
+    for(i=0;i<n;i++) {
+      g_hash_table_insert(part,faces[i].f,GUINT_TO_POINTER(p0+1));
+    }
+    return;
+  }
+
+  /* Split across the longest axis of the centroids */
+  for(j=0;j<3;j++) {
+    min[j] = G_MAXDOUBLE;
+    max[j] = -G_MAXDOUBLE;
+  }
+  for(i=0;i<n;i++) {
+    for(j=0;j<3;j++) {
+      if(faces[i].c[j]<min[j]) min[j] = faces[i].c[j];
+      if(faces[i].c[j]>max[j]) max[j] = faces[i].c[j];
+    }
+  }
+  partition_axis = 0;
+  for(j=1;j<3;j++) {
+    if(max[j]-min[j] > max[partition_axis]-min[partition_axis]) {
+      partition_axis = j;
+    }
+  }
+  qsort(faces,n,sizeof(PartitionFace),partition_face_compare);
+
+  nleft = npart/2;
+  i = (guint)(((gdouble)n)*nleft/npart);
+  partition_faces(faces,i,nleft,p0,part);
+  partition_faces(faces+i,n-i,npart-nleft,p0+nleft,part);
+}
+
+#define PARTITION_SHARED GINT_TO_POINTER(-1)
+
+typedef struct {
+  GHashTable *part, *owner, *frozen;
+} PartitionData;
+
+/* Marks the vertices that have faces in more than one partition */
+static void
+partition_mark_shared(GtsTriangle *t, PartitionData *data)
+{
+  GtsVertex *v[3];
+  gpointer p, q;
+  guint i;
+
+  p = g_hash_table_lookup(data->part,t);
+  gts_triangle_vertices(t,&v[0],&v[1],&v[2]);
+  for(i=0;i<3;i++) {
+    if( (q = g_hash_table_lookup(data->owner,v[i])) == NULL ) {
+      g_hash_table_insert(data->owner,v[i],p);
+    }
+    else if( q!=p ) {
+      g_hash_table_insert(data->owner,v[i],PARTITION_SHARED);
+    }
+  }
+}
+
+/* Freezes the vertices of the faces that touch a shared vertex */
+static void
+partition_mark_frozen(GtsTriangle *t, PartitionData *data)
+{
+  GtsVertex *v[3];
+  guint i;
+
+  gts_triangle_vertices(t,&v[0],&v[1],&v[2]);
+  for(i=0;i<3;i++) {
+    if( g_hash_table_lookup(data->owner,v[i]) == PARTITION_SHARED ) {
+      g_hash_table_insert(data->frozen,v[0],v[0]);
+      g_hash_table_insert(data->frozen,v[1],v[1]);
+      g_hash_table_insert(data->frozen,v[2],v[2]);
+      return;
+    }
+  }
 }
 
-
-/* Helper for rotate(), scale() and translate() transforms */
+/* Copies the quadrics of the vertices of a face from one table to another */
 typedef struct {
-  double dx, dy, dz, a;
-  gboolean errflag;
-} TransformData;
+  GHashTable *from, *to;
+} QuadricCopy;
 
-/* Helper for rotate() */
 static void
-rotate_point(GtsPoint *p, TransformData *data)
+quadric_copy_face(GtsTriangle *t, QuadricCopy *data)
 {
-  if(data->errflag) return;
+  GtsVertex *v[3];
+  gdouble *q;
+  guint i;
 
-  if(pygts_point_rotate(p,data->dx,data->dy,data->dz,data->a)==-1)
-    data->errflag=TRUE;
+  gts_triangle_vertices(t,&v[0],&v[1],&v[2]);
+  for(i=0;i<3;i++) {
+    if( g_hash_table_lookup(data->to,v[i]) == NULL &&
+	(q = g_hash_table_lookup(data->from,v[i])) != NULL ) {
+      g_hash_table_insert(data->to,v[i],g_memdup(q,10*sizeof(gdouble)));
+    }
+  }
 }
 
-static PyObject*
-rotate(PygtsSurface* self, PyObject *args, PyObject *keywds)
-{
-  TransformData data;
-  static char *kwlist[] = {"dx", "dy", "dz", "a", NULL};
 
-  SELF_CHECK
+/* Coarsening of one partition.  gts_surface_coarsen() sets and clears 
+ * the global gts_allow_floating_edges around its loop, so concurrent 
+ * calls race on it.  partition_coarsen() is the same loop without 
+ * touching the globals; the caller allows floating edges once around all
+ * of the partitions.  Only the edges of s are ever put on the heap, so 
+ * that the vertices of faces outside of s are never collapsed.
+ */
+static gdouble
+partition_edge_length2(GtsEdge *e)
+{
+  return gts_point_distance2(GTS_POINT(GTS_SEGMENT(e)->v1),
+			     GTS_POINT(GTS_SEGMENT(e)->v2));
+}
 
-  data.dx=0; data.dy=0; data.dz=0; data.a=0;
-  data.errflag = FALSE;
+static void
+partition_heap_insert(GtsEdge *e, GtsEHeap *heap)
+{
+  GTS_OBJECT(e)->reserved = gts_eheap_insert(heap,e);
+}
 
-  /* Parse the args */
-  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|dddd", kwlist,
-				   &(data.dx), &(data.dy), &(data.dz), 
-				   &(data.a)) ) {
-    return NULL;
+static void
+partition_heap_remove(GtsEdge *e, GtsEHeap *heap)
+{
+  if( GTS_OBJECT(e)->reserved!=NULL ) {
+    gts_eheap_remove(heap,GTS_OBJECT(e)->reserved);
+    GTS_OBJECT(e)->reserved = NULL;
   }
-
-  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			     (GtsFunc)rotate_point,&data);
-
-  if(data.errflag) return NULL;
-
-  Py_INCREF(Py_None);
-  return Py_None;
 }
 
-
-/* Helper for scale() */
+/* Recomputes the costs of the edges of s around the neighbours of v */
 static void
-scale_point(GtsPoint *p, TransformData *data)
+partition_heap_update(GtsSurface *s, GtsVertex *v, GtsEHeap *heap)
 {
-  if(data->errflag) return;
-
-  if(pygts_point_scale(p,data->dx,data->dy,data->dz)==-1)
-    data->errflag=TRUE;
+  GSList *i, *j, *edges=NULL;
+  GtsSegment *seg;
+  GtsVertex *u;
+
+  for(i=v->segments; i!=NULL; i=g_slist_next(i)) {
+    if( !GTS_IS_EDGE(i->data) ) continue;
+    seg = GTS_SEGMENT(i->data);
+    u = seg->v1==v ? seg->v2 : seg->v1;
+    for(j=u->segments; j!=NULL; j=g_slist_next(j)) {
+      if( GTS_IS_EDGE(j->data) && g_slist_find(edges,j->data)==NULL &&
+	  gts_edge_has_parent_surface(GTS_EDGE(j->data),s)!=NULL ) {
+	edges = g_slist_prepend(edges,j->data);
+      }
+    }
+  }
+  for(i=edges; i!=NULL; i=g_slist_next(i)) {
+    partition_heap_remove(GTS_EDGE(i->data),heap);
+    partition_heap_insert(GTS_EDGE(i->data),heap);
+  }
+  g_slist_free(edges);
 }
 
-static PyObject*
-scale(PygtsSurface* self, PyObject *args, PyObject *keywds)
+/* Collapses e; returns the new vertex, or NULL if e was not collapsed */
+static GtsVertex*
+partition_collapse(GtsEdge *e, GtsEHeap *heap, GtsCoarsenFunc coarsen_func,
+		   gpointer coarsen_data, GtsVertexClass *klass, 
+		   gdouble maxcosine2)
 {
-  TransformData data;
-  static char *kwlist[] = {"dx", "dy", "dz", NULL};
-
-  SELF_CHECK
+  GtsVertex *v1=GTS_SEGMENT(e)->v1, *v2=GTS_SEGMENT(e)->v2, *mid;
+  GtsEdge *e1, *duplicate;
+  GSList *i;
 
-  data.dx=1; data.dy=1; data.dz=1; data.a=0;
-  data.errflag = FALSE;
-
-  /* Parse the args */
-  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|ddd", kwlist,
-				   &(data.dx), &(data.dy), &(data.dz)) ) {
+  if( v1==v2 ) {
+    gts_object_destroy(GTS_OBJECT(e));
+    return NULL;
+  }
+  if( !gts_edge_collapse_is_valid(e) ) {
+    GTS_OBJECT(e)->reserved = gts_eheap_insert_with_key(heap,e,G_MAXDOUBLE);
+    return NULL;
+  }
+  mid = (*coarsen_func)(e,klass,coarsen_data);
+  if( gts_edge_collapse_creates_fold(e,mid,maxcosine2) ) {
+    GTS_OBJECT(e)->reserved = gts_eheap_insert_with_key(heap,e,G_MAXDOUBLE);
+    gts_object_destroy(GTS_OBJECT(mid));
     return NULL;
   }
 
-  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			     (GtsFunc)scale_point,&data);
-
-  if(data.errflag) return NULL;
-
-  Py_INCREF(Py_None);
-  return Py_None;
+  gts_object_destroy(GTS_OBJECT(e));
+  gts_vertex_replace(v1,mid);
+  gts_object_destroy(GTS_OBJECT(v1));
+  gts_vertex_replace(v2,mid);
+  gts_object_destroy(GTS_OBJECT(v2));
+
+  /* Merge the edges that the collapse made duplicates */
+  i = mid->segments;
+  while(i!=NULL) {
+    e1 = GTS_EDGE(i->data);
+    while( (duplicate = gts_edge_is_duplicate(e1)) != NULL ) {
+      partition_heap_remove(duplicate,heap);
+      gts_edge_replace(duplicate,e1);
+      gts_object_destroy(GTS_OBJECT(duplicate));
+    }
+    i = g_slist_next(i);
+    if( e1->triangles==NULL ) {
+      partition_heap_remove(e1,heap);
+      gts_object_destroy(GTS_OBJECT(e1));
+    }
+  }
+  return mid;
 }
 
-
-/* Helper for translate() */
 static void
-translate_point(GtsPoint *p, TransformData *data)
+partition_coarsen(GtsSurface *s, GtsKeyFunc cost_func, gpointer cost_data,
+		  GtsCoarsenFunc coarsen_func, gpointer coarsen_data,
+		  GtsStopFunc stop_func, gpointer stop_data, gdouble amin)
 {
-  if(data->errflag) return;
+  GtsEHeap *heap;
+  GtsEdge *e;
+  GtsVertex *v;
+  gdouble cost, maxcosine2;
+
+  if( cost_func==NULL ) cost_func = (GtsKeyFunc)partition_edge_length2;
+  if( coarsen_func==NULL ) coarsen_func = (GtsCoarsenFunc)gts_segment_midvertex;
+  maxcosine2 = cos(amin);
+  maxcosine2 *= maxcosine2;
+
+  heap = gts_eheap_new(cost_func,cost_data);
+  gts_eheap_freeze(heap);
+  gts_surface_foreach_edge(s,(GtsFunc)partition_heap_insert,heap);
+  gts_eheap_thaw(heap);
+
+  while( (e = gts_eheap_remove_top(heap,&cost)) != NULL && 
+	 cost<G_MAXDOUBLE &&
+	 !(*stop_func)(cost, gts_eheap_size(heap)-gts_edge_face_number(e,s),
+		       stop_data) ) {
+    v = partition_collapse(e,heap,coarsen_func,coarsen_data,
+			   s->vertex_class,maxcosine2);
+    if( v!=NULL ) {
+      partition_heap_update(s,v,heap);
+    }
+  }
 
-  if(pygts_point_translate(p,data->dx,data->dy,data->dz)==-1)
-    data->errflag=TRUE;
+  /* Leave the reserved fields of the edges as they were */
+  if( e!=NULL ) {
+    GTS_OBJECT(e)->reserved = NULL;
+  }
+  gts_eheap_foreach(heap,(GFunc)gts_object_reset_reserved,NULL);
+  gts_eheap_destroy(heap);
 }
 
-static PyObject*
-translate(PygtsSurface* self, PyObject *args, PyObject *keywds)
-{
-  TransformData data;
-  static char *kwlist[] = {"dx", "dy", "dz", NULL};
-
-  SELF_CHECK
 
-  data.dx=0; data.dy=0; data.dz=0; data.a=0;
-  data.errflag = FALSE;
+/* Helper for coarsen; sets data->shared if f belongs to a surface other
+ * than data->s and the parent that keeps its python Face alive.
+ * Destroying f removes it from all of its surfaces, so such a surface
+ * would be changed by more than one thread.
+ */
+typedef struct {
+  GtsSurface *s;
+  gboolean shared;
+} PartitionShared;
 
-  /* Parse the args */
-  if(! PyArg_ParseTupleAndKeywords(args, keywds,"|ddd", kwlist,
-				   &(data.dx), &(data.dy), &(data.dz)) ) {
-    return NULL;
+static void
+partition_face_shared(GtsFace *f, PartitionShared *data)
+{
+  GSList *i;
+  PygtsObject *face;
+
+  if( data->shared ) return;
+  face = PYGTS_OBJECT(g_hash_table_lookup(obj_table,GTS_OBJECT(f)));
+  for(i=f->surfaces; i!=NULL; i=g_slist_next(i)) {
+    if( i->data==data->s ) continue;
+    if( face!=NULL && i->data==face->gtsobj_parent ) continue;
+    data->shared = TRUE;
+    return;
   }
-
-  /* Make the call */
-  gts_surface_foreach_vertex(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			     (GtsFunc)translate_point,&data);
-
-  if(data.errflag) return NULL;
-
-  Py_INCREF(Py_None);
-  return Py_None;
 }
 
 
-static PyObject*
-is_self_intersecting(PygtsSurface *self, PyObject *args)
+/* Helper for coarsen; coarsens the interiors of npart spatial partitions
+ * of s concurrently.  The vertices shared between partitions and their
+ * neighbours are frozen, so that each thread only changes the vertices,
+ * edges and faces of its own partition, and no thread changes the GTS
+ * globals.  The faces touching a frozen
+ * vertex are kept in a separate surface per partition that is not
+ * coarsened.  The criteria in stop are scaled to the size of each
+ * partition; the caller finishes with a pass over the whole of s.  The
+ * faces of s must not belong to any other surface but their parents.
+ */
+static void
+coarsen_partitioned(GtsSurface *s, gint npart,
+		    GtsKeyFunc cost_func, GtsCoarsenFunc coarsen_func,
+		    gpointer cost_data, gboolean quadric,
+		    CoarsenStop *stop, gdouble amin)
 {
-  GtsSurface *s;
-  gboolean ret = FALSE;
+  GArray *faces;
+  PartitionData data;
+  GtsSurface **interior, **boundary;
+  GHashTable **quadrics=NULL;
+  CoarsenStop *stops;
+  QuadricCopy qcopy;
+  GtsFace *f;
+  GtsVertex *v1, *v2, *v3;
+  guint i, nedges, nfaces;
+  gint p;
+
+  nedges = gts_surface_edge_number(s);
+  nfaces = gts_surface_face_number(s);
+
+  /* Partition the faces */
+  faces = g_array_new(FALSE,FALSE,sizeof(PartitionFace));
+  gts_surface_foreach_face(s,(GtsFunc)partition_face_add,faces);
+  data.part = g_hash_table_new(NULL,NULL);
+  partition_faces((PartitionFace*)faces->data,faces->len,npart,0,data.part);
+
+  /* Find the frozen vertices */
+  data.owner = g_hash_table_new(NULL,NULL);
+  data.frozen = g_hash_table_new(NULL,NULL);
+  gts_surface_foreach_face(s,(GtsFunc)partition_mark_shared,&data);
+  gts_surface_foreach_face(s,(GtsFunc)partition_mark_frozen,&data);
+
+  /* Move the faces from s into the interior and boundary surfaces */
+  interior = g_new(GtsSurface*,npart);
+  boundary = g_new(GtsSurface*,npart);
+  for(p=0;p<npart;p++) {
+    interior[p] = gts_surface_new(gts_surface_class(),
+				  s->face_class, s->edge_class,
+				  s->vertex_class);
+    boundary[p] = gts_surface_new(gts_surface_class(),
+				  s->face_class, s->edge_class,
+				  s->vertex_class);
+  }
+  for(i=0;i<faces->len;i++) {
+    f = g_array_index(faces,PartitionFace,i).f;
+    p = GPOINTER_TO_UINT(g_hash_table_lookup(data.part,f)) - 1;
+    gts_triangle_vertices(GTS_TRIANGLE(f),&v1,&v2,&v3);
+    if( g_hash_table_lookup(data.frozen,v1) || 
+	g_hash_table_lookup(data.frozen,v2) ||
+	g_hash_table_lookup(data.frozen,v3) ) {
+      gts_surface_add_face(boundary[p],f);
+    }
+    else {
+      gts_surface_add_face(interior[p],f);
+    }
+    gts_surface_remove_face(s,f);
+  }
+  g_array_free(faces,TRUE);
+  g_hash_table_destroy(data.part);
+  g_hash_table_destroy(data.owner);
+  g_hash_table_destroy(data.frozen);
+
+  /* Each partition gets its own copy of the quadrics it needs */
+  if(quadric) {
+    quadrics = g_new(GHashTable*,npart);
+    qcopy.from = (GHashTable*)cost_data;
+    for(p=0;p<npart;p++) {
+      quadrics[p] = g_hash_table_new_full(NULL,NULL,NULL,g_free);
+      qcopy.to = quadrics[p];
+      gts_surface_foreach_face(interior[p],(GtsFunc)quadric_copy_face,&qcopy);
+      gts_surface_foreach_face(boundary[p],(GtsFunc)quadric_copy_face,&qcopy);
+    }
+  }
 
-  SELF_CHECK
+  /* Scale the stop criteria */
+  stops = g_new(CoarsenStop,npart);
+  for(p=0;p<npart;p++) {
+    stops[p].nedges = stop->nedges ? 
+      (guint)(((gdouble)stop->nedges)/nedges * 
+	      gts_surface_edge_number(interior[p])) : 0;
+    stops[p].max_cost = stop->max_cost;
+    stops[p].nfaces = stop->nfaces>=0 ?
+      (gint)(((gdouble)stop->nfaces)/nfaces * 
+	     gts_surface_face_number(interior[p])) : -1;
+    stops[p].s = interior[p];
+  }
 
-  if( (s=gts_surface_is_self_intersecting(PYGTS_SURFACE_AS_GTS_SURFACE(self)))
-      != NULL) {
-    gts_object_destroy(GTS_OBJECT(s));
-    ret = TRUE;
+  /* Coarsen the interiors */
+  gts_allow_floating_edges = TRUE;
+#pragma omp parallel for schedule(dynamic)
+  for(p=0;p<npart;p++) {
+    partition_coarsen(interior[p], cost_func, 
+		      quadric ? quadrics[p] : cost_data, coarsen_func, 
+		      quadric ? quadrics[p] : cost_data,
+		      (GtsStopFunc)coarsen_stop, &stops[p], amin);
   }
+  gts_allow_floating_edges = FALSE;
 
-  if(ret) {
-    Py_INCREF(Py_True);
-    return Py_True;
+  /* Move the faces back into s */
+  if(quadric) {
+    g_hash_table_remove_all((GHashTable*)cost_data);
+    qcopy.to = (GHashTable*)cost_data;
   }
-  else {
-    Py_INCREF(Py_False);
-    return Py_False;
-  }  
+  for(p=0;p<npart;p++) {
+    if(quadric) {
+      qcopy.from = quadrics[p];
+      gts_surface_foreach_face(interior[p],(GtsFunc)quadric_copy_face,&qcopy);
+      gts_surface_foreach_face(boundary[p],(GtsFunc)quadric_copy_face,&qcopy);
+      g_hash_table_destroy(quadrics[p]);
+    }
+    gts_surface_merge(s,interior[p]);
+    gts_surface_merge(s,boundary[p]);
+    gts_object_destroy(GTS_OBJECT(interior[p]));
+    gts_object_destroy(GTS_OBJECT(boundary[p]));
+  }
+  g_free(interior);
+  g_free(boundary);
+  g_free(quadrics);
+  g_free(stops);
 }
 
-
 static PyObject*
-cleanup(PygtsSurface *self, PyObject *args)
+coarsen(PygtsSurface *self, PyObject *args, PyObject *kwds)
 {
+  gint n=-1, nfaces=-1, partitions=0;
+  gdouble amin=0., max_cost=-1.;
+  char *cost="volume";
+  GtsVolumeOptimizedParams params = {0.5,0.5,1.e-10};
+  GtsKeyFunc cost_func=NULL;
+  GtsCoarsenFunc coarsen_func=NULL;
+  gpointer cost_data=NULL;
+  CoarsenStop stop;
+  QuadricData quadric_data;
+  PartitionShared shared;
   GtsSurface *s;
-  gdouble threshold = 0.;
+
+  static char *kwlist[] = {"n", "amin", "cost", "weights", "max_cost", 
+			   "nfaces", "partitions", NULL};
 
   SELF_CHECK
 
   /* Parse the args */
-  if(! PyArg_ParseTuple(args,"|d", &threshold) ) {
+  if(! PyArg_ParseTupleAndKeywords(args, kwds, "|ids(ddd)dii", kwlist,
+				   &n, &amin, &cost,
+				   &(params.volume_weight),
+				   &(params.boundary_weight),
+				   &(params.shape_weight),
+				   &max_cost, &nfaces, &partitions) ) {
     return NULL;
   }
 
-  s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
-
-  /* Do the cleanup */
-  if( threshold != 0. ) {
-    pygts_vertex_cleanup(s,threshold);
+  if(n<0 && max_cost<0. && nfaces<0) {
+    PyErr_SetString(PyExc_TypeError,
+		    "expected at least one of n, max_cost or nfaces");
+    return NULL;
   }
-  pygts_edge_cleanup(s);
-  pygts_face_cleanup(s);
-
-  Py_INCREF(Py_None);
-  return Py_None;
-}
 
+  s = PYGTS_SURFACE_AS_GTS_SURFACE(self);
 
-static PyObject*
-coarsen(PygtsSurface *self, PyObject *args)
-{
-  guint n;
-  gdouble amin=0.;
-  GtsVolumeOptimizedParams params = {0.5,0.5,1.e-10};
-
-  SELF_CHECK
+  stop.nedges = n<0 ? 0 : n;
+  stop.max_cost = max_cost;
+  stop.nfaces = nfaces;
+  stop.s = s;
 
-  /* Parse the args */
-  if(! PyArg_ParseTuple(args,"i|d", &n, &amin) ) {
+  /* Select the cost */
+  if( strcmp(cost,"volume")==0 ) {
+    cost_func = (GtsKeyFunc)gts_volume_optimized_cost;
+    coarsen_func = (GtsCoarsenFunc)gts_volume_optimized_vertex;
+    cost_data = &params;
+  }
+  else if( strcmp(cost,"quadric")==0 ) {
+    quadric_data.quadrics = g_hash_table_new_full(NULL,NULL,NULL,g_free);
+    quadric_data.s = s;
+    gts_surface_foreach_face(s,(GtsFunc)quadric_add_face,
+			     quadric_data.quadrics);
+    gts_surface_foreach_edge(s,(GtsFunc)quadric_add_boundary,&quadric_data);
+    cost_func = (GtsKeyFunc)quadric_cost;
+    coarsen_func = (GtsCoarsenFunc)quadric_vertex;
+    cost_data = quadric_data.quadrics;
+  }
+  else if( strcmp(cost,"length")!=0 ) {
+    PyErr_SetString(PyExc_ValueError,
+		    "cost must be 'volume', 'quadric' or 'length'");
     return NULL;
   }
+  /* The GTS defaults (NULL) are the squared edge length and the midpoint */
+
+  /* Coarsen the partition interiors concurrently first; faces shared
+   * with another Surface are left to the serial pass */
+  shared.s = s;
+  shared.shared = FALSE;
+  if( partitions>1 ) {
+    gts_surface_foreach_face(s,(GtsFunc)partition_face_shared,&shared);
+  }
+  if( partitions>1 && !shared.shared ) {
+    coarsen_partitioned(s, partitions, cost_func, coarsen_func, cost_data,
+			strcmp(cost,"quadric")==0, &stop, amin);
+  }
 
   /* Make the call */
-  gts_surface_coarsen(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-		      (GtsKeyFunc)gts_volume_optimized_cost, &params,
-		      (GtsCoarsenFunc)gts_volume_optimized_vertex, &params,
-		      (GtsStopFunc)gts_coarsen_stop_number, &n, amin);
+  gts_surface_coarsen(s, cost_func, cost_data, coarsen_func, cost_data,
+		      (GtsStopFunc)coarsen_stop, &stop, amin);
+  surface_shared_changed(self);
+
+  if( strcmp(cost,"quadric")==0 ) {
+    g_hash_table_destroy(quadric_data.quadrics);
+  }
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -1649,6 +5498,8 @@ static PyMethodDef methods[] = {
   {"copy", (PyCFunction)copy,
    METH_VARARGS,
    "Copys all Faces, Edges and Vertices of Surface s2 to Surface s1.\n"
+   "If s2 has an order from s2.reorder(), the copies are made in that\n"
+   "order.\n"
    "\n"
    "Signature: s1.copy(s2)\n"
    "\n"
@@ -1763,10 +5614,14 @@ static PyMethodDef methods[] = {
   },
 
   {"split", (PyCFunction)split,
-   METH_NOARGS,
+   METH_VARARGS | METH_KEYWORDS,
    "Splits a surface into a tuple of connected and manifold components.\n"
    "\n"
-   "Signature: s.split()\n"
+   "Signature: s.split(as_arrays=False)\n"
+   "\n"
+   "If as_arrays is True, the components are not built as Surfaces.  A\n"
+   "tuple (coords,triangles) of numpy arrays with shapes (N,3) and (M,3)\n"
+   "is given for each instead, in the order of s.component_labels().\n"
   },
 
   {"distance", (PyCFunction)distance,
@@ -1787,14 +5642,53 @@ static PyMethodDef methods[] = {
    "of the diagonal of the bounding box of s2 (default 0.1).\n"
   },
 
+  {"hausdorff", (PyCFunction)hausdorff,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns the symmetric Hausdorff distance between this Surface s1\n"
+   "and other s2, and the mean of the distances each way.\n"
+   "\n"
+   "Signature: s1.hausdorff(s2,delta=0.01,vertex_distances=False)\n"
+   "\n"
+   "The faces of each Surface are sampled with a spacing of delta\n"
+   "times the diagonal of the bounding box of both Surfaces, and each\n"
+   "sample is measured against the nearest Face of the other.  The\n"
+   "mean is weighted by face area.  Sampling is shared between\n"
+   "threads, and the bounding-box trees are kept with each Surface\n"
+   "for as long as it is unchanged.\n"
+   "\n"
+   "If vertex_distances is True, two numpy arrays are also returned\n"
+   "with the distances from the vertices of s1 to s2 and from the\n"
+   "vertices of s2 to s1, in the order given by vertices().\n"
+  },
+
   {"strip", (PyCFunction)strip,
    METH_NOARGS,
    "Returns a tuple of strips, where each strip is a tuple of Faces\n"
    "that are successive and have one edge in common.\n"
    "\n"
-   "Signature: s.split()\n"
+   "Signature: s.strip()\n"
   },
 
+#if PYGTS_HAS_NUMPY
+  {"strip_indices", (PyCFunction)strip_indices,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns the triangle strips of Surface s as a numpy array of vertex\n"
+   "indices (uint32), for the order of s.vertices().  No Faces are\n"
+   "created.\n"
+   "\n"
+   "Signature: s.strip_indices(restart=0xFFFFFFFF)\n"
+   "\n"
+   "If restart is an int, the strips are separated by it in a single\n"
+   "array for primitive restart.  If it is None, the tuple (indices,\n"
+   "offsets) is returned instead, where strip i is\n"
+   "indices[offsets[i]:offsets[i+1]].\n"
+   "\n"
+   "Each strip gives the Faces in their own orientation, with the\n"
+   "order of every second triangle reversed as usual.  The strips from\n"
+   "s.strip() are broken where that is not possible.\n"
+  },
+#endif /* PYGTS_HAS_NUMPY */
+
   {"stats", (PyCFunction)stats,
    METH_NOARGS,
    "Returns statistics for this Surface f in a dict.\n"
@@ -1817,6 +5711,146 @@ static PyMethodDef methods[] = {
    "Signature: s.quality_stats()\n"
   },
 
+  {"metrics", (PyCFunction)metrics,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns a Metrics struct sequence for Surface s, computed in a single\n"
+   "pass over the faces and edges.\n"
+   "\n"
+   "Signature: s.metrics(which=None,bins=0)\n"
+   "\n"
+   "which is a sequence of names from 'area', 'volume', 'boundary',\n"
+   "'incompatible', 'faces_per_edge', 'face_quality', 'face_area',\n"
+   "'edge_length', 'edge_angle' and 'edges_per_vertex'; all are\n"
+   "computed if it is None.  Fields for metrics that were not selected\n"
+   "are None.  The counts n_faces and n_edges are always given.\n"
+   "\n"
+   "The face and edge statistics are Range struct sequences.  If bins>0,\n"
+   "each of those has a histogram of the values in bins equal bins.\n"
+  },
+
+#if PYGTS_HAS_NUMPY
+  {"face_areas", (PyCFunction)face_areas,
+   METH_NOARGS,
+   "Returns a numpy array of the face areas of Surface s.  The faces\n"
+   "are in the order of s.face_indices(s.vertices()).\n"
+   "\n"
+   "Signature: s.face_areas()\n"
+  },
+
+  {"face_normals", (PyCFunction)face_normals,
+   METH_NOARGS,
+   "Returns an (N,3) numpy array of the face normals of Surface s.  As\n"
+   "for Triangle.normal(), the normals are not normalized.  The faces\n"
+   "are in the order of s.face_indices(s.vertices()).\n"
+   "\n"
+   "Signature: s.face_normals()\n"
+  },
+
+  {"face_qualities", (PyCFunction)face_qualities,
+   METH_NOARGS,
+   "Returns a numpy array of the face qualities of Surface s.  See\n"
+   "Triangle.quality().  The faces are in the order of\n"
+   "s.face_indices(s.vertices()).\n"
+   "\n"
+   "Signature: s.face_qualities()\n"
+  },
+
+  {"vertex_normals", (PyCFunction)vertex_normals,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns an (N,3) numpy array of the unit vertex normals of Surface s,\n"
+   "in the order of s.vertices().  Each is the sum of the normals of the\n"
+   "faces around the vertex, weighted by the angle of the face at the\n"
+   "vertex or by the face area.\n"
+   "\n"
+   "Signature: s.vertex_normals(weighting='angle')\n"
+   "\n"
+   "weighting is either 'angle' or 'area'.\n"
+  },
+
+  {"edge_lengths", (PyCFunction)edge_lengths,
+   METH_NOARGS,
+   "Returns a numpy array of the edge lengths of Surface s, in the order\n"
+   "of s.edges().\n"
+   "\n"
+   "Signature: s.edge_lengths()\n"
+  },
+
+  {"curvatures", (PyCFunction)curvatures,
+   METH_NOARGS,
+   "Returns the tuple (H,K,K1,K2) of numpy arrays giving the mean,\n"
+   "Gaussian and principal curvatures at the vertices of Surface s, in\n"
+   "the order of s.vertices().  H is the magnitude of the mean curvature\n"
+   "normal.  Curvatures are NaN for vertices on the boundary or on a\n"
+   "non-manifold edge.\n"
+   "\n"
+   "Signature: s.curvatures()\n"
+  },
+
+  {"adjacency", (PyCFunction)adjacency,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns the adjacency of Surface s as the tuple (indptr,indices) of\n"
+   "compressed sparse row (CSR) numpy arrays.  The neighbors of element\n"
+   "i are indices[indptr[i]:indptr[i+1]], in ascending order.\n"
+   "\n"
+   "Signature: s.adjacency(kind='vertex-vertex')\n"
+   "\n"
+   "kind is one of:\n"
+   "  'vertex-vertex' -- the vertices joined to each vertex by an edge;\n"
+   "  'vertex-face'   -- the faces around each vertex;\n"
+   "  'face-face'     -- the faces sharing an edge with each face.\n"
+   "Vertices are indexed in the order of s.vertices() and faces in the\n"
+   "order of s.face_indices(s.vertices()).\n"
+  },
+
+  {"iter_chunks", (PyCFunction)iter_chunks,
+   METH_VARARGS | METH_KEYWORDS,
+   "Returns an iterator over blocks of the Faces of Surface s.  Each\n"
+   "block is given as the tuple (coords,triangles) of numpy arrays with\n"
+   "shapes (N,3) and (M,3), where M<=size and the triangles index the\n"
+   "coords of that block only.  The Faces are in the order of\n"
+   "s.face_indices(s.vertices()).  No Faces are created.\n"
+   "\n"
+   "Signature: s.iter_chunks(size=65536)\n"
+   "\n"
+   "RuntimeError is raised if s changes during the iteration.\n"
+  },
+
+  {"traverse_indices", (PyCFunction)traverse_indices,
+   METH_NOARGS,
+   "Returns a numpy array of the indices of the Faces of Surface s in\n"
+   "breadth-first order, one connected component after another.  This\n"
+   "is the order of iteration over s.  The indices are for the order of\n"
+   "s.face_indices(s.vertices()).\n"
+   "\n"
+   "Signature: s.traverse_indices()\n"
+  },
+
+  {"component_labels", (PyCFunction)component_labels,
+   METH_NOARGS,
+   "Returns a numpy array giving the number of the connected and manifold\n"
+   "component for each Face of Surface s, as for s.split().  Components\n"
+   "are numbered from 0 in the order of their first faces, and the faces\n"
+   "are in the order of s.face_indices(s.vertices()).\n"
+   "\n"
+   "Signature: s.component_labels()\n"
+  },
+#endif /* PYGTS_HAS_NUMPY */
+
+  {"reorder", (PyCFunction)reorder,
+   METH_VARARGS | METH_KEYWORDS,
+   "Orders the Faces and Vertices of Surface s for locality.  The order\n"
+   "is used by s.vertices(), s.face_indices() and the numpy array\n"
+   "methods, and by s2.copy(s) to allocate the new Vertices, Edges and\n"
+   "Faces of s2.  It is kept until s or any of its elements changes.\n"
+   "\n"
+   "Signature: s.reorder(method='forsyth')\n"
+   "\n"
+   "method is one of:\n"
+   "  'forsyth' -- Forsyth's vertex cache optimisation, for rendering;\n"
+   "  'hilbert' -- along a Hilbert curve through the Face centroids.\n"
+   "Vertices are ordered by their first use in the Faces.\n"
+  },
+
   {"tessellate", (PyCFunction)tessellate,
    METH_NOARGS,
    "Tessellate each face of this Surface s with 4 triangles.\n"
@@ -1825,6 +5859,25 @@ static PyMethodDef methods[] = {
    "Signature: s.tessellate()\n"
   },
 
+  {"refine", (PyCFunction)refine,
+   METH_VARARGS | METH_KEYWORDS,
+   "Splits the costliest Edges of Surface s at their midpoints until\n"
+   "the criteria given are met.\n"
+   "\n"
+   "Signature: s.refine(max_edge_length=l), s.refine(max_faces=n) or\n"
+   "s.refine(cost='curvature',max_cost=c)\n"
+   "\n"
+   "cost=            'length' (the default) splits the longest Edges;\n"
+   "                 'curvature' splits the Edges with the largest\n"
+   "                 length times dihedral angle, where s bends most.\n"
+   "max_edge_length= Stop when no Edge is longer than l ('length' only).\n"
+   "max_cost=        Stop when no Edge costs more than c.\n"
+   "max_faces=       Stop when the Surface has at least n Faces.\n"
+   "\n"
+   "Refinement stops at the first of the criteria given to be met.\n"
+   "Only the Edges that are split, and their neighbours, are changed.\n"
+  },
+
   {"vertices", (PyCFunction)vertices,
    METH_NOARGS,
    "Returns a tuple containing the vertices of Surface s.\n"
@@ -1886,6 +5939,17 @@ static PyMethodDef methods[] = {
    "Signature: s1.difference(s2)\n"
   },
 
+  {"transform", (PyCFunction)transform,
+   METH_VARARGS,
+   "Applies the 4x4 affine matrix m to all of the vertices of Surface s\n"
+   "in a single pass.  The bottom row of m is ignored.\n"
+   "\n"
+   "If m is instead a sequence of N matrices, then s is unchanged and a\n"
+   "tuple of N transformed copies of s is returned.\n"
+   "\n"
+   "Signature: s.transform(m)\n"
+  },
+
   {"rotate", (PyCFunction)rotate,
    METH_VARARGS | METH_KEYWORDS,
    "Rotates Surface s about vector dx,dy,dz and angle a.\n"
@@ -1914,8 +5978,26 @@ static PyMethodDef methods[] = {
    "False otherwise.\n"
    "\n"
    "Signature: s.is_self_intersecting()\n"
+   "\n"
+   "The test stops at the first intersecting pair of Faces; see\n"
+   "self_intersections() for all of them.\n"
   },
 
+#if PYGTS_HAS_NUMPY
+  {"self_intersections", (PyCFunction)self_intersections,
+   METH_NOARGS,
+   "Returns a (K,2) numpy array of the pairs (i,j), i<j, of Faces of\n"
+   "this Surface s that intersect, sorted.  Faces are indexed in the\n"
+   "order used by face_indices().\n"
+   "\n"
+   "Signature: s.self_intersections()\n"
+   "\n"
+   "Two Faces intersect if an Edge of one meets the other, including\n"
+   "its boundary, and shares no Vertex with it.  The test uses the\n"
+   "bounding-box tree kept with s, and is shared between threads.\n"
+  },
+#endif /* PYGTS_HAS_NUMPY */
+
   {"cleanup", (PyCFunction)cleanup,
    METH_VARARGS,
    "Cleans up the Vertices, Edges, and Faces on a Surface s.\n"
@@ -1928,13 +6010,33 @@ static PyMethodDef methods[] = {
   },
 
   {"coarsen", (PyCFunction)coarsen,
-   METH_VARARGS,
-   "Reduces the number of vertices on Surface s.\n"
+   METH_VARARGS | METH_KEYWORDS,
+   "Reduces the number of vertices on Surface s by collapsing the\n"
+   "lowest-cost edges first.\n"
    "\n"
-   "Signature: s.coarsen(n) and s.coarsen(amin)\n"
+   "Signature: s.coarsen(n, amin) or s.coarsen(...)\n"
    "\n"
    "n is the smallest number of desired edges (but you may get fewer).\n"
    "amin is the smallest angle between Faces.\n"
+   "\n"
+   "Keyword arguments:\n"
+   "cost=     ['volume'|'quadric'|'length']\n"
+   "          volume  -- volume-optimized cost and vertex (default)\n"
+   "          quadric -- quadric error metric; the vertex minimizes\n"
+   "                     the squared distance to the original planes\n"
+   "          length  -- edge length; the vertex is the midpoint\n"
+   "weights=  (volume_weight, boundary_weight, shape_weight) for the\n"
+   "          volume cost.  Default is (0.5, 0.5, 1.e-10).\n"
+   "max_cost= Stop when the cost of the next collapse exceeds max_cost.\n"
+   "nfaces=   Stop when the Surface has at most nfaces Faces.\n"
+   "partitions= If greater than 1, the Surface is split spatially into\n"
+   "          this many parts whose interiors are coarsened in\n"
+   "          parallel, with the Vertices near the part boundaries\n"
+   "          frozen.  A final pass over the whole Surface then\n"
+   "          meets the criteria.  Use about the number of cores.\n"
+   "          Faces shared with another Surface are coarsened serially.\n"
+   "\n"
+   "Coarsening stops at the first of the criteria given to be met.\n"
   },
 
   {NULL}  /* Sentinel */
@@ -1995,11 +6097,22 @@ static PyGetSetDef getset[] = {
 static void
 dealloc(PygtsSurface* self)
 {
+  /* The vertices may outlive this Surface */
+  if( pending==self && pygts_surface_apply_pending_transform()==-1 ) {
+    PyErr_Clear();
+    gts_matrix_destroy(self->transform);
+    pending = NULL;
+  }
+  self->transform = NULL;
+
   if(self->traverse!=NULL) {
-    gts_surface_traverse_destroy(self->traverse);
+    traverse_destroy(self->traverse);
   }
   self->traverse = NULL;
 
+  order_clear(self);
+  tree_clear(self);
+
   /* Chain up */
   PygtsObjectType.tp_dealloc((PyObject*)self);
 }
@@ -2031,6 +6144,13 @@ new(PyTypeObject *type, PyObject *args, PyObject *kwds)
   obj = PYGTS_OBJECT(PygtsObjectType.tp_new(type,args,kwds));
 
   PYGTS_SURFACE(obj)->traverse = NULL;
+  PYGTS_SURFACE(obj)->transform = NULL;
+  PYGTS_SURFACE(obj)->version = 0;
+  PYGTS_SURFACE(obj)->geometry = 0;
+  PYGTS_SURFACE(obj)->cache.valid = 0;
+  PYGTS_SURFACE(obj)->order.vertices = NULL;
+  PYGTS_SURFACE(obj)->order.faces = NULL;
+  PYGTS_SURFACE(obj)->tree.tree = NULL;
 
   /* Allocate the gtsobj (if needed) */
   if( alloc_gtsobj ) {
@@ -2064,38 +6184,45 @@ init(PygtsSurface *self, PyObject *args, PyObject *kwds)
 }
 
 
-/* Helper function for iter */
-static void 
-get_f0(GtsFace *f,GtsFace **f0)
+/* Attributes that are answered without applying a pending transform */
+static char *deferred_attributes[] = {"rotate", "scale", "translate",
+				      "transform", "volume", "center_of_mass",
+				      "Nvertices", "Nedges", "Nfaces", NULL};
+
+static PyObject*
+getattro(PygtsSurface *self, PyObject *name)
 {
-  if(*f0==NULL) *f0 = f;
+  char **attr;
+  gboolean deferred = FALSE;
+
+  /* Apply any pending transform unless the attribute can do without */
+  if( pending != NULL ) {
+    if( pending==self && PyString_Check(name) ) {
+      for(attr=deferred_attributes; *attr!=NULL; attr++) {
+	if( strcmp(*attr,PyString_AS_STRING(name))==0 ) {
+	  deferred = TRUE;
+	  break;
+	}
+      }
+    }
+    if( !deferred && pygts_surface_apply_pending_transform()==-1 ) {
+      return NULL;
+    }
+  }
+
+  return PyObject_GenericGetAttr((PyObject*)self,name);
 }
 
+
 PyObject* 
 iter(PygtsSurface *self)
 {
-  GtsFace* f0=NULL;
-
   SELF_CHECK
 
   if(self->traverse!=NULL) {
-    gts_surface_traverse_destroy(self->traverse);
-    self->traverse = NULL;
-  }
-
-  /* Assign a "first" face */
-  gts_surface_foreach_face(PYGTS_SURFACE_AS_GTS_SURFACE(self),
-			   (GtsFunc)get_f0,&f0);
-  if(f0==NULL) {
-    PyErr_SetString(PyExc_RuntimeError, "No faces to traverse");
-    return NULL;
-  }
-
-  if( (self->traverse=gts_surface_traverse_new(
-           PYGTS_SURFACE_AS_GTS_SURFACE(self),f0)) == NULL ) {
-    PyErr_SetString(PyExc_MemoryError, "could not create Traverse");
-    return NULL;
+    traverse_destroy(self->traverse);
   }
+  self->traverse = traverse_new(self);
 
   Py_INCREF((PyObject*)self);
   return (PyObject*)self;
@@ -2116,8 +6243,8 @@ iternext(PygtsSurface *self)
   }
 
   /* Get the next face */
-  if( (f = gts_surface_traverse_next(self->traverse,NULL)) == NULL ) {
-    gts_surface_traverse_destroy(self->traverse);
+  if( (f = traverse_next(self->traverse)) == NULL ) {
+    traverse_destroy(self->traverse);
     self->traverse = NULL;
     PyErr_SetString(PyExc_StopIteration, "No more faces");
     return NULL;
@@ -2150,7 +6277,7 @@ PyTypeObject PygtsSurfaceType = {
     0,                       /* tp_hash */
     0,                       /* tp_call */
     0,                       /* tp_str */
-    0,                       /* tp_getattro */
+    (getattrofunc)getattro,  /* tp_getattro */
     0,                       /* tp_setattro */
     0,                       /* tp_as_buffer */
     Py_TPFLAGS_DEFAULT |
@@ -29,20 +29,67 @@
 #define __PYGTS_SURFACE_H__
 
 typedef struct _PygtsSurface PygtsSurface;
+typedef struct _PygtsSurfaceTraverse PygtsSurfaceTraverse;
 
 #define PYGTS_SURFACE(o) ((PygtsSurface*)o)
 
 #define PYGTS_SURFACE_AS_GTS_SURFACE(o) (GTS_SURFACE(PYGTS_OBJECT(o)->gtsobj))
 
+/* Marks a Surface as changed so that its cached invariants are redone */
+#define PYGTS_SURFACE_CHANGED(o) (PYGTS_SURFACE(o)->version++)
+
+/* Marks the vertices of a Surface as moved */
+#define PYGTS_SURFACE_MOVED(o) (PYGTS_SURFACE(o)->geometry++)
+
+/* Invariants cached against the Surface version and geometry */
+typedef struct {
+  guint version, geometry;
+  guint valid;  /* Flags for the cached values */
+  gboolean is_manifold, is_orientable, is_closed;
+  gdouble area, volume;
+  GtsVector center_of_mass, center_of_area;
+} PygtsSurfaceCache;
+
+/* Element order set by Surface.reorder(), kept against the Surface 
+ * version only, as it does not depend on the coordinates.
+ */
+typedef struct {
+  guint version;
+  guint nvertices, nfaces;
+  GtsVertex **vertices;  /* NULL if there is no order */
+  GtsFace **faces;
+} PygtsSurfaceOrder;
+
+/* Bounding-box tree of the faces, kept like the cache */
+typedef struct {
+  guint version, geometry;
+  GNode *tree;  /* NULL if there is no tree */
+} PygtsSurfaceTree;
+
 struct _PygtsSurface {
   PygtsObject o;
-  GtsSurfaceTraverse* traverse;
+  PygtsSurfaceTraverse *traverse;  /* Active iteration, or NULL */
+  GtsMatrix *transform;  /* Pending transform, or NULL */
+  guint version;   /* Bumped when the elements or connectivity change */
+  guint geometry;  /* Bumped when the vertices move */
+  PygtsSurfaceCache cache;
+  PygtsSurfaceOrder order;
+  PygtsSurfaceTree tree;
 };
 
 extern PyTypeObject PygtsSurfaceType;
 
+/* Struct sequences returned by Surface.metrics() */
+extern PyStructSequence_Desc pygts_range_desc;
+extern PyTypeObject PygtsRangeType;
+extern PyStructSequence_Desc pygts_metrics_desc;
+extern PyTypeObject PygtsMetricsType;
+
 gboolean pygts_surface_check(PyObject* o);
 gboolean pygts_surface_is_ok(PygtsSurface *s);
 PygtsSurface* pygts_surface_new(GtsSurface *s);
+gint pygts_surface_apply_pending_transform(void);
+void pygts_surface_vertex_changed(GtsVertex *v);
+void pygts_surface_vertex_moved(GtsVertex *v);
 
 #endif /* __PYGTS_SURFACE_H__ */
@@ -104,6 +104,9 @@ revert(PygtsTriangle *self, PyObject *args)
   SELF_CHECK
 
   gts_triangle_revert(PYGTS_TRIANGLE_AS_GTS_TRIANGLE(self));
+  pygts_surface_vertex_changed(
+    GTS_SEGMENT(PYGTS_TRIANGLE_AS_GTS_TRIANGLE(self)->e1)->v1);
+
   Py_INCREF(Py_None);
   return Py_None;
 }
@@ -874,6 +877,8 @@ compare(PyObject *o1, PyObject *o2)
   if( !(pygts_triangle_check(o1) && pygts_triangle_check(o2)) ) {
     return -1;
   }
+  if( pygts_surface_apply_pending_transform()==-1 ) return -1;
+
   t1 = PYGTS_TRIANGLE_AS_GTS_TRIANGLE(o1);
   t2 = PYGTS_TRIANGLE_AS_GTS_TRIANGLE(o2);
   
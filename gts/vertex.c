@@ -220,6 +220,7 @@ replace(PygtsVertex *self, PyObject *args)
       i = g_slist_next(i);
     }
     g_slist_free(parents);
+    pygts_surface_vertex_changed(PYGTS_VERTEX_AS_GTS_VERTEX(p2));
   }
 
   Py_INCREF(Py_None);
@@ -43,6 +43,7 @@ VERSION = '0.3.1'
 
 PYGTS_DEBUG = '1'      # '1' for on, '0' for off
 PYGTS_HAS_NUMPY = '0'  # Numpy detected below
+PYGTS_OPENMP = '1'     # '1' for on, '0' for off (used by parallel methods)
 
 # Hand-code these lists if the auto-detection below doesn't work
 INCLUDE_DIRS = []
@@ -124,6 +125,14 @@ if sys.platform.startswith("darwin"):
             new_flags = get_config_var(flag).replace(unwanted, '')
             get_config_vars()[flag] = new_flags
 
+    # Apple's compilers don't support OpenMP
+    PYGTS_OPENMP = '0'
+
+if PYGTS_OPENMP == '1':
+    OPENMP_ARGS = ['-fopenmp']
+else:
+    OPENMP_ARGS = []
+
 
 # Run the setup
 setup(name='pygts', 
@@ -161,6 +170,7 @@ Surface (GTS) Library.""",
                                           "gts/triangle.c",
                                           "gts/face.c",
                                           "gts/surface.c",
+                                          "gts/psurface.c",
                                           "gts/cleanup.c"
                                           ],
                              define_macros=[
@@ -169,7 +179,9 @@ Surface (GTS) Library.""",
                 ],
                              include_dirs = INCLUDE_DIRS,
                              library_dirs = LIB_DIRS,
-                             libraries=LIBS)
+                             libraries=LIBS,
+                             extra_compile_args=OPENMP_ARGS,
+                             extra_link_args=OPENMP_ARGS)
                    ]
       )
 
@@ -2273,6 +2273,35 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(s3.is_ok())
 
 
+    def test_iter_components(self):
+
+        s1 = gts.sphere(2)
+        s2 = gts.sphere(2)
+        s2.translate(5)
+        s = gts.Surface()
+        s.add(s1)
+        s.add(s2)
+
+        # All components are traversed, and faces removed during the
+        # traversal are skipped
+        faces = []
+        for f in s:
+            faces.append(f)
+            if len(faces)==1:
+                g = f.neighbors(s)[0]
+                s.remove(g)
+        self.assert_(len(faces)==s.Nfaces)
+        self.assert_(g not in faces)
+        self.assert_(s.is_ok())
+
+        if HAS_NUMPY:
+            order = s.traverse_indices()
+            self.assert_(sorted(order)==range(s.Nfaces))
+            labels = s.component_labels()[order]
+            self.assert_(list(labels)==sorted(labels))
+            self.assert_(order[0]==0)
+
+
     def test_readwrite(self):
 
         path = os.path.join(tempfile.gettempdir(),'pygts_test.dat')
@@ -2372,6 +2401,50 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(br['max']==11.0)
 
 
+    def test_hausdorff(self):
+
+        # Two spheres
+        s1 = gts.sphere(4)
+        s2 = gts.sphere(4)
+        s2.scale(2,2,2)
+        s2.translate(10)
+
+        H,mean = s1.hausdorff(s2)
+        self.assert_(fabs(H-11.)<1.e-9)
+        self.assert_(7.<mean<11.)
+        H2,mean2 = s2.hausdorff(s1)
+        self.assert_(H2==H and fabs(mean2-mean)<1.e-9)
+
+        H,mean = s1.hausdorff(s1)
+        self.assert_(H<1.e-9 and mean<1.e-9)
+
+        if HAS_NUMPY:
+            H,mean,d1,d2 = s1.hausdorff(s2,vertex_distances=True)
+            self.assert_(d1.shape==(s1.Nvertices,))
+            self.assert_(d2.shape==(s2.Nvertices,))
+            self.assert_(fabs(d1.min()-7.)<1.e-9)
+            self.assert_(fabs(d2.max()-H)<1.e-9)
+            x = numpy.array([v.x for v in s1.vertices()])
+            self.assert_((d1[x>0.99]<d1[x<-0.99].min()).all())
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+        # The trees are rebuilt once a Surface is moved
+        s2.translate(1)
+        H,mean = s1.hausdorff(s2)
+        self.assert_(fabs(H-12.)<1.e-9)
+
+        # ...or one of its vertices is
+        for v in s2.vertices():
+            v.translate(1)
+        H,mean = s1.hausdorff(s2)
+        self.assert_(fabs(H-13.)<1.e-9)
+
+        self.assertRaises(TypeError,s1.hausdorff,1)
+        self.assertRaises(ValueError,s1.hausdorff,s2,0.)
+        self.assertRaises(ValueError,s1.hausdorff,gts.Surface())
+
+
     def test_split(self):
 
         # Create two surfaces
@@ -2411,6 +2484,187 @@ class TestSurfaceMethods(unittest.TestCase):
                          (f1 in surfaces[1] and f2 in surfaces[0]))
                      
 
+    def test_split_arrays(self):
+
+        if HAS_NUMPY:
+
+            s1 = gts.sphere(2)
+            s2 = gts.sphere(2)
+            s2.translate(5)
+            s = gts.Surface()
+            s.add(s1)
+            s.add(s2)
+
+            labels = s.component_labels()
+            self.assert_(labels.shape==(s.Nfaces,))
+            self.assert_(labels[0]==0)
+            self.assert_(sorted(set(labels))==[0,1])
+            self.assert_((labels==0).sum()==s1.Nfaces)
+
+            components = s.split(as_arrays=True)
+            self.assert_(len(components)==2)
+            centers = []
+            for coords,triangles in components:
+                self.assert_(coords.shape==(s1.Nvertices,3))
+                self.assert_(triangles.shape==(s1.Nfaces,3))
+                self.assert_(triangles.min()==0)
+                self.assert_(triangles.max()==s1.Nvertices-1)
+                p1,p2,p3 = [coords[triangles[:,i]] for i in range(3)]
+                area = 0.5*numpy.sqrt((numpy.cross(p2-p1,p3-p1)**2).sum(1))
+                self.assert_(fabs(area.sum()-s1.area())<1.e-9)
+                centers.append(coords.mean(0)[0])
+            self.assert_(numpy.allclose(sorted(centers),[0.,5.]))
+
+            self.assert_(gts.Surface().component_labels().shape==(0,))
+            self.assert_(gts.Surface().split(as_arrays=True)==())
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_reorder(self):
+
+        def acmr(indices,size=32):
+            cache, misses = [], 0
+            for t in indices:
+                for i in t:
+                    if i in cache:
+                        cache.remove(i)
+                    else:
+                        misses += 1
+                    cache.insert(0,i)
+                    del cache[size:]
+            return float(misses)/len(indices)
+
+        s = gts.sphere(3)
+        original = acmr(s.face_indices(s.vertices()))
+        faces = sorted([f.vertices() for f in s.faces()])
+
+        for method in ['forsyth','hilbert']:
+            s.reorder(method)
+            vs = s.vertices()
+            indices = s.face_indices(vs)
+            self.assert_(len(vs)==s.Nvertices)
+            self.assert_(sorted(indices[0])==[0,1,2])
+            self.assert_(sorted([f.vertices() for f in s.faces()])==faces)
+            if method=='forsyth':
+                self.assert_(acmr(indices)<original)
+
+            s2 = gts.Surface().copy(s)
+            self.assert_(s2.face_indices(s2.vertices())==indices)
+            self.assert_(fabs(s2.area()-s.area())<1.e-9)
+            self.assert_(s2.is_ok())
+
+        # Moving vertices keeps the order
+        vs = s.vertices()
+        indices = s.face_indices(vs)
+        s.scale(2)
+        vs[0].set(vs[0].x,vs[0].y,vs[0].z+0.1)
+        gts.Vertex(0,0,0).set(1,1,1)
+        vs2 = s.vertices()
+        self.assert_(len([v for v,v2 in zip(vs,vs2) if v is v2])==len(vs))
+        self.assert_(s.face_indices(vs2)==indices)
+        if HAS_NUMPY:
+            coords = numpy.array([v.coords() for v in vs])
+            n = s.vertex_normals()
+            self.assert_(((n*coords).sum(1)>0).all())
+
+        # The order is dropped when the surface changes
+        s.tessellate()
+        self.assert_(len(s.face_indices(s.vertices()))==s.Nfaces)
+
+        # ...or when another Surface changes the faces they share
+        s.reorder()
+        s3 = gts.Surface()
+        s3.add(s)
+        s3.coarsen(s.Nfaces/2)
+        self.assert_(s.Nfaces==s3.Nfaces)
+        vs = s.vertices()
+        self.assert_(len(vs)==s.Nvertices)
+        self.assert_(len(s.face_indices(vs))==s.Nfaces)
+
+        self.assertRaises(ValueError,s.reorder,'foo')
+
+
+    def test_iter_chunks(self):
+
+        if HAS_NUMPY:
+
+            s = gts.sphere(3)
+            n, area, blocks = 0, 0., 0
+            for coords,triangles in s.iter_chunks(100):
+                self.assert_(len(triangles)<=100)
+                self.assert_(triangles.max()==len(coords)-1)
+                p1,p2,p3 = [coords[triangles[:,i]] for i in range(3)]
+                area += 0.5*numpy.sqrt(
+                    (numpy.cross(p2-p1,p3-p1)**2).sum(1)).sum()
+                n += len(triangles)
+                blocks += 1
+            self.assert_(n==s.Nfaces)
+            self.assert_(blocks==(s.Nfaces+99)//100)
+            self.assert_(fabs(area-s.area())<1.e-9)
+
+            coords,triangles = s.iter_chunks().next()
+            self.assert_(len(triangles)==s.Nfaces)
+            self.assert_(len(coords)==s.Nvertices)
+
+            chunks = s.iter_chunks(size=10)
+            chunks.next()
+            s.tessellate()
+            self.assertRaises(RuntimeError,chunks.next)
+
+            self.assertRaises(ValueError,s.iter_chunks,0)
+            self.assert_(list(gts.Surface().iter_chunks())==[])
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_strip_indices(self):
+
+        if HAS_NUMPY:
+
+            def oriented(t):
+                i = list(t).index(min(t))
+                return tuple(t[i:])+tuple(t[:i])
+
+            def triangles(strip):
+                result = []
+                for i in range(len(strip)-2):
+                    if i%2:
+                        result.append(oriented((strip[i+1],strip[i],
+                                                strip[i+2])))
+                    else:
+                        result.append(oriented(strip[i:i+3]))
+                return result
+
+            s = gts.sphere(2)
+            expected = sorted([oriented(t) for t in 
+                               s.face_indices(s.vertices())])
+
+            indices,offsets = s.strip_indices(None)
+            self.assert_(indices.dtype==numpy.uint32)
+            self.assert_(offsets[0]==0 and offsets[-1]==len(indices))
+            result = []
+            for i in range(len(offsets)-1):
+                result.extend(triangles(indices[offsets[i]:offsets[i+1]]))
+            self.assert_(sorted(result)==expected)
+
+            indices = s.strip_indices()
+            self.assert_(len(indices)==offsets[-1]+len(offsets)-2)
+            breaks = list(numpy.nonzero(indices==0xFFFFFFFF)[0])
+            result = []
+            for i,j in zip([-1]+breaks,breaks+[len(indices)]):
+                result.extend(triangles(indices[i+1:j]))
+            self.assert_(sorted(result)==expected)
+
+            indices = s.strip_indices(-1)
+            self.assert_((indices==0xFFFFFFFF).sum()==len(breaks))
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
     def test_Nfaces(self):
         self.assert_(self.closed_surface.Nfaces==4)
         self.assert_(self.open_surface.Nfaces==3)
@@ -2570,12 +2824,225 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(self.closed_surface.is_ok())
 
 
+    def test_metrics(self):
+
+        s = gts.sphere(3)
+        m = s.metrics(bins=10)
+
+        self.assert_(isinstance(m,gts.Metrics))
+        self.assert_(m.n_faces==s.Nfaces)
+        self.assert_(m.n_edges==s.Nedges)
+        self.assert_(fabs(m.area-s.area())<1.e-9)
+        self.assert_(fabs(m.volume-s.volume())<1.e-9)
+        self.assert_(m.n_boundary_edges==0)
+        self.assert_(m.n_non_manifold_edges==0)
+        self.assert_(m.n_incompatible_faces==0)
+        self.assert_(m.faces_per_edge.min==2 and m.faces_per_edge.max==2)
+
+        st = s.stats()
+        r = m.edges_per_vertex
+        self.assert_(isinstance(r,gts.Range))
+        for name in ['min','max','n','mean','stddev']:
+            self.assert_(fabs(getattr(r,name)-st['edges_per_vertex'][name])
+                         <1.e-9)
+
+        q = s.quality_stats()
+        for name in ['face_quality','face_area','edge_length','edge_angle']:
+            r = getattr(m,name)
+            self.assert_(isinstance(r,gts.Range))
+            self.assert_(r.n==q[name]['n'])
+            self.assert_(fabs(r.mean-q[name]['mean'])<1.e-9)
+            self.assert_(len(r.histogram)==10)
+            self.assert_(sum(r.histogram)==r.n)
+
+        m = s.metrics(['face_area'])
+        self.assert_(m.n_faces==s.Nfaces)
+        self.assert_(m.face_area.histogram==None)
+        self.assert_(m.area==None)
+        self.assert_(m.edge_length==None)
+        self.assert_(m.edges_per_vertex==None)
+
+        self.assertRaises(ValueError,s.metrics,['foo'])
+        self.assertRaises(ValueError,s.metrics,None,-1)
+
+
+    def test_element_arrays(self):
+
+        if HAS_NUMPY:
+
+            s = gts.sphere(3)
+            vs = s.vertices()
+            indices = s.face_indices(vs)
+
+            a = s.face_areas()
+            n = s.face_normals()
+            q = s.face_qualities()
+            self.assert_(a.shape==(s.Nfaces,))
+            self.assert_(n.shape==(s.Nfaces,3))
+            self.assert_(fabs(a.sum()-s.area())<1.e-9)
+            for i,(j,k,l) in enumerate(indices):
+                t = gts.Triangle(gts.Edge(vs[j],vs[k]),gts.Edge(vs[k],vs[l]),
+                                 gts.Edge(vs[l],vs[j]))
+                self.assert_(fabs(a[i]-t.area())<1.e-12)
+                self.assert_(fabs(q[i]-t.quality())<1.e-12)
+                p1,p2,p3 = [numpy.array(vs[m].coords()) for m in (j,k,l)]
+                self.assert_(numpy.allclose(n[i],numpy.cross(p2-p1,p3-p1)))
+
+            for weighting in ['angle','area']:
+                vn = s.vertex_normals(weighting)
+                self.assert_(vn.shape==(s.Nvertices,3))
+                for v,x in zip(vs,vn):
+                    self.assert_(fabs(numpy.dot(x,x)-1.)<1.e-12)
+                    self.assert_(numpy.dot(x,v.coords())>0.99)
+            self.assertRaises(ValueError,s.vertex_normals,'foo')
+
+            l = s.edge_lengths()
+            for e,x in zip(s.edges(),l):
+                self.assert_(fabs(e.v1.distance(e.v2)-x)<1.e-12)
+
+            s = gts.Surface()
+            self.assert_(s.face_areas().shape==(0,))
+            self.assert_(s.vertex_normals().shape==(0,3))
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_curvatures(self):
+
+        if HAS_NUMPY:
+
+            s = gts.sphere(4)
+            H,K,K1,K2 = s.curvatures()
+            for a in H,K,K1,K2:
+                self.assert_(a.shape==(s.Nvertices,))
+                self.assert_(numpy.all(numpy.fabs(a-1.)<0.1))
+            self.assert_(numpy.all(K1>=K2))
+
+            f = s.faces()[0]
+            s.remove(f)
+            H,K,K1,K2 = s.curvatures()
+            vs = s.vertices()
+            for a in H,K,K1,K2:
+                for v,x in zip(vs,a):
+                    if v in f.vertices():
+                        self.assert_(numpy.isnan(x))
+                    else:
+                        self.assert_(not numpy.isnan(x))
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_adjacency(self):
+
+        if HAS_NUMPY:
+
+            s = gts.sphere(2)
+            vs = s.vertices()
+            vindex = dict([(id(v),i) for i,v in enumerate(vs)])
+            findex = dict([(frozenset(t),i) for i,t in 
+                           enumerate(s.face_indices(vs))])
+            def face_index(f):
+                return findex[frozenset([vindex[id(v)] 
+                                         for v in f.vertices()])]
+
+            indptr,indices = s.adjacency()
+            self.assert_(len(indptr)==s.Nvertices+1)
+            self.assert_(len(indices)==2*s.Nedges)
+            for i,v in enumerate(vs):
+                row = list(indices[indptr[i]:indptr[i+1]])
+                self.assert_(row==sorted(row))
+                self.assert_(row==sorted([vindex[id(u)] 
+                                          for u in v.neighbors(s)]))
+
+            indptr,indices = s.adjacency('vertex-face')
+            self.assert_(len(indices)==3*s.Nfaces)
+            for i,v in enumerate(vs):
+                row = list(indices[indptr[i]:indptr[i+1]])
+                self.assert_(row==sorted([face_index(f) 
+                                          for f in v.faces(s)]))
+
+            indptr,indices = s.adjacency(kind='face-face')
+            self.assert_(len(indptr)==s.Nfaces+1)
+            for f in s.faces():
+                i = face_index(f)
+                row = list(indices[indptr[i]:indptr[i+1]])
+                self.assert_(row==sorted([face_index(g) 
+                                          for g in f.neighbors(s)]))
+
+            self.assertRaises(ValueError,s.adjacency,'foo')
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
     def test_tessellate(self):
 
         self.closed_surface.tessellate()
         self.assert_(self.closed_surface.Nfaces==16)
 
 
+    def test_refine(self):
+
+        s = gts.sphere(2)
+        A = s.area()
+        V = s.volume()
+        s.refine(max_edge_length=0.1)
+        self.assert_(s.is_ok())
+        self.assert_(s.is_closed())
+        for e in s.edges():
+            self.assert_(e.v1.distance(e.v2)<=0.1)
+
+        # Midpoint splits don't change the shape
+        self.assert_(fabs(s.area()-A)<1.e-9)
+        self.assert_(fabs(s.volume()-V)<1.e-9)
+
+        s = gts.sphere(2)
+        s.refine(max_faces=1000)
+        self.assert_(s.is_closed())
+        self.assert_(s.Nfaces>=1000)
+        self.assert_(s.Nfaces<=1002)
+
+        # Only the long edges are split
+        s = gts.sphere(2)
+        lengths = [e.v1.distance(e.v2) for e in s.edges()]
+        l = (min(lengths)+max(lengths))/2
+        N = len([x for x in lengths if x>l])
+        Nfaces = s.Nfaces
+        s.refine(max_edge_length=l)
+        self.assert_(s.Nfaces>=Nfaces+2*N)
+
+        self.assertRaises(TypeError,s.refine)
+        self.assertRaises(ValueError,s.refine,max_edge_length=0.)
+
+        # The curvature cost only splits the creases of a cube.  They have
+        # length 2 and a right dihedral angle, so each is cut in four.
+        s = gts.cube()
+        A = s.area()
+        V = s.volume()
+        s.refine(cost='curvature',max_cost=pi/3)
+        self.assert_(s.is_ok())
+        self.assert_(s.is_closed())
+        self.assert_(s.Nvertices==8+12*3)
+        for v in s.vertices():
+            self.assert_(len([x for x in v.coords() if fabs(fabs(x)-1)<1.e-9])>=2)
+        self.assert_(fabs(s.area()-A)<1.e-9)
+        self.assert_(fabs(s.volume()-V)<1.e-9)
+
+        s = gts.sphere(2)
+        s.refine(cost='curvature',max_faces=1000)
+        self.assert_(s.is_closed())
+        self.assert_(s.Nfaces>=1000)
+
+        self.assertRaises(TypeError,s.refine,cost='curvature')
+        self.assertRaises(TypeError,s.refine,max_edge_length=1.,max_cost=1.)
+        self.assertRaises(ValueError,s.refine,cost='area',max_faces=10)
+        self.assertRaises(ValueError,s.refine,cost='curvature',
+                          max_edge_length=1.)
+        self.assertRaises(ValueError,s.refine,cost='curvature',max_cost=0.)
+
+
     def test_indices(self):
 
         vs = self.closed_surface.vertices()
@@ -2771,6 +3238,117 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(v3 == gts.Vertex(1,4,3))
 
 
+    def test_transform(self):
+
+        f = gts.Face(gts.Vertex(0,0),
+                      gts.Vertex(1,0),
+                      gts.Vertex(0,2))
+        s = gts.Surface()
+        s.add(f)
+
+        # Scale by 2 in x, then translate by (1,2,3)
+        m = [[2,0,0,1],[0,1,0,2],[0,0,1,3],[0,0,0,1]]
+        s.transform(m)
+
+        self.assert_(s.is_ok())
+
+        v1,v2,v3 = iter(s).next().vertices()
+
+        self.assert_(v1 == gts.Vertex(1,2,3))
+        self.assert_(v2 == gts.Vertex(3,2,3))
+        self.assert_(v3 == gts.Vertex(1,4,3))
+
+        # A stack of matrices gives copies
+        I = [[1,0,0,0],[0,1,0,0],[0,0,1,0],[0,0,0,1]]
+        T = [[1,0,0,10],[0,1,0,0],[0,0,1,0],[0,0,0,1]]
+        s = gts.sphere(2)
+        copies = s.transform([I,T])
+        self.assert_(len(copies)==2)
+        self.assert_(copies[0].Nvertices==s.Nvertices)
+        self.assert_(fabs(copies[0].volume()-s.volume())<1.e-9)
+        self.assert_(fabs(copies[1].volume()-s.volume())<1.e-9)
+        self.assert_(fabs(copies[1].center_of_mass()[0]-10)<1.e-9)
+        self.assert_(fabs(s.center_of_mass()[0])<1.e-9)
+
+        # Bad matrices
+        self.assertRaises(TypeError,s.transform,[[1,0,0],[0,1,0],[0,0,1]])
+        self.assertRaises(TypeError,s.transform,
+                          [[1,0,0,0],[0,1,0,0],[0,0,1,0],[0,0,0,'a']])
+
+
+    def test_transform_deferred(self):
+
+        s = gts.sphere(3)
+        V,cm = s.volume(), s.center_of_mass()
+        v = s.vertices()[0]
+        x,y,z = v.coords()
+
+        s.scale(2,3,4)
+        s.translate(1,2,3)
+        s.rotate(0,0,1,pi/2)
+
+        # Answered from the pending transform
+        self.assert_(fabs(s.volume()-24*V)<1.e-9*fabs(V))
+        c = s.center_of_mass()
+        self.assert_(fabs(c[0]+(3*cm[1]+2))<1.e-9)
+        self.assert_(fabs(c[1]-(2*cm[0]+1))<1.e-9)
+        self.assert_(fabs(c[2]-(4*cm[2]+3))<1.e-9)
+
+        # The vertices see every transform, in order
+        self.assert_(fabs(v.x+(3*y+2))<1.e-9)
+        self.assert_(fabs(v.y-(2*x+1))<1.e-9)
+        self.assert_(fabs(v.z-(4*z+3))<1.e-9)
+        self.assert_(fabs(s.volume()-24*V)<1.e-9*fabs(V))
+        self.assert_(s.is_ok())
+
+        # Pending transforms are applied before other objects see them
+        s1 = gts.sphere(2)
+        s2 = gts.Surface()
+        s2.copy(s1)
+        s1.translate(1,0,0)
+        self.assert_(fabs(s1.center_of_mass()[0]-1)<1.e-9)
+        self.assert_(fabs(s2.center_of_mass()[0])<1.e-9)
+        s2.translate(0,1,0)
+        self.assert_(fabs(s1.center_of_mass()[0]-1)<1.e-9)
+        self.assert_(fabs(s2.center_of_mass()[1]-1)<1.e-9)
+
+
+    def test_cached_invariants(self):
+
+        s = gts.sphere(3)
+        A,V = s.area(), s.volume()
+        self.assert_(s.area()==A)
+        self.assert_(s.volume()==V)
+        self.assert_(s.is_closed())
+
+        # Moving a vertex invalidates the cache
+        v = s.vertices()[0]
+        x,y,z = v.coords()
+        v.set(2*x,2*y,2*z)
+        self.assert_(s.area()>A)
+        self.assert_(s.volume()>V)
+
+        # So does moving it back with closest()
+        v.closest(gts.Segment(gts.Vertex(x,y,z),gts.Vertex(x/2,y/2,z/2)),
+                  gts.Point(x,y,z))
+        self.assert_(fabs(s.area()-A)<1.e-9)
+
+        # So does removing a face
+        f = iter(s).next()
+        s.remove(f)
+        self.assert_(not s.is_closed())
+        s.add(f)
+        self.assert_(s.is_closed())
+
+        # Changes to shared faces are seen by every Surface
+        s2 = gts.Surface()
+        s2.add(s)
+        self.assert_(s2.is_orientable())
+        f.revert()
+        self.assert_(not s.is_orientable())
+        self.assert_(not s2.is_orientable())
+
+
     def test_is_self_intersecting(self):
         
         v1 = gts.Vertex(-1,0)
@@ -2807,6 +3385,60 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(s.is_ok())
 
 
+    def test_self_intersections(self):
+
+        if HAS_NUMPY:
+
+            s = gts.sphere(3)
+            self.assert_(s.self_intersections().shape==(0,2))
+
+            # Only the triangle through the plane meets the plane faces
+            v1 = gts.Vertex(-1,0)
+            v2 = gts.Vertex(0,0)
+            v3 = gts.Vertex(0,1)
+            v4 = gts.Vertex(1,0)
+            v5 = gts.Vertex(0,0,1)
+            v6 = gts.Vertex(0.5,0,-1)
+            v7 = gts.Vertex(0.5,0.5,0)
+
+            s = gts.Surface()
+            s.add(gts.Face(v1,v2,v3))
+            s.add(gts.Face(v2,v4,v3))
+            s.add(gts.Face(v5,v6,v7))
+
+            pairs = s.self_intersections()
+            self.assert_(pairs.shape==(1,2))
+            self.assert_(pairs[0,0]<pairs[0,1])
+            vertices = s.vertices()
+            corners = [set([(vertices[k].x,vertices[k].y,vertices[k].z)
+                            for k in f]) for f in s.face_indices(vertices)]
+            self.assert_([corners[k] for k in pairs[0]] in
+                         [[set([(0,0,0),(1,0,0),(0,1,0)]),
+                           set([(0,0,1),(0.5,0,-1),(0.5,0.5,0)])],
+                          [set([(0,0,1),(0.5,0,-1),(0.5,0.5,0)]),
+                           set([(0,0,0),(1,0,0),(0,1,0)])]])
+
+            # Overlapping spheres, enough faces to share between threads
+            s1 = gts.sphere(3)
+            s2 = gts.sphere(3)
+            s2.translate(0.5)
+            s1.add(s2)
+            pairs = s1.self_intersections()
+            self.assert_(len(pairs)>0)
+            self.assert_((pairs[:,0]<pairs[:,1]).all())
+            keys = pairs[:,0]*s1.Nfaces + pairs[:,1]
+            self.assert_((numpy.diff(keys)>0).all())
+            self.assert_(s1.is_self_intersecting())
+
+            # The cached tree follows changes to the vertices
+            s2.translate(3)
+            self.assert_(s1.self_intersections().shape==(0,2))
+            self.assert_(not s1.is_self_intersecting())
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
     def test_cleanup(self):
 
         v1 = gts.Vertex(-1,0)
@@ -2849,6 +3481,108 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(f1.common_edge(f2))
 
 
+    def test_cleanup_duplicates(self):
+
+        s = gts.Surface()
+        s.add(gts.Face(gts.Vertex(0,0),gts.Vertex(1,0),gts.Vertex(0,1)))
+        s.add(gts.Face(gts.Vertex(0,1),gts.Vertex(0,0),gts.Vertex(1,0)))
+        s.add(gts.Face(gts.Vertex(1,0),gts.Vertex(1,1),gts.Vertex(0,1)))
+        f = gts.Face(gts.Vertex(0,0),gts.Vertex(1,0),gts.Vertex(0,1))
+        s.add(f)
+
+        self.assert_(s.Nfaces==4)
+
+        s.cleanup(1.e-9)
+
+        self.assert_(s.Nvertices==4)
+        self.assert_(s.Nedges==5)
+        self.assert_(s.Nfaces==2)
+        self.assert_(s.is_ok())
+
+
+    def test_coarsen(self):
+
+        s = gts.sphere(4)
+        s.coarsen(1000)
+        self.assert_(s.is_ok())
+        self.assert_(s.is_closed())
+        self.assert_(s.Nedges<=1000)
+
+        for cost in ['volume','quadric','length']:
+            s = gts.sphere(4)
+            s.coarsen(cost=cost,nfaces=1000)
+            self.assert_(s.is_ok())
+            self.assert_(s.is_closed())
+            self.assert_(s.Nfaces<=1000)
+            self.assert_(s.Nfaces>900)
+
+        # The quadric vertices stay close to the sphere
+        s = gts.sphere(4)
+        s.coarsen(cost='quadric',nfaces=500)
+        for v in s.vertices():
+            self.assert_(fabs(sqrt(v.x**2+v.y**2+v.z**2)-1)<0.05)
+
+        # Stop on the cost
+        s = gts.sphere(4)
+        N = s.Nfaces
+        s.coarsen(cost='length',max_cost=0.)
+        self.assert_(s.Nfaces==N)
+        s.coarsen(cost='length',max_cost=0.1**2)
+        self.assert_(s.Nfaces<N)
+
+        # Volume weights
+        s = gts.sphere(4)
+        s.coarsen(cost='volume',weights=(1.,1.,0.),nfaces=1000)
+        self.assert_(s.is_closed())
+
+        self.assertRaises(ValueError,s.coarsen,100,cost='foo')
+        self.assertRaises(TypeError,s.coarsen)
+
+
+    def test_coarsen_partitioned(self):
+
+        for cost in ['volume','quadric','length']:
+            s1 = gts.sphere(5)
+            s1.coarsen(cost=cost,nfaces=2000)
+            s2 = gts.sphere(5)
+            s2.coarsen(cost=cost,nfaces=2000,partitions=4)
+            self.assert_(s2.is_ok())
+            self.assert_(s2.is_closed())
+            self.assert_(s2.is_orientable())
+            self.assert_(not s2.is_self_intersecting())
+            self.assert_(s2.Nfaces<=2000)
+            self.assert_(s2.Nfaces>1900)
+            self.assert_(fabs(s2.volume()/s1.volume()-1)<0.02)
+
+        s = gts.sphere(5)
+        s.coarsen(1000,partitions=3)
+        self.assert_(s.is_closed())
+        self.assert_(s.Nedges<=1000)
+
+        # Enough partitions and faces for the threads to overlap
+        for cost in ['volume','quadric']:
+            s = gts.sphere(7)
+            s.coarsen(cost=cost,nfaces=4000,partitions=16)
+            self.assert_(s.is_ok())
+            self.assert_(s.is_closed())
+            self.assert_(s.is_orientable())
+            self.assert_(not s.is_self_intersecting())
+            self.assert_(s.Nfaces<=4000)
+            s.coarsen(cost=cost,nfaces=1000)
+            self.assert_(s.is_ok())
+            self.assert_(s.is_closed())
+
+        # Faces shared with another Surface are coarsened serially
+        s1 = gts.sphere(6)
+        s2 = gts.Surface()
+        s2.add(s1)
+        s1.coarsen(nfaces=2000,partitions=8)
+        self.assert_(s1.is_ok())
+        self.assert_(s1.is_closed())
+        self.assert_(s1.Nfaces<=2000)
+        self.assert_(s2.is_ok())
+
+
     def test_parent(self):
 
         #         v4
@@ -3010,6 +3744,100 @@ class TestSurfaceMethods(unittest.TestCase):
         self.assert_(s.is_ok())
 
 
+class TestProgressiveSurfaceMethods(unittest.TestCase):
+
+    def setUp(self):
+        self.surface = gts.sphere(3)
+        self.ps = gts.ProgressiveSurface(self.surface)
+
+
+    def test_new(self):
+
+        ps = self.ps
+        self.assert_(ps.is_ok())
+        self.assert_(not ps.is_open())
+
+        # The Surface given is left unchanged
+        self.assert_(self.surface.Nvertices==642)
+        self.assert_(ps.Nvertices_max==642)
+        self.assert_(ps.Nvertices_min<ps.Nvertices_max)
+        self.assert_(ps.Nvertices==ps.Nvertices_min)
+
+        ps = gts.ProgressiveSurface(self.surface,500)
+        self.assert_(ps.Nvertices_min>self.ps.Nvertices_min)
+
+        self.assertRaises(TypeError,gts.ProgressiveSurface,gts.Vertex(0,0,0))
+
+
+    def test_set_vertex_number(self):
+
+        ps = self.ps
+        ps.set_vertex_number(ps.Nvertices_max)
+        self.assert_(ps.Nvertices==642)
+        s = ps.surface()
+        self.assert_(s.is_ok())
+        self.assert_(s.is_closed())
+        self.assert_(s.Nvertices==642)
+        self.assert_(fabs(s.volume()-self.surface.volume())<1.e-9)
+
+        ps.set_vertex_number(300)
+        self.assert_(ps.Nvertices==300)
+        s = ps.surface()
+        self.assert_(s.is_closed())
+        self.assert_(s.Nvertices==300)
+
+        ps.set_vertex_number(0)
+        self.assert_(ps.Nvertices==ps.Nvertices_min)
+        self.assert_(ps.surface().is_closed())
+
+
+    def test_add_remove_vertex(self):
+
+        ps = self.ps
+        N = ps.Nvertices
+        self.assert_(not ps.remove_vertex())
+        self.assert_(ps.add_vertex())
+        self.assert_(ps.Nvertices==N+1)
+        self.assert_(ps.remove_vertex())
+        self.assert_(ps.Nvertices==N)
+
+        ps.set_vertex_number(ps.Nvertices_max)
+        self.assert_(not ps.add_vertex())
+
+
+    def test_readwrite(self):
+
+        path = os.path.join(tempfile.gettempdir(),'pygts_test.dat')
+
+        ps1 = self.ps
+        ps1.set_vertex_number(400)
+        f = open(path,'w')
+        ps1.write(f)
+        f.close()
+
+        f = open(path,'r')
+        ps2 = gts.read_progressive(f)
+        self.assert_(ps2.is_ok())
+        self.assert_(ps2.is_open())
+        self.assert_(ps2.Nvertices==ps1.Nvertices_min)
+        self.assertRaises(RuntimeError,ps2.set_vertex_number,400)
+
+        # Read progressively
+        self.assert_(ps2.read_vertices(10)==10)
+        self.assert_(ps2.Nvertices==ps1.Nvertices_min+10)
+        self.assert_(ps2.surface().is_closed())
+        ps2.read_vertices()
+        self.assert_(not ps2.is_open())
+        f.close()
+
+        self.assert_(ps2.Nvertices==ps1.Nvertices_max)
+        ps1.set_vertex_number(ps1.Nvertices_max)
+        self.assert_(fabs(ps2.surface().volume()-ps1.surface().volume())<1.e-9)
+
+        ps2.set_vertex_number(400)
+        self.assert_(ps2.Nvertices==400)
+
+
 class TestFunctions(unittest.TestCase):
 
     def test_merge(self):
@@ -3045,6 +3873,38 @@ class TestFunctions(unittest.TestCase):
         self.assert_(s.is_ok())
 
 
+    def test_merge_grid(self):
+
+        # The first vertex given is far from the others; see test_merge
+
+        # Pairs of vertices straddling the grid cell boundaries
+        eps = 0.1
+        vertices = [gts.Vertex(100,100,100)]
+        for i in range(-5,5):
+            for j in range(-5,5):
+                x, y = i*eps, j*eps
+                vertices.append(gts.Vertex(x-1.e-9,y-1.e-9,3.))
+                vertices.append(gts.Vertex(x+1.e-9,y+1.e-9,3.))
+        v = gts.merge(vertices,1.e-6)
+        self.assert_(len(v)==100)
+        for v in vertices:
+            self.assert_(v.is_ok())
+
+        # The box is inclusive, and is not a sphere
+        vertices = [gts.Vertex(100,100,100),
+                    gts.Vertex(0,0,0),gts.Vertex(1,1,1),gts.Vertex(2.01,0,0)]
+        v = gts.merge(vertices,1.)
+        self.assert_(len(v)==2)
+        self.assert_(vertices[1] in v)
+        self.assert_(vertices[3] in v)
+
+        # Coincident vertices
+        vertices = [gts.Vertex(100,100,100),
+                    gts.Vertex(1,2,3),gts.Vertex(1,2,3),gts.Vertex(1,2,3.1)]
+        v = gts.merge(vertices,0.)
+        self.assert_(len(v)==2)
+
+
     def test_vertices(self):
 
         v1,v2,v3 = gts.Vertex(0),gts.Vertex(1),gts.Vertex(2)
@@ -3190,6 +4050,285 @@ class TestFunctions(unittest.TestCase):
             sys.stderr.write('*** skipping *** ...')
 
 
+    def test_isosurface_slices(self):
+
+        if HAS_NUMPY:
+
+            N = 20
+            r = 3.0
+            Nj = N*(0+1j)
+            x, y, z = numpy.ogrid[-5:5:Nj, -5:5:Nj, -5:5:Nj]
+            scalars = x*x + y*y + z*z
+            extents= numpy.asarray([-5.0, 5.0, -5.0, 5.0, -5.0, 5.0])
+
+            S1 = gts.isosurface(scalars,r**2,extents=extents)
+
+            # Slices from a callable
+            S2 = gts.isosurface(lambda k: scalars[:,:,k],r**2,
+                                extents=extents,nz=N)
+            self.assert_(S2.Nfaces==S1.Nfaces)
+            self.assert_(fabs(S2.volume()-S1.volume())<1.e-9)
+
+            # Slices from an iterator
+            slices = (scalars[:,:,k] for k in range(N))
+            S3 = gts.isosurface(slices,r**2,extents=extents,nz=N)
+            self.assert_(S3.Nfaces==S1.Nfaces)
+            self.assert_(fabs(S3.volume()-S1.volume())<1.e-9)
+
+            # Errors
+            self.assertRaises(ValueError,gts.isosurface,
+                              lambda k: scalars[:,:,k],r**2)
+            slices = (scalars[:,:,k] for k in range(N-1))
+            self.assertRaises(ValueError,gts.isosurface,slices,r**2,nz=N)
+            def f(k):
+                if k==N/2: raise IndexError
+                return scalars[:,:,k]
+            self.assertRaises(IndexError,gts.isosurface,f,r**2,nz=N)
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_isosurface_blocks(self):
+
+        if HAS_NUMPY:
+
+            N = 30
+            r = 3.0
+            Nj = N*(0+1j)
+            x, y, z = numpy.ogrid[-5:5:Nj, -5:5:Nj, -5:5:Nj]
+            scalars = x*x + y*y + z*z
+            extents= numpy.asarray([-5.0, 5.0, -5.0, 5.0, -5.0, 5.0])
+
+            blocks = gts.isosurface_blocks(scalars,blocksize=4)
+            self.assert_(blocks.shape==(8,8,8,2))
+            self.assert_(blocks[0,0,0,0]==scalars[:5,:5,:5].min())
+            self.assert_(blocks[0,0,0,1]==scalars[:5,:5,:5].max())
+            self.assert_(blocks[-1,-1,-1,1]==scalars[28:,28:,28:].max())
+
+            for method in ['cubes','tetra']:
+                S1 = gts.isosurface(scalars,r**2,extents=extents,
+                                    method=method)
+                S2 = gts.isosurface(scalars,r**2,extents=extents,
+                                    method=method,blocksize=4)
+                S3 = gts.isosurface(scalars,r**2,extents=extents,
+                                    method=method,blocksize=4,blocks=blocks)
+                for S in [S2,S3]:
+                    self.assert_(S.is_ok())
+                    self.assert_(S.is_manifold())
+                    self.assert_(S.is_closed())
+                    self.assert_(S.Nfaces==S1.Nfaces)
+                    self.assert_(S.Nvertices==S1.Nvertices)
+                    self.assert_(fabs(S.volume()-S1.volume())<1.e-9)
+
+            # Errors
+            self.assertRaises(ValueError,gts.isosurface,scalars,r**2,
+                              blocksize=4,blocks=blocks[:-1])
+            self.assertRaises(ValueError,gts.isosurface,scalars,r**2,
+                              method='tetra',blocksize=3)
+            self.assertRaises(ValueError,gts.isosurface,scalars,r**2,
+                              method='dual',blocksize=4)
+            self.assertRaises(ValueError,gts.isosurface,
+                              lambda k: scalars[:,:,k],r**2,nz=N,blocksize=4)
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_isosurface_arrays(self):
+
+        if HAS_NUMPY:
+
+            N = 20
+            r = 3.0
+            Nj = N*(0+1j)
+            x, y, z = numpy.ogrid[-5:5:Nj, -5:5:Nj, -5:5:Nj]
+            scalars = x*x + y*y + z*z
+            extents= numpy.asarray([-5.0, 5.0, -5.0, 5.0, -5.0, 5.0])
+
+            # The dual method goes through a Surface
+            S = gts.isosurface(scalars,r**2,extents=extents,method='dual')
+            coords,triangles = gts.isosurface(scalars,r**2,extents=extents,
+                                              method='dual',output='arrays')
+            self.assert_(coords.shape==(S.Nvertices,3))
+            self.assert_(triangles.shape==(S.Nfaces,3))
+            a,b,c = [coords[triangles[:,i]] for i in range(3)]
+            V = (a*numpy.cross(b,c)).sum()/6.
+            self.assert_(fabs(V-S.volume())<1.e-9)
+
+            # The cubes and tetra methods are marched straight into arrays
+            for method in ['cubes','tetra']:
+                S = gts.isosurface(scalars,r**2,extents=extents,method=method)
+                coords,triangles = gts.isosurface(scalars,r**2,
+                                                  extents=extents,
+                                                  method=method,
+                                                  output='arrays')
+                self.assert_(triangles.min()==0)
+                self.assert_(triangles.max()==len(coords)-1)
+
+                # Each vertex is emitted once
+                self.assert_(len(set(map(tuple,coords)))==len(coords))
+
+                # Closed and consistently oriented: each directed edge is
+                # used once, and its reverse once
+                edges = [(t[i],t[(i+1)%3]) for t in triangles 
+                         for i in range(3)]
+                self.assert_(len(set(edges))==len(edges))
+                self.assert_(set(edges)==set([(j,i) for i,j in edges]))
+
+                # Volume from the divergence theorem
+                a,b,c = [coords[triangles[:,i]] for i in range(3)]
+                V = (a*numpy.cross(b,c)).sum()/6.
+                self.assert_(fabs(V/S.volume()-1.)<0.02)
+                self.assert_(fabs(V/(4./3*numpy.pi*r**3)-1.)<0.05)
+
+                # The same arrays come from blocks and from slices
+                coords2,triangles2 = gts.isosurface(scalars,r**2,
+                                                    extents=extents,
+                                                    method=method,
+                                                    blocksize=4,
+                                                    output='arrays')
+                self.assert_(coords2.shape==coords.shape)
+                self.assert_(triangles2.shape==triangles.shape)
+                a,b,c = [coords2[triangles2[:,i]] for i in range(3)]
+                self.assert_(fabs((a*numpy.cross(b,c)).sum()/6.-V)<1.e-9)
+
+                coords2,triangles2 = gts.isosurface(
+                    lambda k: scalars[:,:,k],r**2,nz=N,extents=extents,
+                    method=method,output='arrays')
+                self.assert_((coords2==coords).all())
+                self.assert_((triangles2==triangles).all())
+
+                coords,triangles,normals = gts.isosurface(scalars,r**2,
+                                                          extents=extents,
+                                                          method=method,
+                                                          output='arrays',
+                                                          normals=True)
+                self.assert_(normals.shape==coords.shape)
+                self.assert_(numpy.allclose((normals*normals).sum(1),1.))
+                self.assert_(((normals*coords).sum(1)>0).all())
+
+            self.assertRaises(ValueError,gts.isosurface,scalars,r**2,
+                              output='foo')
+            self.assertRaises(ValueError,gts.isosurface,scalars,r**2,
+                              normals=True)
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_delaunay(self):
+
+        if HAS_NUMPY:
+
+            # A 5x5 grid has 16 hull points and so 2*25-16-2 triangles
+            x,y = numpy.mgrid[0:5,0:5]
+            points = numpy.column_stack((x.ravel(),y.ravel())).astype(float)
+
+            coords,triangles = gts.delaunay(points,output='arrays')
+            self.assert_(coords.shape==(25,3))
+            self.assert_((coords[:,:2]==points).all())
+            self.assert_((coords[:,2]==0).all())
+            self.assert_(triangles.shape==(32,3))
+            self.assert_(triangles.min()==0 and triangles.max()==24)
+
+            # Counter-clockwise faces covering the square
+            a,b,c = [coords[triangles[:,i]] for i in range(3)]
+            A = numpy.cross(b-a,c-a)[:,2]/2.
+            self.assert_((A>0).all())
+            self.assert_(fabs(A.sum()-16.)<1.e-9)
+
+            # Duplicates are inserted once
+            dup = numpy.vstack((points,points[7:9]))
+            coords,triangles = gts.delaunay(dup,output='arrays')
+            self.assert_(coords.shape==(27,3))
+            self.assert_(triangles.shape==(32,3))
+            self.assert_(triangles.max()<25)
+
+            s = gts.delaunay(numpy.column_stack((points,points[:,0])))
+            self.assert_(s.is_ok())
+            self.assert_(s.Nvertices==25)
+            self.assert_(s.Nfaces==32)
+            for v in s.vertices():
+                self.assert_(v.z==v.x)
+
+            self.assertRaises(ValueError,gts.delaunay,points[:2])
+            self.assertRaises(ValueError,gts.delaunay,numpy.zeros((5,4)))
+            self.assertRaises(ValueError,gts.delaunay,points,output='foo')
+            bad = points.copy()
+            bad[3,0] = numpy.nan
+            self.assertRaises(ValueError,gts.delaunay,bad)
+            bad[3,0] = numpy.inf
+            self.assertRaises(ValueError,gts.delaunay,bad)
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
+    def test_constrained_delaunay(self):
+
+        if HAS_NUMPY:
+
+            # The unconstrained rhombus is split along its short diagonal
+            points = numpy.array([[0,0],[2,-1],[4,0],[2,1]],dtype=float)
+            coords,triangles = gts.delaunay(points,output='arrays')
+            self.assert_(((triangles==1)|(triangles==3)).any(1).all())
+
+            coords,triangles = gts.constrained_delaunay(points,[[0,2]],
+                                                        output='arrays')
+            self.assert_(coords.shape==(4,3))
+            self.assert_(triangles.shape==(2,3))
+            for t in triangles:
+                self.assert_(0 in t and 2 in t)
+
+            self.assertRaises(ValueError,gts.constrained_delaunay,points,
+                              [[0,2],[1,3]])
+            self.assertRaises(IndexError,gts.constrained_delaunay,points,
+                              [[0,4]])
+            self.assertRaises(ValueError,gts.constrained_delaunay,points,
+                              [[0,1,2]])
+
+            # Refinement adds Steiner points inside the hull
+            square = numpy.array([[0,0],[1,0],[1,1],[0,1]],dtype=float)
+            coords,triangles = gts.constrained_delaunay(square,[],
+                                                        max_area=0.01,
+                                                        min_angle=20.,
+                                                        output='arrays')
+            self.assert_(coords.shape[0]>4)
+            self.assert_((coords[:4,:2]==square).all())
+            self.assert_((coords>=-1.e-12).all() and (coords<=1+1.e-12).all())
+            a,b,c = [coords[triangles[:,i]] for i in range(3)]
+            A = numpy.cross(b-a,c-a)[:,2]/2.
+            self.assert_((A>0).all())
+            self.assert_((A<=0.01+1.e-12).all())
+            self.assert_(fabs(A.sum()-1.)<1.e-9)
+
+            s = gts.constrained_delaunay(square,[[0,2]],max_area=0.1)
+            self.assert_(s.is_ok())
+            self.assert_(fabs(s.area()-1.)<1.e-9)
+
+            # The Steiner points are shared between conforming and refining
+            coords,triangles = gts.constrained_delaunay(points,[[1,3]],
+                                                        max_area=0.01,
+                                                        steiner_max=5,
+                                                        output='arrays')
+            self.assert_(coords.shape[0]<=4+5)
+
+            # Large angles need a budget to be sure to stop
+            self.assertRaises(ValueError,gts.constrained_delaunay,square,[],
+                              min_angle=30.)
+            coords,triangles = gts.constrained_delaunay(square,[],
+                                                        min_angle=30.,
+                                                        steiner_max=50,
+                                                        output='arrays')
+            self.assert_(coords.shape[0]<=4+50)
+            self.assertRaises(ValueError,gts.constrained_delaunay,square,[],
+                              min_angle=60.,steiner_max=50)
+
+        else:
+            sys.stderr.write('*** skipping *** ...')
+
+
 tests = [TestPointMethods,
          TestVertexMethods,
          TestSegmentMethods,
@@ -3197,6 +4336,7 @@ tests = [TestPointMethods,
          TestTriangleMethods,
          TestFaceMethods,
          TestSurfaceMethods,
+         TestProgressiveSurfaceMethods,
          TestFunctions
          ]
 